@@ -657,6 +657,22 @@ minetest.register_chatcommand("unban", {
 	end,
 })
 
+minetest.register_chatcommand("snapshot", {
+	params = "[<name>]",
+	description = "copy the world into the snapshots directory of the world",
+	privs = {server=true},
+	func = function(name, param)
+		local path, err = minetest.snapshot_world(param ~= "" and param or nil)
+		if not path then
+			minetest.chat_send_player(name, "Snapshot failed: " .. err)
+			return
+		end
+		minetest.log("action", name .. " snapshots the world to " .. path)
+		minetest.chat_send_player(name, "Snapshot started in " .. path ..
+				"; the map is copied in the background.")
+	end,
+})
+
 minetest.register_chatcommand("clearobjects", {
 	params = "",
 	description = "clear all objects in world",
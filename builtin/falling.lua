@@ -156,50 +156,16 @@ end
 --
 -- Some common functions
 --
+-- The updates themselves are done by the engine, which calls
+-- spawn_falling_node and drop_attached_node above for nodes that need them.
+--
 
 function nodeupdate_single(p, delay)
-	n = minetest.get_node(p)
-	if minetest.get_node_group(n.name, "falling_node") ~= 0 then
-		p_bottom = {x=p.x, y=p.y-1, z=p.z}
-		n_bottom = minetest.get_node(p_bottom)
-		-- Note: walkable is in the node definition, not in item groups
-		if minetest.registered_nodes[n_bottom.name] and
-				(minetest.get_node_group(n.name, "float") == 0 or minetest.registered_nodes[n_bottom.name].liquidtype == "none") and
-				(n.name ~= n_bottom.name or (minetest.registered_nodes[n_bottom.name].leveled and minetest.env:get_node_level(p_bottom) < minetest.env:get_node_max_level(p_bottom))) and
-				(not minetest.registered_nodes[n_bottom.name].walkable or 
-					minetest.registered_nodes[n_bottom.name].buildable_to) then
-			if delay then
-				minetest.after(0.1, nodeupdate_single, {x=p.x, y=p.y, z=p.z}, false)
-			else
-				n.level = minetest.env:get_node_level(p)
-				minetest.remove_node(p)
-				spawn_falling_node(p, n)
-				nodeupdate(p)
-			end
-		end
-	end
-	
-	if minetest.get_node_group(n.name, "attached_node") ~= 0 then
-		if not check_attached_node(p, n) then
-			drop_attached_node(p)
-			nodeupdate(p)
-		end
-	end
+	return minetest.check_single_for_falling(p)
 end
 
 function nodeupdate(p, delay)
-	-- Round p to prevent falling entities to get stuck
-	p.x = math.floor(p.x+0.5)
-	p.y = math.floor(p.y+0.5)
-	p.z = math.floor(p.z+0.5)
-	
-	for x = -1,1 do
-	for y = -1,1 do
-	for z = -1,1 do
-		nodeupdate_single({x=p.x+x, y=p.y+y, z=p.z+z}, delay or not (x==0 and y==0 and z==0))
-	end
-	end
-	end
+	minetest.check_for_falling(p)
 end
 
 --
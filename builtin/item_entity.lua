@@ -1,5 +1,15 @@
 -- Minetest: builtin/item_entity.lua
 
+-- Landed items that may merge in one server step; the rest wait for the
+-- next one, so that many items landing at once don't stall the server
+local MERGES_PER_STEP = 50
+local merges_left = MERGES_PER_STEP
+minetest.register_globalstep(function(dtime)
+	merges_left = MERGES_PER_STEP
+end)
+
+local merge_filter = {type="entity", name="__builtin:item"}
+
 function minetest.spawn_item(pos, item)
 	-- Take item in any format
 	local stack = ItemStack(item)
@@ -66,7 +76,9 @@ minetest.register_entity("__builtin:item", {
 	end,
 
 	on_activate = function(self, staticdata)
-		if string.sub(staticdata, 1, string.len("return")) == "return" then
+		-- Serialized table (in either format), or a bare itemstring
+		if string.sub(staticdata, 1, string.len("return")) == "return" or
+				string.sub(staticdata, 1, string.len("MTS")) == "MTS" then
 			local data = minetest.deserialize(staticdata)
 			if data and type(data) == "table" then
 				self.itemstring = data.itemstring
@@ -95,7 +107,21 @@ minetest.register_entity("__builtin:item", {
 				self.object:set_properties({
 					physical = false
 				})
+				self.merge_pending = true
+			end
+			if self.merge_pending then
+				if merges_left <= 0 then
+					return
+				end
+				merges_left = merges_left - 1
+				self.merge_pending = false
+				if self:try_merge() then
+					return
+				end
 			end
+			-- Nothing happens to a resting item until something moves it
+			-- or the ground under it changes
+			self.object:sleep()
 		else
 			if not self.physical_state then
 				self.object:setvelocity({x=0,y=0,z=0})
@@ -108,6 +134,36 @@ minetest.register_entity("__builtin:item", {
 		end
 	end,
 
+	-- Merge into an identical resting stack nearby (0.8 nodes along each axis).
+	-- Returns true if this item was used up and removed.
+	try_merge = function(self)
+		if self.always_collect or self.itemstring == '' then
+			return false
+		end
+		local stack = ItemStack(self.itemstring)
+		local p = self.object:getpos()
+		local objects = minetest.get_objects_in_area(
+				{x=p.x-0.8, y=p.y-0.8, z=p.z-0.8},
+				{x=p.x+0.8, y=p.y+0.8, z=p.z+0.8}, merge_filter)
+		for _, object in ipairs(objects) do
+			local entity = object:get_luaentity()
+			if entity and entity ~= self and
+					not entity.physical_state and not entity.always_collect and
+					entity.itemstring ~= '' then
+				local other = ItemStack(entity.itemstring)
+				stack = other:add_item(stack)
+				entity.itemstring = other:to_string()
+				if stack:is_empty() then
+					self.itemstring = ''
+					self.object:remove()
+					return true
+				end
+				self.itemstring = stack:to_string()
+			end
+		end
+		return false
+	end,
+
 	on_punch = function(self, hitter)
 		if self.itemstring ~= '' then
 			local left = hitter:get_inventory():add_item("main", self.itemstring)
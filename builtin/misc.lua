@@ -4,24 +4,11 @@
 -- Misc. API functions
 --
 
-minetest.timers_to_add = {}
-minetest.timers = {}
-minetest.register_globalstep(function(dtime)
-	for _, timer in ipairs(minetest.timers_to_add) do
-		table.insert(minetest.timers, timer)
-	end
-	minetest.timers_to_add = {}
-	for index, timer in ipairs(minetest.timers) do
-		timer.time = timer.time - dtime
-		if timer.time <= 0 then
-			timer.func(unpack(timer.args or {}))
-			table.remove(minetest.timers,index)
-		end
-	end
-end)
-
 function minetest.after(time, func, ...)
-	table.insert(minetest.timers_to_add, {time=time, func=func, args={...}})
+	assert(type(func) == "function" or
+			(getmetatable(func) and getmetatable(func).__call),
+			"Invalid minetest.after invocation")
+	minetest.add_timer(time, {func=func, args={...}})
 end
 
 function minetest.check_player_privs(name, privs)
@@ -10,11 +10,15 @@
 -- * strings, numbers, booleans, nil
 -- * tables thereof. Tables can have shared part, but can't be recursive yet.
 -- Caveat: metatables and environments aren't saved.
+--
+-- minetest.serialize(x, "mts") writes the compact format of the engine
+-- instead (see l_util.cpp), which minetest.deserialize reads without
+-- compiling anything. It also supports recursive tables.
 --------------------------------------------------------------------------------
 
 local no_identity = { number=1, boolean=1, string=1, ['nil']=1 }
 
-function minetest.serialize(x)
+local function serialize_lua(x)
 
 	local gensym_max   =  0  -- index of the gensym() symbol generator
 	local seen_once    = { } -- element->true set of elements seen exactly once in the table
@@ -160,7 +164,19 @@ function minetest.serialize(x)
 	end
 end
 
--- Deserialization.
+local serialize_native = minetest.serialize
+local deserialize_native = minetest.deserialize
+
+function minetest.serialize(x, format)
+	if format == "mts" then
+		return serialize_native(x)
+	end
+	assert(format == nil or format == "lua",
+			"Invalid minetest.serialize format")
+	return serialize_lua(x)
+end
+
+-- Deserialization of the Lua source format.
 -- http://stackoverflow.com/questions/5958818/loading-serialized-data-into-a-table
 --
 
@@ -173,6 +189,13 @@ local function stringtotable(sdata)
 end
 
 function minetest.deserialize(sdata)
+	if type(sdata) == "string" and sdata:sub(1, 3) == "MTS" then
+		local value, err = deserialize_native(sdata)
+		if err then
+			minetest.log('error', 'minetest.deserialize(): '.. err)
+		end
+		return value
+	end
 	local table = {}
 	local okay,results = pcall(stringtotable, sdata)
 	if okay then
@@ -201,7 +224,23 @@ local function unit_test()
 	unittest_output = minetest.deserialize(minetest.serialize(unittest_input))
 	unitTest("test 3a", unittest_input.escapechars == unittest_output.escapechars)
 	unitTest("test 3b", unittest_input.noneuropean == unittest_output.noneuropean)
+
+	local shared = {1, 2.5, -3, "\0"}
+	unittest_input = {a=shared, b=shared, [shared]=true}
+	unittest_input.self = unittest_input
+	unittest_output = minetest.deserialize(
+			minetest.serialize(unittest_input, "mts"))
+	unitTest("test 4a", unittest_output.a == unittest_output.b)
+	unitTest("test 4b", unittest_output[unittest_output.a] == true)
+	unitTest("test 4c", unittest_output.self == unittest_output)
+	unitTest("test 4d", unittest_output.a[2] == 2.5 and
+			unittest_output.a[3] == -3 and unittest_output.a[4] == "\0")
+
+	-- Lua source written by hand
+	unittest_output = minetest.deserialize(
+			'local _={ }\n_[1]={ "x" }\nreturn { a = _[1], b = _[1] }')
+	unitTest("test 5a", unittest_output.a[1] == "x")
+	unitTest("test 5b", unittest_output.a == unittest_output.b)
 end
 unit_test() -- Run it
 unit_test = nil -- Hide it
-
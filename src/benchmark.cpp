@@ -0,0 +1,1423 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	Benchmark suite run with --benchmark.
+
+	Output is a JSON object with one entry per benchmark. Names are stable
+	so that results of different versions can be compared; when what a
+	benchmark measures changes, it gets a new name.
+*/
+
+#include "benchmark.h"
+#include "test.h"
+#include "porting.h"
+#include "version.h"
+#include "gamedef.h"
+#include "itemdef.h"
+#include "nodedef.h"
+#include "mapblock.h"
+#include "nodemetadata.h"
+#include "voxel.h"
+#include "voxelalgorithms.h"
+#include "noise.h"
+#include "collision.h"
+#include "inventory.h"
+#include "inventorymanager.h"
+#include "serialization.h"
+#include "emerge.h"
+#include "mapgen.h"
+#include "mapgen_v7.h"
+#include "biome.h"
+#include "map.h"
+#include "environment.h"
+#ifndef SERVER
+#include "clientmap.h"
+#include "irrlicht.h" // createDevice
+#endif
+#include "connection.h"
+#include "clientserver.h"
+#include "database-sharded.h"
+#include "database-sqlite3.h"
+#include "filesys.h"
+#include "main.h"
+#include "settings.h"
+#include "lua_api/l_env.h"
+#include "cpp_api/s_env.h"
+#include "common/c_types.h"
+#include "log.h"
+#include "debug.h"
+#include "util/numeric.h"
+#include "util/serialize.h"
+#include "util/string.h"
+#include "util/thread.h"
+#include <sstream>
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+}
+
+/*
+	Plain nodes for everything the mapgens look up, aliased from the
+	mapgen_* names like the default game does
+*/
+static void define_mapgen_nodes(IWritableItemDefManager *idef,
+		IWritableNodeDefManager *ndef)
+{
+	const char *names[] = {
+		"stone", "dirt", "dirt_with_grass", "sand", "gravel", "cobble",
+		"mossycobble", "stair_cobble", "desert_sand", "desert_stone",
+		"tree", "leaves", "apple", "jungletree", "jungleleaves",
+		"junglegrass", "water_source", "lava_source",
+	};
+	for(u32 i=0; i<sizeof(names) / sizeof(names[0]); i++)
+	{
+		std::string name = std::string("default:") + names[i];
+		if(ndef->getId(name) == CONTENT_IGNORE)
+		{
+			ItemDefinition itemdef;
+			itemdef.type = ITEM_NODE;
+			itemdef.name = name;
+			ContentFeatures f;
+			f.name = name;
+			f.is_ground_content = true;
+			if(name == "default:apple" || name == "default:junglegrass")
+			{
+				f.walkable = false;
+				f.light_propagates = true;
+				f.sunlight_propagates = true;
+			}
+			else if(name == "default:sand" || name == "default:gravel" ||
+					name == "default:desert_sand")
+			{
+				f.groups["falling_node"] = 1;
+				f.is_falling_node = true;
+			}
+			else if(name == "default:water_source" ||
+					name == "default:lava_source")
+			{
+				f.walkable = false;
+				f.pointable = false;
+				f.buildable_to = true;
+				f.liquid_type = LIQUID_SOURCE;
+				f.liquid_alternative_source = name;
+				f.liquid_alternative_flowing = name;
+				f.light_propagates = (name == "default:water_source");
+			}
+			idef->registerItem(itemdef);
+			ndef->set(f.name, f);
+		}
+		idef->registerAlias(std::string("mapgen_") + names[i], name);
+	}
+	ndef->updateAliases(idef);
+}
+
+// The definitions of test.cpp, without the parts only the client has
+class BenchmarkGameDef : public IGameDef
+{
+public:
+	BenchmarkGameDef():
+		m_idef(createItemDefManager()),
+		m_ndef(createNodeDefManager())
+	{
+		define_some_nodes(m_idef, m_ndef);
+		define_mapgen_nodes(m_idef, m_ndef);
+	}
+	~BenchmarkGameDef()
+	{
+		delete m_idef;
+		delete m_ndef;
+	}
+
+	IItemDefManager* getItemDefManager() { return m_idef; }
+	INodeDefManager* getNodeDefManager() { return m_ndef; }
+	ICraftDefManager* getCraftDefManager() { return NULL; }
+	ITextureSource* getTextureSource() { return NULL; }
+	IShaderSource* getShaderSource() { return NULL; }
+	u16 allocateUnknownNodeId(const std::string &name)
+	{ return m_ndef->allocateDummy(name); }
+	ISoundManager* getSoundManager() { return NULL; }
+	MtEventManager* getEventManager() { return NULL; }
+
+private:
+	IWritableItemDefManager *m_idef;
+	IWritableNodeDefManager *m_ndef;
+};
+
+class Benchmarker
+{
+public:
+	Benchmarker(std::ostream &os, float scale, const std::string &filter):
+		m_os(os),
+		m_scale(scale),
+		m_filter(filter),
+		m_count(0),
+		m_name(NULL),
+		m_iterations(0),
+		m_time1(0)
+	{
+		m_os<<"{"<<std::endl;
+		m_os<<"\t\"version\": "<<serializeJsonString(minetest_version_hash)
+				<<","<<std::endl;
+		m_os<<"\t\"scale\": "<<m_scale<<","<<std::endl;
+		m_os<<"\t\"benchmarks\": ["<<std::endl;
+	}
+
+	~Benchmarker()
+	{
+		if(m_count != 0)
+			m_os<<std::endl;
+		m_os<<"\t]"<<std::endl;
+		m_os<<"}"<<std::endl;
+	}
+
+	// Returns the number of iterations to run, or 0 to skip the benchmark
+	u32 begin(const char *name, u32 iterations)
+	{
+		if(std::string(name).compare(0, m_filter.size(), m_filter) != 0)
+			return 0;
+		m_name = name;
+		m_values = "";
+		m_iterations = MYMAX(1, (u32)(iterations * m_scale));
+		m_time1 = porting::getTimeUs();
+		return m_iterations;
+	}
+
+	// Adds a result besides the timing to the current benchmark
+	void addValue(const char *name, u64 value)
+	{
+		std::ostringstream os;
+		os<<", \""<<name<<"\": "<<value;
+		m_values += os.str();
+	}
+
+	void end()
+	{
+		u32 dtime_us = porting::getTimeUs() - m_time1;
+		if(m_count != 0)
+			m_os<<","<<std::endl;
+		m_os<<"\t\t{\"name\": \""<<m_name<<"\", "
+				<<"\"iterations\": "<<m_iterations<<", "
+				<<"\"total_us\": "<<dtime_us<<", "
+				<<"\"ns_per_iteration\": "
+				<<(u64)dtime_us * 1000 / m_iterations
+				<<m_values<<"}";
+		m_os.flush();
+		m_count++;
+	}
+
+private:
+	std::ostream &m_os;
+	float m_scale;
+	std::string m_filter;
+	u32 m_count;
+	const char *m_name;
+	std::string m_values;
+	u32 m_iterations;
+	u32 m_time1;
+};
+
+// Something like the ground: stone, a grass layer and air with light
+static void fill_block(MapBlock &block, INodeDefManager *ndef)
+{
+	content_t c_stone = ndef->getId("default:stone");
+	content_t c_grass = ndef->getId("default:dirt_with_grass");
+	for(s16 z=0; z<MAP_BLOCKSIZE; z++)
+	for(s16 y=0; y<MAP_BLOCKSIZE; y++)
+	for(s16 x=0; x<MAP_BLOCKSIZE; x++)
+	{
+		MapNode n(CONTENT_AIR, LIGHT_SUN);
+		if(y < 8 + (x + z) % 3)
+			n = MapNode(c_stone);
+		else if(y == 8 + (x + z) % 3)
+			n = MapNode(c_grass);
+		block.setNodeNoCheck(x, y, z, n);
+	}
+}
+
+static void bench_mapblock(Benchmarker &b, IGameDef *gamedef)
+{
+	MapBlock block(NULL, v3s16(0,0,0), gamedef);
+	fill_block(block, gamedef->ndef());
+
+	std::ostringstream os(std::ios_base::binary);
+	block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, true);
+	std::string data = os.str();
+
+	if(u32 n = b.begin("mapblock.serialize", 2000)){
+		for(u32 i=0; i<n; i++){
+			std::ostringstream os(std::ios_base::binary);
+			block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, true);
+		}
+		b.end();
+	}
+
+	if(u32 n = b.begin("mapblock.deserialize", 2000)){
+		for(u32 i=0; i<n; i++){
+			MapBlock block2(NULL, v3s16(0,0,0), gamedef);
+			std::istringstream is(data, std::ios_base::binary);
+			block2.deSerialize(is, SER_FMT_VER_HIGHEST_WRITE, true);
+		}
+		b.end();
+	}
+
+	if(u32 n = b.begin("mapblock.deserialize_network", 2000)){
+		std::ostringstream os(std::ios_base::binary);
+		block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, false);
+		std::string netdata = os.str();
+		for(u32 i=0; i<n; i++){
+			MapBlock block2(NULL, v3s16(0,0,0), gamedef);
+			std::istringstream is(netdata, std::ios_base::binary);
+			block2.deSerialize(is, SER_FMT_VER_HIGHEST_WRITE, false);
+		}
+		b.end();
+	}
+}
+
+/*
+	One second of a burning furnace as the default game's ABM runs it, in
+	a block that also has a full chest. Reports what a client is sent for
+	the tick: a TOCLIENT_NODEMETA_CHANGED packet, or the whole block as
+	older clients get it.
+*/
+static void bench_nodemeta(Benchmarker &b, IGameDef *gamedef)
+{
+	IItemDefManager *idef = gamedef->idef();
+	MapBlock block(NULL, v3s16(0,0,0), gamedef);
+	fill_block(block, gamedef->ndef());
+
+	v3s16 furnace_p(3,12,5);
+	NodeMetadata *furnace = new NodeMetadata(gamedef);
+	furnace->setString("infotext", "Furnace");
+	furnace->setString("fuel_totaltime", "40");
+	furnace->setString("src_totaltime", "3");
+	Inventory *inv = furnace->getInventory();
+	inv->addList("fuel", 1)->addItem(0,
+			ItemStack("default:stone", 98, 0, "", idef));
+	inv->addList("src", 1)->addItem(0,
+			ItemStack("default:stone", 99, 0, "", idef));
+	inv->addList("dst", 4)->addItem(0,
+			ItemStack("default:stone", 12, 0, "", idef));
+	block.m_node_metadata.set(furnace_p, furnace);
+
+	NodeMetadata *chest = new NodeMetadata(gamedef);
+	chest->setString("formspec", "size[8,9]list[current_name;main;0,0;8,4;]"
+			"list[current_player;main;0,5;8,4;]");
+	chest->setString("infotext", "Chest");
+	InventoryList *chest_main = chest->getInventory()->addList("main", 32);
+	for(u32 i=0; i<32; i++)
+		chest_main->addItem(i, ItemStack("default:stone", 99, 0, "", idef));
+	block.m_node_metadata.set(v3s16(4,12,5), chest);
+
+	if(u32 n = b.begin("nodemeta.furnace_tick", 2000)){
+		u64 meta_bytes = 0;
+		u64 block_bytes = 0;
+		for(u32 i=0; i<n; i++){
+			// The ABM's changes for one second
+			u32 fuel_time = i % 40 + 1;
+			u32 percent = fuel_time * 100 / 40;
+			furnace->setString("fuel_time", itos(fuel_time));
+			furnace->setString("src_time", itos(i % 3 + 1));
+			furnace->setString("infotext",
+					"Furnace active: " + itos(percent) + "%");
+			furnace->setString("formspec", "size[8,9]"
+					"image[2,2;1,1;default_furnace_fire_bg.png^[lowpart:"
+					+ itos(100 - percent) + ":default_furnace_fire_fg.png]"
+					"list[current_name;fuel;2,3;1,1;]"
+					"list[current_name;src;2,1;1,1;]"
+					"list[current_name;dst;5,1;2,2;]"
+					"list[current_player;main;0,5;8,4;]");
+
+			// Like Server::sendNodeMetadataChanges
+			std::ostringstream uncompressed(std::ios_base::binary);
+			writeU16(uncompressed, 1);
+			writeV3S16(uncompressed, furnace_p);
+			writeU8(uncompressed, 1);
+			furnace->serialize(uncompressed, false);
+			std::ostringstream compressed(std::ios_base::binary);
+			compressZlib(uncompressed.str(), compressed);
+			std::ostringstream os(std::ios_base::binary);
+			writeU16(os, TOCLIENT_NODEMETA_CHANGED);
+			os<<serializeLongString(compressed.str());
+			meta_bytes += os.str().size();
+
+			// Like Server::SendBlockNoLock
+			std::ostringstream block_os(std::ios_base::binary);
+			block.serialize(block_os, SER_FMT_VER_HIGHEST_WRITE, false);
+			block.serializeNetworkSpecific(block_os, LATEST_PROTOCOL_VERSION);
+			block_bytes += 8 + block_os.str().size();
+		}
+		b.addValue("nodemeta_bytes_per_tick", meta_bytes / n);
+		b.addValue("block_bytes_per_tick", block_bytes / n);
+		b.end();
+	}
+}
+
+static void bench_mapblock_pool(Benchmarker &b)
+{
+	// Load and unload a few hundred blocks at a time, like a player
+	// moving around does, and see what stays resident afterwards
+	if(u32 n = b.begin("mapblock.pool_load_unload", 100)){
+		const u32 batch = 500;
+		MapBlockPoolStats stats1 = g_mapblock_pool.getStats();
+		u64 rss_before = porting::getResidentMemory();
+		u64 rss_peak = rss_before;
+		std::vector<MapBlock*> blocks;
+		for(u32 i=0; i<n; i++){
+			for(u32 j=0; j<batch; j++)
+				blocks.push_back(new MapBlock(NULL, v3s16(i,j,0), NULL));
+			if(i == 0)
+				rss_peak = porting::getResidentMemory();
+			for(u32 j=0; j<blocks.size(); j++)
+				delete blocks[j];
+			blocks.clear();
+		}
+		u64 rss_after = porting::getResidentMemory();
+		MapBlockPoolStats stats2 = g_mapblock_pool.getStats();
+		b.addValue("blocks", (u64)n * batch);
+		b.addValue("blocks_reused", stats2.blocks_reused - stats1.blocks_reused);
+		b.addValue("nodes_reused", stats2.nodes_reused - stats1.nodes_reused);
+		b.addValue("rss_before_bytes", rss_before);
+		b.addValue("rss_peak_bytes", rss_peak);
+		b.addValue("rss_after_bytes", rss_after);
+		b.end();
+	}
+}
+
+/*
+	Reads random blocks through a connection of its own, like an emerge
+	thread with its own read connection would, and records how long the
+	reads take
+*/
+class BenchmarkBlockReader : public SimpleThread
+{
+public:
+	BenchmarkBlockReader(sqlite3 *db, s16 blocks):
+		SimpleThread(),
+		reads(0),
+		failed(0),
+		max_us(0),
+		m_db(db),
+		m_blocks(blocks)
+	{
+	}
+
+	void * Thread()
+	{
+		ThreadStarted();
+
+		sqlite3_stmt *read = NULL;
+		sqlite3_prepare(m_db, "SELECT `data` FROM `blocks` WHERE `pos` = ? LIMIT 1",
+				-1, &read, NULL);
+		PseudoRandom pr(2631);
+		while(getRun())
+		{
+			s16 k = pr.range(0, m_blocks - 1);
+			v3s16 p(k % 16, k / 256, k / 16 % 16);
+			u32 time1 = porting::getTimeUs();
+			// Database::getBlockAsInteger() for positive coordinates
+			sqlite3_bind_int64(read, 1,
+					(s64)p.Z * 16777216 + (s64)p.Y * 4096 + p.X);
+			if(sqlite3_step(read) == SQLITE_ROW)
+				reads++;
+			else
+				failed++;
+			sqlite3_reset(read);
+			max_us = MYMAX(max_us, porting::getTimeUs() - time1);
+		}
+		sqlite3_finalize(read);
+		return NULL;
+	}
+
+	// Only read after stop()
+	u32 reads;
+	u32 failed;
+	u32 max_us;
+
+private:
+	sqlite3 *m_db;
+	s16 m_blocks;
+};
+
+static void bench_database(Benchmarker &b, IGameDef *gamedef)
+{
+	MapBlock block(NULL, v3s16(0,0,0), gamedef);
+	fill_block(block, gamedef->ndef());
+	std::string data;
+	Database::serializeBlock(&block, data);
+
+	// The same saves into worlds with 1 to 8 sqlite3 shards, which are
+	// written by as many threads; each save has 1024 blocks in as many
+	// regions
+	const u32 shard_counts[] = {1, 2, 4, 8};
+	const char *names[] = {"database.sharded_save_1_thread",
+			"database.sharded_save_2_threads",
+			"database.sharded_save_4_threads",
+			"database.sharded_save_8_threads"};
+	const s16 blocks_per_save = 1024;
+	for(u32 i=0; i<4; i++)
+	{
+		std::string dir = fs::TempPath() + DIR_DELIM + "mtbenchmark_shards";
+		fs::RecursiveDelete(dir);
+		if(u32 n = b.begin(names[i], 20)){
+			{
+				Database_Sharded db(NULL, dir, "sqlite3", shard_counts[i]);
+				for(u32 j=0; j<n; j++){
+					db.beginSave();
+					for(s16 k=0; k<blocks_per_save; k++)
+						db.saveBlockData(v3s16(k % 32 * 8, j, k / 32 * 8), data);
+					db.endSave();
+				}
+			}
+			b.addValue("blocks", (u64)n * blocks_per_save);
+			b.end();
+		}
+		fs::RecursiveDelete(dir);
+	}
+
+	/*
+		Loads on a second connection while 1024 blocks at a time are
+		saved, with the write-ahead log and with the rollback journal
+		the backend used before
+	*/
+	std::string journal_mode = g_settings->get("sqlite_journal_mode");
+	const char *journal_modes[] = {"wal", "delete"};
+	const char *concurrent_names[] = {"database.concurrent_load_save_wal",
+			"database.concurrent_load_save_rollback"};
+	for(u32 i=0; i<2; i++)
+	{
+		std::string dir = fs::TempPath() + DIR_DELIM + "mtbenchmark_concurrent";
+		fs::RecursiveDelete(dir);
+		fs::CreateAllDirs(dir);
+		g_settings->set("sqlite_journal_mode", journal_modes[i]);
+		if(u32 n = b.begin(concurrent_names[i], 20)){
+			Database_SQLite3 db(NULL, dir);
+			db.beginSave();
+			for(s16 k=0; k<4096; k++)
+				db.saveBlockData(v3s16(k % 16, k / 256, k / 16 % 16), data);
+			db.endSave();
+
+			sqlite3 *read_db = NULL;
+			if(sqlite3_open_v2((dir + DIR_DELIM + "map.sqlite").c_str(),
+					&read_db, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK){
+				sqlite3_busy_timeout(read_db, 5000);
+				BenchmarkBlockReader reader(read_db, 4096);
+				reader.Start();
+				for(u32 j=0; j<n; j++){
+					db.beginSave();
+					for(s16 k=0; k<1024; k++)
+						db.saveBlockData(v3s16(k % 16, k / 256 + 8 * (j % 2),
+								k / 16 % 16), data);
+					db.endSave();
+				}
+				reader.stop();
+				b.addValue("reads", reader.reads);
+				b.addValue("failed_reads", reader.failed);
+				b.addValue("read_max_us", reader.max_us);
+			}
+			sqlite3_close(read_db);
+			b.addValue("saved_blocks", n * 1024);
+			b.end();
+		}
+		fs::RecursiveDelete(dir);
+	}
+	g_settings->set("sqlite_journal_mode", journal_mode);
+
+	/*
+		How long starting a snapshot of 4096 blocks stalls the caller;
+		the copying itself is done in a thread. Snapshots need WAL.
+	*/
+	g_settings->set("sqlite_journal_mode", "wal");
+	std::string dir = fs::TempPath() + DIR_DELIM + "mtbenchmark_snapshot";
+	fs::RecursiveDelete(dir);
+	if(u32 n = b.begin("database.snapshot_pause", 20)){
+		u64 pause_total_us = 0;
+		u64 pause_max_us = 0;
+		u32 failed = 0;
+		{
+			Database_SQLite3 db(NULL, dir);
+			db.beginSave();
+			for(s16 k=0; k<4096; k++)
+				db.saveBlockData(v3s16(k % 16, k / 256, k / 16 % 16), data);
+			db.endSave();
+			for(u32 j=0; j<n; j++){
+				std::string target = dir + DIR_DELIM + "snapshot" + itos(j);
+				fs::CreateAllDirs(target);
+				// Fails while the previous copy is running; give up
+				// after 10s in case it fails for good
+				for(u32 tries=0; ; tries++){
+					u32 time1 = porting::getTimeUs();
+					bool started = db.startBackup(target);
+					u32 pause_us = porting::getTimeUs() - time1;
+					if(started){
+						pause_total_us += pause_us;
+						pause_max_us = MYMAX(pause_max_us, pause_us);
+						break;
+					}
+					if(tries == 10000){
+						failed++;
+						break;
+					}
+					sleep_ms(1);
+				}
+			}
+		}
+		b.addValue("blocks", 4096);
+		b.addValue("pause_total_us", pause_total_us);
+		b.addValue("pause_max_us", pause_max_us);
+		b.addValue("failed", failed);
+		b.end();
+	}
+	fs::RecursiveDelete(dir);
+	g_settings->set("sqlite_journal_mode", journal_mode);
+}
+
+static void bench_compression(Benchmarker &b)
+{
+	// Node data of a block: mostly runs, some noise
+	std::string data(MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE * 4, 0);
+	PseudoRandom pr(12345);
+	for(u32 i=0; i<data.size(); i++)
+		data[i] = (i / 64) % 4 == 0 ? pr.next() % 256 : (i / 256) % 16;
+
+	std::ostringstream os(std::ios_base::binary);
+	compressZlib(data, os);
+	std::string compressed = os.str();
+
+	if(u32 n = b.begin("compression.zlib_compress", 1000)){
+		for(u32 i=0; i<n; i++){
+			std::ostringstream os(std::ios_base::binary);
+			compressZlib(data, os);
+		}
+		b.end();
+	}
+
+	if(u32 n = b.begin("compression.zlib_decompress", 2000)){
+		for(u32 i=0; i<n; i++){
+			std::istringstream is(compressed, std::ios_base::binary);
+			std::ostringstream os(std::ios_base::binary);
+			decompressZlib(is, os);
+		}
+		b.end();
+	}
+}
+
+static void bench_noise(Benchmarker &b)
+{
+	NoiseParams np;
+	np.offset = 0;
+	np.scale = 1;
+	np.spread = v3f(250, 250, 250);
+	np.seed = 82341;
+	np.octaves = 5;
+	np.persist = 0.6;
+
+	// Sizes of a mapchunk
+	if(u32 n = b.begin("noise.perlin_map_2d_80x80", 200)){
+		Noise noise(&np, 1, 80, 80);
+		for(u32 i=0; i<n; i++)
+			noise.perlinMap2D(i * 80, 0);
+		b.end();
+	}
+
+	if(u32 n = b.begin("noise.perlin_map_3d_80x80x80", 5)){
+		Noise noise(&np, 1, 80, 80, 80);
+		for(u32 i=0; i<n; i++)
+			noise.perlinMap3D(i * 80, 0, 0);
+		b.end();
+	}
+}
+
+static void bench_voxel(Benchmarker &b, INodeDefManager *ndef)
+{
+	const s16 bs = MAP_BLOCKSIZE;
+	VoxelArea block_area(v3s16(0,0,0), v3s16(bs-1,bs-1,bs-1));
+	MapNode *nodes = new MapNode[bs * bs * bs];
+	for(s32 i=0; i<bs * bs * bs; i++)
+		nodes[i] = MapNode(i % 7 == 0 ? ndef->getId("default:stone") : CONTENT_AIR);
+
+	// Like a VoxelManipulator for a mapchunk plus a border of blocks
+	if(u32 n = b.begin("voxelmanip.copy_block", 5000)){
+		VoxelManipulator v;
+		v.addArea(VoxelArea(v3s16(0,0,0), v3s16(bs*3-1,bs*3-1,bs*3-1)));
+		for(u32 i=0; i<n; i++){
+			v3s16 p = v3s16(i % 3, (i / 3) % 3, (i / 9) % 3) * bs;
+			v.copyFrom(nodes, block_area, v3s16(0,0,0), p, v3s16(bs,bs,bs));
+			v.copyTo(nodes, block_area, v3s16(0,0,0), p, v3s16(bs,bs,bs));
+		}
+		b.end();
+	}
+
+	if(u32 n = b.begin("lighting.sunlight_block", 500)){
+		VoxelManipulator v;
+		v.addArea(block_area);
+		v.copyFrom(nodes, block_area, v3s16(0,0,0), v3s16(0,0,0),
+				v3s16(bs,bs,bs));
+		for(u32 i=0; i<n; i++){
+			std::set<v3s16> light_sources;
+			voxalgo::setLight(v, block_area, 0, ndef);
+			voxalgo::propagateSunlight(v, block_area, true,
+					light_sources, ndef);
+		}
+		b.end();
+	}
+
+	delete[] nodes;
+}
+
+static void bench_collision(Benchmarker &b)
+{
+	if(u32 n = b.begin("collision.axis_aligned", 1000000)){
+		aabb3f staticbox(-0.5*BS, -0.5*BS, -0.5*BS, 0.5*BS, 0.5*BS, 0.5*BS);
+		int collisions = 0;
+		for(u32 i=0; i<n; i++){
+			f32 x = (f32)(i % 100) / 10 - 5;
+			aabb3f movingbox(x*BS, 1*BS, 0, (x+0.6)*BS, 2.7*BS, 0.6*BS);
+			f32 dtime = 0;
+			if(axisAlignedCollision(staticbox, movingbox,
+					v3f(0, -10*BS, 0), 1, dtime) != -1)
+				collisions++;
+		}
+		b.end();
+		// Keep the compiler from dropping the loop
+		if(collisions < 0)
+			infostream<<collisions<<std::endl;
+	}
+}
+
+static void bench_itemstring(Benchmarker &b, IItemDefManager *idef)
+{
+	if(u32 n = b.begin("inventory.itemstring_parse_print", 200000)){
+		const char *itemstrings[] = {
+			"default:stone 99", "default:torch 1 12000",
+			"default:dirt_with_grass 1 0 meta", "default:stone",
+		};
+		ItemStack item;
+		for(u32 i=0; i<n; i++){
+			item.deSerialize(std::string(itemstrings[i % 4]), idef);
+			item.getItemString();
+		}
+		b.end();
+	}
+}
+
+class BenchmarkInventoryManager : public InventoryManager
+{
+public:
+	BenchmarkInventoryManager(IItemDefManager *idef):
+		m_inventory(idef)
+	{
+		InventoryList *list = m_inventory.addList("main", 32);
+		list->addItem(0, ItemStack("default:stone", 64, 0, "", idef));
+	}
+	Inventory* getInventory(const InventoryLocation &loc)
+	{ return &m_inventory; }
+
+private:
+	Inventory m_inventory;
+};
+
+/*
+	Single item moves within a player inventory, the kind of action a
+	client sends for every right-click while spreading a stack. Each
+	iteration is one action, 64 moves out of slot 0 followed by the 64
+	moves back. Same-player moves run no callbacks and no rollback.
+*/
+static void bench_inventory_actions(Benchmarker &b, IItemDefManager *idef)
+{
+	std::vector<std::string> text;
+	std::string binary;
+	for(u32 i=0; i<128; i++){
+		IMoveAction a;
+		a.count = 1;
+		a.from_inv.setPlayer("bench");
+		a.from_list = "main";
+		a.from_i = i < 64 ? 0 : 1;
+		a.to_inv = a.from_inv;
+		a.to_list = "main";
+		a.to_i = i < 64 ? 1 : 0;
+		std::ostringstream os(std::ios_base::binary);
+		a.serialize(os);
+		text.push_back(os.str());
+		std::ostringstream os2(std::ios_base::binary);
+		a.serializeBinary(os2);
+		binary += os2.str();
+	}
+
+	// One TOSERVER_INVENTORY_ACTION per action
+	if(u32 n = b.begin("inventory.actions_text", 200000)){
+		BenchmarkInventoryManager mgr(idef);
+		u32 time1 = porting::getTimeUs();
+		for(u32 i=0; i<n; i++){
+			std::istringstream is(text[i % 128], std::ios_base::binary);
+			InventoryAction *a = InventoryAction::deSerialize(is);
+			a->apply(&mgr, NULL, NULL);
+			delete a;
+		}
+		u32 dtime_us = MYMAX(1, porting::getTimeUs() - time1);
+		b.addValue("actions_per_s", (u64)n * 1000000 / dtime_us);
+		b.end();
+	}
+	// TOSERVER_INVENTORY_ACTIONS with 64 actions per packet
+	if(u32 n = b.begin("inventory.actions_binary", 200000)){
+		BenchmarkInventoryManager mgr(idef);
+		std::string half[2] = {
+			binary.substr(0, binary.size() / 2),
+			binary.substr(binary.size() / 2),
+		};
+		u32 decoded = 0;
+		u32 applied = 0;
+		u32 time1 = porting::getTimeUs();
+		for(; decoded<n; decoded+=64){
+			std::istringstream is(half[decoded / 64 % 2],
+					std::ios_base::binary);
+			std::vector<InventoryAction*> actions;
+			for(u32 j=0; j<64; j++)
+				actions.push_back(InventoryAction::deSerializeBinary(is));
+			InventoryAction::coalesce(actions);
+			for(u32 j=0; j<actions.size(); j++){
+				actions[j]->apply(&mgr, NULL, NULL);
+				delete actions[j];
+			}
+			applied += actions.size();
+		}
+		u32 dtime_us = MYMAX(1, porting::getTimeUs() - time1);
+		b.addValue("actions_per_s", (u64)decoded * 1000000 / dtime_us);
+		b.addValue("applied", applied);
+		b.end();
+	}
+}
+
+static int l_benchmark_increment(lua_State *L)
+{
+	lua_pushinteger(L, lua_tointeger(L, 1) + 1);
+	return 1;
+}
+
+static void bench_lua(Benchmarker &b)
+{
+	if(u32 n = b.begin("lua.c_function_call", 2000000)){
+		lua_State *L = luaL_newstate();
+		if(luaL_loadstring(L,
+				"local f, n = ... local x = 0 "
+				"for i = 1, n do x = f(x) end") == 0){
+			lua_pushcfunction(L, l_benchmark_increment);
+			lua_pushinteger(L, n);
+			if(lua_pcall(L, 2, 0, 0) != 0)
+				errorstream<<"Benchmark: "<<lua_tostring(L, -1)<<std::endl;
+		}
+		lua_close(L);
+		b.end();
+	}
+}
+
+// The minetest.after of builtin/misc.lua before the timers moved into
+// ScriptApiEnv: a table of pending timers walked on every step
+static const char *benchmark_lua_timers =
+	"local timers_to_add, timers = {}, {} "
+	"local function after(time, func, ...) "
+	"table.insert(timers_to_add, {time=time, func=func, args={...}}) end "
+	"local function step(dtime) "
+	"for _, timer in ipairs(timers_to_add) do "
+	"table.insert(timers, timer) end "
+	"timers_to_add = {} "
+	"for index, timer in ipairs(timers) do "
+	"timer.time = timer.time - dtime "
+	"if timer.time <= 0 then "
+	"timer.func(unpack(timer.args or {})) "
+	"table.remove(timers, index) end end end "
+	"local n = ... "
+	"for i = 0, n - 1 do after(0.01 + (i % 1000) * 0.01, function() end) end "
+	"return step";
+
+class BenchmarkTimerScript : public ScriptApiEnv
+{
+public:
+	lua_State *getState() { return getStack(); }
+};
+
+static void bench_timers(Benchmarker &b)
+{
+	// 100k pending minetest.after timers expiring over 10 seconds, stepped
+	// like a server with the default dedicated_server_step
+	const u32 timer_count = 100000;
+	const float dtime = 0.05;
+
+	if(u32 n = b.begin("timers.lua_table_100k", 200)){
+		lua_State *L = luaL_newstate();
+		luaL_openlibs(L);
+		if(luaL_loadstring(L, benchmark_lua_timers) != 0){
+			errorstream<<"Benchmark: "<<lua_tostring(L, -1)<<std::endl;
+		} else {
+			lua_pushinteger(L, timer_count);
+			if(lua_pcall(L, 1, 1, 0) != 0)
+				errorstream<<"Benchmark: "<<lua_tostring(L, -1)<<std::endl;
+		}
+		if(lua_isfunction(L, -1)){
+			int step = lua_gettop(L);
+			for(u32 i=0; i<n; i++){
+				lua_pushvalue(L, step);
+				lua_pushnumber(L, dtime);
+				if(lua_pcall(L, 1, 0, 0) != 0){
+					errorstream<<"Benchmark: "<<lua_tostring(L, -1)<<std::endl;
+					break;
+				}
+			}
+		}
+		lua_close(L);
+		b.end();
+	}
+
+	if(u32 n = b.begin("timers.native_heap_100k", 200)){
+		BenchmarkTimerScript script;
+		lua_State *L = script.getState();
+		luaL_openlibs(L);
+		luaL_loadstring(L, "return function() end");
+		lua_call(L, 0, 1);
+		int func = lua_gettop(L);
+		for(u32 i=0; i<timer_count; i++){
+			lua_newtable(L);
+			lua_pushvalue(L, func);
+			lua_setfield(L, -2, "func");
+			script.addTimer(0.01 + (i % 1000) * 0.01,
+					luaL_ref(L, LUA_REGISTRYINDEX));
+		}
+		lua_pop(L, 1);
+		try{
+			for(u32 i=0; i<n; i++)
+				script.runTimers(dtime);
+		}
+		catch(LuaError &e){
+			errorstream<<"Benchmark: "<<e.what()<<std::endl;
+		}
+		b.end();
+	}
+}
+
+static void bench_objects(Benchmarker &b)
+{
+	// A server with 60k active objects: each iteration removes a random
+	// object and adds a new one, like ServerEnvironment does with
+	// m_active_objects and m_free_object_ids
+	const u32 object_count = 60000;
+
+	if(u32 n = b.begin("objects.add_remove_60k", 200000)){
+		std::map<u16, ServerActiveObject*> objects;
+		std::deque<u16> free_ids;
+		for(u32 id=1; id<=0xffff; id++)
+			free_ids.push_back(id);
+		std::vector<u16> ids;
+		for(u32 i=0; i<object_count; i++){
+			u16 id = getFreeServerActiveObjectId(objects, free_ids);
+			objects[id] = NULL;
+			ids.push_back(id);
+		}
+		PseudoRandom pr(2631);
+		u32 found = 0;
+		u32 time1 = porting::getTimeUs();
+		for(u32 i=0; i<n; i++){
+			u32 k = ((u32)pr.next() * 32768 + pr.next()) % object_count;
+			objects.erase(ids[k]);
+			free_ids.push_back(ids[k]);
+			u16 id = getFreeServerActiveObjectId(objects, free_ids);
+			if(id == 0)
+				break;
+			objects[id] = NULL;
+			ids[k] = id;
+			if(objects.find(ids[(k + 1) % object_count]) != objects.end())
+				found++;
+		}
+		u32 dtime_us = MYMAX(1, porting::getTimeUs() - time1);
+		b.addValue("objects", objects.size());
+		b.addValue("lookups_found", found);
+		b.addValue("add_removes_per_s", (u64)n * 1000000 / dtime_us);
+		b.end();
+	}
+}
+
+// Chunks along the X axis around the ground level, each one freshly
+// allocated like ServerMap::initBlockMake does
+static void bench_chunks(Benchmarker &b, const char *name, Mapgen *mg,
+		MapgenParams *params, INodeDefManager *ndef)
+{
+	s16 chunksize = params->chunksize;
+	if(u32 n = b.begin(name, 20)){
+		for(u32 j=0; j<n; j++){
+			BlockMakeData data;
+			data.seed = params->seed;
+			data.nodedef = ndef;
+			data.blockpos_min = v3s16((s16)j * chunksize, 0, 0) -
+					v3s16(1,1,1) * (chunksize / 2);
+			data.blockpos_max = data.blockpos_min +
+					v3s16(1,1,1) * (chunksize - 1);
+			data.blockpos_requested = data.blockpos_min;
+			data.vmanip = new ManualMapVoxelManipulator(NULL);
+			data.vmanip->addArea(VoxelArea(
+					(data.blockpos_min - v3s16(1,1,1)) * MAP_BLOCKSIZE,
+					(data.blockpos_max + v3s16(2,2,2)) * MAP_BLOCKSIZE
+					- v3s16(1,1,1)));
+			mg->makeChunk(&data);
+		}
+		b.end();
+	}
+}
+
+static void bench_mapgen(Benchmarker &b, IGameDef *gamedef)
+{
+	{
+		// Without Server::start() no emerge threads are ever started
+		EmergeManager emerge(gamedef);
+		emerge.biomedef->resolveNodeNames(gamedef->ndef());
+
+		// The last one is v7 as it was before its 3d noise was restricted
+		// to where it can change the terrain
+		const char *mgnames[] = {"v6", "v7", "v7"};
+		const char *names[] = {"mapgen.v6_chunk", "mapgen.v7_chunk",
+				"mapgen.v7_chunk_full_3d_noise"};
+		for(u32 i=0; i<3; i++)
+		{
+			MapgenParams *params = emerge.createMapgenParams(mgnames[i]);
+			params->seed = 2631;
+			emerge.params = params;
+			Mapgen *mg = emerge.createMapgen(mgnames[i], 0, params);
+			if(i == 2)
+				((MapgenV7 *)mg)->full_3d_noise = true;
+
+			bench_chunks(b, names[i], mg, params, gamedef->ndef());
+
+			delete mg;
+			emerge.params = NULL;
+			delete params;
+		}
+	}
+
+	/*
+		v7 chunks with 250 decorations, like a game with many biomes: only
+		every tenth one may appear anywhere, the others are restricted to
+		biomes that are not in the chunk
+	*/
+	EmergeManager *emerge = new EmergeManager(gamedef);
+	for(u32 i=0; i<250; i++)
+	{
+		DecoSimple *deco = new DecoSimple;
+		deco->mapseed = 2631 + i;
+		deco->place_on_name = "default:stone";
+		deco->c_place_on = CONTENT_IGNORE;
+		deco->sidelen = 16;
+		deco->fill_ratio = 0.005;
+		deco->deco_name = "default:junglegrass";
+		deco->c_deco = CONTENT_IGNORE;
+		deco->c_spawnby = CONTENT_AIR;
+		deco->nspawnby = -1;
+		deco->deco_height = 1;
+		deco->deco_height_max = 0;
+		if(i % 10 != 0)
+			deco->biomes.insert(1 + i % 24);
+		emerge->decorations.push_back(deco);
+	}
+	MapgenParams *params = emerge->createMapgenParams("v7");
+	params->seed = 2631;
+	emerge->initMapgens(params);
+	bench_chunks(b, "mapgen.v7_chunk_250_decorations", emerge->mapgen[0],
+			emerge->params, gamedef->ndef());
+	params = emerge->params;
+	delete emerge;
+	delete params;
+}
+
+static void bench_abm(Benchmarker &b, INodeDefManager *ndef)
+{
+	lua_State *L = luaL_newstate();
+	luaL_openlibs(L);
+	if(luaL_loadstring(L,
+			"return function(pos, node, active_object_count, "
+			"active_object_count_wider) "
+			"local x = pos.x + pos.y + pos.z + node.param2 end") != 0 ||
+			lua_pcall(L, 0, 1, 0) != 0){
+		errorstream<<"Benchmark: "<<lua_tostring(L, -1)<<std::endl;
+		lua_close(L);
+		return;
+	}
+	int action_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	MapNode n(ndef->getId("default:stone"));
+	std::set<std::string> none;
+	const char *names[] = {"abm.dispatch", "abm.dispatch_reuse_arguments"};
+	for(u32 i=0; i<2; i++)
+	{
+		// The same path as ActiveBlockModifier::trigger, minus the lookup
+		// of the environment's script interface
+		LuaABM abm(L, action_ref, i == 1, none, none, 1, 1);
+		if(u32 count = b.begin(names[i], 500000)){
+			try{
+				for(u32 j=0; j<count; j++)
+					abm.callAction(L, v3s16(j % 16, j / 16 % 16, j / 256 % 16),
+							n, ndef, 0, 0);
+			}
+			catch(LuaError &e){
+				errorstream<<"Benchmark: "<<e.what()<<std::endl;
+			}
+			b.end();
+		}
+	}
+
+	lua_close(L);
+}
+
+// A world directory for a ServerMap that is not saved anywhere
+static std::string create_dummy_world(const char *name)
+{
+	std::string dir = fs::TempPath() + DIR_DELIM + name;
+	fs::RecursiveDelete(dir);
+	fs::CreateAllDirs(dir);
+	Settings conf;
+	conf.set("backend", "dummy");
+	conf.updateConfigFile((dir + DIR_DELIM + "world.mt").c_str());
+	return dir;
+}
+
+/*
+	A 25x25 area of sand, 16 nodes deep, loses the cobble it stands on
+	and falls 8 nodes onto stone; 10000 nodes that the environment moves
+	as columns, without entities
+*/
+static void bench_falling(Benchmarker &b, IGameDef *gamedef)
+{
+	INodeDefManager *ndef = gamedef->ndef();
+	content_t c_stone = ndef->getId("default:stone");
+	content_t c_cobble = ndef->getId("default:cobble");
+	content_t c_sand = ndef->getId("default:sand");
+
+	if(u32 n = b.begin("environment.falling_collapse_10k", 5)){
+		u64 collapse_total_us = 0;
+		u32 settled = 0;
+		for(u32 i=0; i<n; i++){
+			std::string dir = create_dummy_world("mtbenchmark_falling");
+			EmergeManager emerge(gamedef);
+			ServerMap *map = new ServerMap(dir, gamedef, &emerge);
+			ServerEnvironment env(map, NULL, gamedef, NULL);
+
+			v3s16 bp;
+			for(bp.Z=-1; bp.Z<=2; bp.Z++)
+			for(bp.Y=-1; bp.Y<=2; bp.Y++)
+			for(bp.X=-1; bp.X<=2; bp.X++){
+				MapBlock *block = map->createBlock(bp);
+				v3s16 p;
+				for(p.Z=0; p.Z<MAP_BLOCKSIZE; p.Z++)
+				for(p.Y=0; p.Y<MAP_BLOCKSIZE; p.Y++)
+				for(p.X=0; p.X<MAP_BLOCKSIZE; p.X++){
+					s16 y = bp.Y * MAP_BLOCKSIZE + p.Y;
+					content_t c = CONTENT_AIR;
+					if(y <= 0)
+						c = c_stone;
+					else if(y == 9)
+						c = c_cobble;
+					else if(y >= 10 && y < 26)
+						c = c_sand;
+					MapNode n(c);
+					block->setNodeNoCheck(p, n);
+				}
+			}
+
+			u32 time1 = porting::getTimeUs();
+			// Digging the cobble, like on_dignode did
+			for(s16 z=0; z<25; z++)
+			for(s16 x=0; x<25; x++){
+				v3s16 p(x, 9, z);
+				env.removeNode(p);
+				env.checkForFalling(p);
+			}
+			// The neighbours are checked 0.1s later, and the neighbours
+			// of what fell then
+			for(u32 j=0; j<10; j++)
+				env.stepFallingNodes(0.1);
+			collapse_total_us += porting::getTimeUs() - time1;
+
+			for(s16 z=0; z<25; z++)
+			for(s16 y=1; y<17; y++)
+			for(s16 x=0; x<25; x++){
+				if(map->getNodeNoEx(v3s16(x, y, z)).getContent() == c_sand)
+					settled++;
+			}
+		}
+		b.addValue("collapse_us", collapse_total_us / n);
+		b.addValue("nodes", 25 * 25 * 16);
+		b.addValue("settled", settled / n);
+		b.end();
+	}
+	fs::RecursiveDelete(fs::TempPath() + DIR_DELIM + "mtbenchmark_falling");
+}
+
+class BenchmarkNodeScript : public ScriptApiEnv
+{
+public:
+	BenchmarkNodeScript(ServerEnvironment *env) { setEnv(env); }
+	lua_State *getState() { return getStack(); }
+};
+
+/*
+	The node accessors of the Lua API called from a Lua loop over one
+	generated block: the table based ones, which build and read a node
+	table with pushnode and readnode, and the content id based ones
+*/
+static void bench_lua_nodes(Benchmarker &b, IGameDef *gamedef)
+{
+	const char *names[] = {"lua.get_node", "lua.get_node_raw",
+			"lua.set_node", "lua.set_node_raw"};
+	const char *scripts[] = {
+		"local n, c = ... local get, p = minetest.get_node, {x=0, y=4, z=7} "
+		"for i = 1, n do p.x = i % 16 local node = get(p) end",
+		"local n, c = ... local get = minetest.get_node_raw "
+		"for i = 1, n do local id, param1, param2 = get(i % 16, 4, 7) end",
+		"local n, c = ... local set, p = minetest.set_node, {x=0, y=4, z=7} "
+		"local node = {name='default:stone'} "
+		"for i = 1, n do p.x = i % 16 set(p, node) end",
+		"local n, c = ... local set = minetest.set_node_raw "
+		"for i = 1, n do set(i % 16, 4, 7, c) end",
+	};
+	const u32 iterations[] = {500000, 1000000, 100000, 100000};
+
+	std::string dir = create_dummy_world("mtbenchmark_lua_nodes");
+	{
+		EmergeManager emerge(gamedef);
+		ServerMap *map = new ServerMap(dir, gamedef, &emerge);
+		ServerEnvironment env(map, NULL, gamedef, NULL);
+		fill_block(*map->createBlock(v3s16(0,0,0)), gamedef->ndef());
+
+		BenchmarkNodeScript script(&env);
+		lua_State *L = script.getState();
+		luaL_openlibs(L);
+		lua_newtable(L);
+		ModApiEnvMod::Initialize(L, lua_gettop(L));
+		lua_setglobal(L, "minetest");
+
+		for(u32 i=0; i<4; i++)
+		{
+			if(u32 n = b.begin(names[i], iterations[i])){
+				u32 time1 = porting::getTimeUs();
+				if(luaL_loadstring(L, scripts[i]) != 0){
+					errorstream<<"Benchmark: "<<lua_tostring(L, -1)<<std::endl;
+				} else {
+					lua_pushinteger(L, n);
+					lua_pushinteger(L, gamedef->ndef()->getId("default:stone"));
+					if(lua_pcall(L, 2, 0, 0) != 0)
+						errorstream<<"Benchmark: "<<lua_tostring(L, -1)<<std::endl;
+				}
+				lua_settop(L, 0);
+				u32 dtime_us = MYMAX(1, porting::getTimeUs() - time1);
+				b.addValue("calls_per_s", (u64)n * 1000000 / dtime_us);
+				b.end();
+			}
+		}
+	}
+	fs::RecursiveDelete(dir);
+}
+
+#ifndef SERVER
+/*
+	One frame of the render queue of ClientMap::renderMap with the null
+	driver: 1000 blocks of 6 mesh buffers over 300 materials, a tenth of
+	them transparent, bucketed, sorted back to front and drawn.
+	renderMap itself needs a connected Client, so the frame is put
+	together here from the same pieces.
+*/
+static void bench_render_queue(Benchmarker &b)
+{
+	IrrlichtDevice *device = createDevice(video::EDT_NULL);
+	if(device == NULL)
+		return;
+	video::IVideoDriver *driver = device->getVideoDriver();
+
+	std::vector<video::ITexture*> textures;
+	for(u32 i=0; i<300; i++)
+		textures.push_back(driver->addTexture(core::dimension2d<u32>(16,16),
+				(std::string("benchmark_") + itos(i)).c_str()));
+
+	PseudoRandom pr(2631);
+	std::vector<scene::SMeshBuffer*> bufs;
+	std::vector<f32> distances;
+	for(u32 i=0; i<1000; i++)
+	{
+		f32 d = pr.range(0, 1000) * BS;
+		for(u32 j=0; j<6; j++)
+		{
+			scene::SMeshBuffer *buf = new scene::SMeshBuffer();
+			s32 material = pr.range(0, 299);
+			buf->getMaterial().setTexture(0, textures[material]);
+			buf->getMaterial().MaterialType = material % 10 == 0 ?
+					video::EMT_TRANSPARENT_ALPHA_CHANNEL : video::EMT_SOLID;
+			video::S3DVertex v(0,0,0, 0,1,0,
+					video::SColor(255,255,255,255), 0,0);
+			for(u32 k=0; k<4; k++)
+				buf->Vertices.push_back(v);
+			const u16 indices[] = {0,1,2,2,3,0};
+			for(u32 k=0; k<6; k++)
+				buf->Indices.push_back(indices[k]);
+			bufs.push_back(buf);
+			distances.push_back(d);
+		}
+	}
+
+	if(u32 n = b.begin("clientmap.render_queue_null_driver", 500)){
+		MeshBufListList solid_bufs;
+		std::vector<TransparentMeshBuf> transparent_bufs;
+		u64 meshbuffer_count = 0;
+		for(u32 i=0; i<n; i++){
+			driver->beginScene(true, true, video::SColor(255,0,0,0));
+			solid_bufs.clear();
+			transparent_bufs.clear();
+			for(u32 j=0; j<bufs.size(); j++){
+				// The null driver has no material renderers to ask
+				if(bufs[j]->getMaterial().isTransparent())
+					transparent_bufs.push_back(
+							TransparentMeshBuf(distances[j], bufs[j]));
+				else
+					solid_bufs.add(bufs[j]);
+			}
+			for(std::vector<MeshBufList>::iterator
+					j = solid_bufs.lists.begin();
+					j != solid_bufs.lists.end(); ++j){
+				if(j->bufs.empty())
+					continue;
+				driver->setMaterial(j->m);
+				for(u32 k=0; k<j->bufs.size(); k++){
+					driver->drawMeshBuffer(j->bufs[k]);
+					meshbuffer_count++;
+				}
+			}
+			sortTransparentMeshBufs(transparent_bufs);
+			for(u32 j=0; j<transparent_bufs.size(); j++){
+				scene::IMeshBuffer *buf = transparent_bufs[j].buf;
+				driver->setMaterial(buf->getMaterial());
+				driver->drawMeshBuffer(buf);
+				meshbuffer_count++;
+			}
+			driver->endScene();
+		}
+		b.addValue("meshbuffers_per_frame", meshbuffer_count / n);
+		b.addValue("material_buckets", solid_bufs.lists.size());
+		b.end();
+	}
+
+	for(u32 i=0; i<bufs.size(); i++)
+		bufs[i]->drop();
+	device->drop();
+}
+#endif
+
+static void bench_connection(Benchmarker &b)
+{
+	// Like TestConnection, but on its own port
+	u32 proto_id = 0xad26846a;
+	u16 port = 30002;
+	con::Connection server(proto_id, 512, 5.0, false);
+	con::Connection client(proto_id, 512, 5.0, false);
+	server.SetTimeoutMs(10);
+	client.SetTimeoutMs(10);
+	server.Serve(port);
+	client.Connect(Address(127,0,0,1, port));
+
+	u16 peer_id;
+	SharedBuffer<u8> data;
+	u32 time1 = porting::getTimeMs();
+	while(client.Connected() == false){
+		if(porting::getTimeMs() - time1 > 5000){
+			errorstream<<"Benchmark: connection over loopback failed; "
+					"skipping connection benchmarks"<<std::endl;
+			return;
+		}
+		try{
+			client.Receive(peer_id, data);
+		}
+		catch(con::NoIncomingDataException &e){
+		}
+		try{
+			server.Receive(peer_id, data);
+		}
+		catch(con::NoIncomingDataException &e){
+		}
+	}
+
+	// Reliable packets of about the size of a block, in bursts so that the
+	// receiving side never waits for the next send
+	if(u32 n = b.begin("connection.loopback_send_receive", 2000)){
+		const u32 burst = 50;
+		SharedBuffer<u8> packet(400);
+		for(u32 i=0; i<packet.getSize(); i++)
+			packet[i] = i % 256;
+		u32 lost = 0;
+		for(u32 sent=0; sent<n; ){
+			u32 count = MYMIN(burst, n - sent);
+			for(u32 i=0; i<count; i++)
+				client.Send(PEER_ID_SERVER, 0, packet, true);
+			sent += count;
+			for(u32 received=0; received<count; ){
+				try{
+					server.Receive(peer_id, data);
+					received++;
+				}
+				catch(con::NoIncomingDataException &e){
+					// Nothing for a second; don't hang on a broken loopback
+					if(++lost > 100)
+						break;
+				}
+			}
+		}
+		b.end();
+		if(lost > 100)
+			errorstream<<"Benchmark: packets were lost over loopback"
+					<<std::endl;
+	}
+}
+
+void run_benchmarks(std::ostream &os, float scale, const std::string &filter)
+{
+	DSTACK(__FUNCTION_NAME);
+
+	BenchmarkGameDef gamedef;
+
+	infostream<<"run_benchmarks() started"<<std::endl;
+	{
+		Benchmarker b(os, scale, filter);
+		bench_mapblock(b, &gamedef);
+		bench_nodemeta(b, &gamedef);
+		bench_mapblock_pool(b);
+		bench_database(b, &gamedef);
+		bench_compression(b);
+		bench_noise(b);
+		bench_voxel(b, gamedef.ndef());
+		bench_collision(b);
+		bench_itemstring(b, gamedef.idef());
+		bench_inventory_actions(b, gamedef.idef());
+		bench_lua(b);
+		bench_timers(b);
+		bench_objects(b);
+		bench_mapgen(b, &gamedef);
+		bench_abm(b, gamedef.ndef());
+		bench_falling(b, &gamedef);
+		bench_lua_nodes(b, &gamedef);
+		bench_connection(b);
+#ifndef SERVER
+		bench_render_queue(b);
+#endif
+	}
+	infostream<<"run_benchmarks() done"<<std::endl;
+}
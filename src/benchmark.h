@@ -0,0 +1,35 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef BENCHMARK_HEADER
+#define BENCHMARK_HEADER
+
+#include <iostream>
+#include <string>
+
+/*
+	Runs the benchmarks whose names start with filter and writes the
+	results to os as JSON. Iteration counts are multiplied by scale.
+	Needs no server, client or graphics. The connection benchmark uses
+	UDP port 30002 on the loopback interface, the database benchmarks
+	write to the temporary directory.
+*/
+void run_benchmarks(std::ostream &os, float scale, const std::string &filter);
+
+#endif
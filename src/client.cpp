@@ -46,6 +46,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "hex.h"
 #include "IMeshCache.h"
 #include "util/serialize.h"
+#include "util/numeric.h"
 #include "config.h"
 #include "util/directiontables.h"
 #include "version.h"
@@ -294,6 +295,8 @@ Client::Client(
 	m_con(PROTOCOL_ID, 512, CONNECTION_TIMEOUT, ipv6, this),
 	m_device(device),
 	m_server_ser_ver(SER_FMT_VER_INVALID),
+	m_proto_ver(0),
+	m_inventory_actions_count(0),
 	m_playeritem(0),
 	m_inventory_updated(false),
 	m_inventory_from_server(NULL),
@@ -732,6 +735,12 @@ void Client::step(float dtime)
 		}
 	}
 
+	/*
+		Send inventory actions queued during this step
+	*/
+	if(m_inventory_actions_count != 0)
+		sendQueuedInventoryActions();
+
 	/*
 		Replace updated meshes
 	*/
@@ -1195,6 +1204,14 @@ void Client::ProcessData(u8 *data, u32 datasize, u16 sender_peer_id)
 			infostream<<"Client: received recommended send interval "
 					<<m_recommended_send_interval<<std::endl;
 		}
+
+		if(datasize >= 2+1+6+8+4+2)
+		{
+			// Get protocol version in use
+			m_proto_ver = readU16(&data[2+1+6+8+4]);
+			infostream<<"Client: using protocol version "
+					<<m_proto_ver<<std::endl;
+		}
 		
 		// Reply to server
 		u32 replysize = 2;
@@ -1586,6 +1603,39 @@ void Client::ProcessData(u8 *data, u32 datasize, u16 sender_peer_id)
 			m_client_event_queue.push_back(event);
 		}
 	}
+	else if(command == TOCLIENT_NODEMETA_CHANGED)
+	{
+		std::string datastring((char*)&data[2], datasize-2);
+		std::istringstream is(datastring, std::ios_base::binary);
+
+		std::istringstream compressed(deSerializeLongString(is),
+				std::ios_base::binary);
+		std::ostringstream decompressed(std::ios_base::binary);
+		decompressZlib(compressed, decompressed);
+		std::istringstream is2(decompressed.str(), std::ios_base::binary);
+
+		Map &map = m_env.getMap();
+		u16 count = readU16(is2);
+		for(u16 i = 0; i < count; i++)
+		{
+			v3s16 p = readV3S16(is2);
+			bool has_meta = readU8(is2);
+			NodeMetadata *meta = NULL;
+			if(has_meta){
+				meta = new NodeMetadata(this);
+				meta->deSerialize(is2);
+			}
+			// The server only sends this for blocks we have
+			if(map.getBlockNoCreateNoEx(getNodeBlockPos(p)) == NULL){
+				delete meta;
+				continue;
+			}
+			if(meta)
+				map.setNodeMetadata(p, meta);
+			else
+				map.removeNodeMetadata(p);
+		}
+	}
 	else if(command == TOCLIENT_BREATH)
 	{
 		std::string datastring((char*)&data[2], datasize-2);
@@ -2237,6 +2287,10 @@ void Client::interact(u8 action, const PointedThing& pointed)
 void Client::sendNodemetaFields(v3s16 p, const std::string &formname,
 		const std::map<std::string, std::string> &fields)
 {
+	// The fields must reach the server after the moves preceding them
+	if(m_inventory_actions_count != 0)
+		sendQueuedInventoryActions();
+
 	std::ostringstream os(std::ios_base::binary);
 
 	writeU16(os, TOSERVER_NODEMETA_FIELDS);
@@ -2261,6 +2315,10 @@ void Client::sendNodemetaFields(v3s16 p, const std::string &formname,
 void Client::sendInventoryFields(const std::string &formname, 
 		const std::map<std::string, std::string> &fields)
 {
+	// The fields must reach the server after the moves preceding them
+	if(m_inventory_actions_count != 0)
+		sendQueuedInventoryActions();
+
 	std::ostringstream os(std::ios_base::binary);
 
 	writeU16(os, TOSERVER_INVENTORY_FIELDS);
@@ -2283,6 +2341,21 @@ void Client::sendInventoryFields(const std::string &formname,
 
 void Client::sendInventoryAction(InventoryAction *a)
 {
+	/*
+		Servers speaking protocol 23 get the actions in batches,
+		see TOSERVER_INVENTORY_ACTIONS
+	*/
+	if(m_proto_ver >= 23)
+	{
+		std::ostringstream os(std::ios_base::binary);
+		a->serializeBinary(os);
+		m_inventory_actions += os.str();
+		m_inventory_actions_count++;
+		if(m_inventory_actions_count == 0xffff)
+			sendQueuedInventoryActions();
+		return;
+	}
+
 	std::ostringstream os(std::ios_base::binary);
 	u8 buf[12];
 	
@@ -2299,6 +2372,29 @@ void Client::sendInventoryAction(InventoryAction *a)
 	Send(0, data, true);
 }
 
+void Client::sendQueuedInventoryActions()
+{
+	std::ostringstream os(std::ios_base::binary);
+	u8 buf[12];
+	
+	// Write command
+	writeU16(buf, TOSERVER_INVENTORY_ACTIONS);
+	os.write((char*)buf, 2);
+	// Write action count
+	writeU16(buf, m_inventory_actions_count);
+	os.write((char*)buf, 2);
+
+	os<<m_inventory_actions;
+	m_inventory_actions.clear();
+	m_inventory_actions_count = 0;
+	
+	// Make data buffer
+	std::string s = os.str();
+	SharedBuffer<u8> data((u8*)s.c_str(), s.size());
+	// Send as reliable
+	Send(0, data, true);
+}
+
 void Client::sendChatMessage(const std::wstring &message)
 {
 	std::ostringstream os(std::ios_base::binary);
@@ -2640,6 +2736,43 @@ ClientActiveObject * Client::getSelectedActiveObject(
 	m_env.getActiveObjects(from_pos_f_on_map, max_d, objects);
 
 	//infostream<<"Collected "<<objects.size()<<" nearby objects"<<std::endl;
+
+	// Drop the objects whose selection box can't reach the shootline
+	// before doing anything more expensive with them
+	v3f line_vect = shootline_on_map.getVector();
+	f32 line_length_sq = line_vect.getLengthSQ();
+	for(u32 i=0; i<objects.size();)
+	{
+		ClientActiveObject *obj = objects[i].obj;
+
+		core::aabbox3d<f32> *selection_box = obj->getSelectionBox();
+		if(selection_box != NULL)
+		{
+			v3f extent(
+				MYMAX(fabs(selection_box->MinEdge.X), fabs(selection_box->MaxEdge.X)),
+				MYMAX(fabs(selection_box->MinEdge.Y), fabs(selection_box->MaxEdge.Y)),
+				MYMAX(fabs(selection_box->MinEdge.Z), fabs(selection_box->MaxEdge.Z)));
+			f32 radius = extent.getLength();
+
+			v3f pos = obj->getPosition();
+			v3f closest = shootline_on_map.start;
+			if(line_length_sq > 0)
+			{
+				f32 t = (pos - shootline_on_map.start).dotProduct(line_vect)
+						/ line_length_sq;
+				closest += line_vect * rangelim(t, 0.0, 1.0);
+			}
+
+			if(closest.getDistanceFromSQ(pos) <= radius * radius)
+			{
+				i++;
+				continue;
+			}
+		}
+
+		objects[i] = objects.back();
+		objects.pop_back();
+	}
 	
 	// Sort them.
 	// After this, the closest object is the first in the array.
@@ -353,6 +353,8 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void sendInventoryFields(const std::string &formname,
 			const std::map<std::string, std::string> &fields);
 	void sendInventoryAction(InventoryAction *a);
+	// Sends the actions queued by sendInventoryAction as one packet
+	void sendQueuedInventoryActions();
 	void sendChatMessage(const std::wstring &message);
 	void sendChangePassword(const std::wstring oldpassword,
 			const std::wstring newpassword);
@@ -494,6 +496,11 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	IrrlichtDevice *m_device;
 	// Server serialization version
 	u8 m_server_ser_ver;
+	// Network protocol version in use, 0 if the server didn't tell
+	u16 m_proto_ver;
+	// Binary serialized inventory actions waiting to be sent
+	std::string m_inventory_actions;
+	u16 m_inventory_actions_count;
 	u16 m_playeritem;
 	bool m_inventory_updated;
 	Inventory *m_inventory_from_server;
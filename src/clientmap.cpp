@@ -372,37 +372,72 @@ void ClientMap::updateDrawList(video::IVideoDriver* driver)
 	g_profiler->avg("CM: wanted max blocks", m_control.wanted_max_blocks);
 }
 
-struct MeshBufList
+void MeshBufListList::clear()
 {
-	video::SMaterial m;
-	std::list<scene::IMeshBuffer*> bufs;
-};
+	// Drop all buckets once most of them are for materials that are
+	// not drawn anymore, eg. old animation frames or crack levels
+	u32 unused = 0;
+	for(std::vector<MeshBufList>::iterator i = lists.begin();
+			i != lists.end(); ++i){
+		if(i->bufs.empty())
+			unused++;
+		else
+			i->bufs.clear();
+	}
+	if(unused > 64 && unused * 2 > lists.size()){
+		lists.clear();
+		m_index.clear();
+	}
+}
 
-struct MeshBufListList
+void MeshBufListList::add(scene::IMeshBuffer *buf)
 {
-	std::list<MeshBufList> lists;
-	
-	void clear()
-	{
-		lists.clear();
+	const video::SMaterial &m = buf->getMaterial();
+	std::vector<u32> &candidates = m_index[std::make_pair(
+			m.TextureLayer[0].Texture, (s32)m.MaterialType)];
+	for(std::vector<u32>::iterator i = candidates.begin();
+			i != candidates.end(); ++i){
+		MeshBufList &l = lists[*i];
+		if(l.m == m){
+			l.bufs.push_back(buf);
+			return;
+		}
 	}
-	
-	void add(scene::IMeshBuffer *buf)
+	candidates.push_back(lists.size());
+	lists.push_back(MeshBufList());
+	lists.back().m = m;
+	lists.back().bufs.push_back(buf);
+}
+
+static bool farther_first(const TransparentMeshBuf &a,
+		const TransparentMeshBuf &b)
+{
+	return a.d > b.d;
+}
+
+void sortTransparentMeshBufs(std::vector<TransparentMeshBuf> &bufs)
+{
+	std::stable_sort(bufs.begin(), bufs.end(), farther_first);
+}
+
+// Returns true if rendering has taken more than a few seconds
+static bool rendering_takes_ages(int &timecheck_counter, int time1)
+{
+	timecheck_counter++;
+	if(timecheck_counter > 50)
 	{
-		for(std::list<MeshBufList>::iterator i = lists.begin();
-				i != lists.end(); ++i){
-			MeshBufList &l = *i;
-			if(l.m == buf->getMaterial()){
-				l.bufs.push_back(buf);
-				return;
-			}
+		timecheck_counter = 0;
+		int time2 = time(0);
+		if(time2 > time1 + 4)
+		{
+			infostream<<"ClientMap::renderMap(): "
+				"Rendering takes ages, returning."
+				<<std::endl;
+			return true;
 		}
-		MeshBufList l;
-		l.m = buf->getMaterial();
-		l.bufs.push_back(buf);
-		lists.push_back(l);
 	}
-};
+	return false;
+}
 
 void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 {
@@ -492,7 +527,10 @@ void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 	{
 	ScopeProfiler sp(g_profiler, prefix+"drawing blocks", SPT_AVG);
 
-	MeshBufListList drawbufs;
+	if(is_transparent_pass)
+		m_transparent_bufs.clear();
+	else
+		m_solid_bufs.clear();
 
 	for(std::map<v3s16, MapBlock*>::iterator
 			i = m_drawlist.begin();
@@ -570,92 +608,110 @@ void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 					if(buf->getVertexCount() == 0)
 						errorstream<<"Block ["<<analyze_block(block)
 								<<"] contains an empty meshbuf"<<std::endl;
-					drawbufs.add(buf);
+					if(is_transparent_pass)
+						m_transparent_bufs.push_back(
+								TransparentMeshBuf(d, buf));
+					else
+						m_solid_bufs.add(buf);
 				}
 			}
 		}
 	}
 	
-	std::list<MeshBufList> &lists = drawbufs.lists;
-	
 	int timecheck_counter = 0;
-	for(std::list<MeshBufList>::iterator i = lists.begin();
-			i != lists.end(); ++i)
+	if(is_transparent_pass)
 	{
+		// Draw back to front so that blending comes out right
+		sortTransparentMeshBufs(m_transparent_bufs);
+		for(std::vector<TransparentMeshBuf>::iterator
+				i = m_transparent_bufs.begin();
+				i != m_transparent_bufs.end(); ++i)
 		{
-			timecheck_counter++;
-			if(timecheck_counter > 50)
-			{
-				timecheck_counter = 0;
-				int time2 = time(0);
-				if(time2 > time1 + 4)
-				{
-					infostream<<"ClientMap::renderMap(): "
-						"Rendering takes ages, returning."
-						<<std::endl;
-					return;
-				}
-			}
-		}
-
-		MeshBufList &list = *i;
-		
-		driver->setMaterial(list.m);
-		
-		for(std::list<scene::IMeshBuffer*>::iterator j = list.bufs.begin();
-				j != list.bufs.end(); ++j)
-		{
-			scene::IMeshBuffer *buf = *j;
+			if(rendering_takes_ages(timecheck_counter, time1))
+				return;
+			scene::IMeshBuffer *buf = i->buf;
+			/*
+				This *shouldn't* hurt too much because Irrlicht
+				doesn't change opengl textures if the old
+				material has the same texture.
+			*/
+			driver->setMaterial(buf->getMaterial());
 			driver->drawMeshBuffer(buf);
 			vertex_count += buf->getVertexCount();
 			meshbuffer_count++;
 		}
-#if 0
-		/*
-			Draw the faces of the block
-		*/
+	}
+	else
+	{
+		std::vector<MeshBufList> &lists = m_solid_bufs.lists;
+		for(std::vector<MeshBufList>::iterator i = lists.begin();
+				i != lists.end(); ++i)
 		{
-			//JMutexAutoLock lock(block->mesh_mutex);
-
-			MapBlockMesh *mapBlockMesh = block->mesh;
-			assert(mapBlockMesh);
+			MeshBufList &list = *i;
+			if(list.bufs.empty())
+				continue;
 
-			scene::SMesh *mesh = mapBlockMesh->getMesh();
-			assert(mesh);
+			if(rendering_takes_ages(timecheck_counter, time1))
+				return;
 
-			u32 c = mesh->getMeshBufferCount();
-			bool stuff_actually_drawn = false;
-			for(u32 i=0; i<c; i++)
+			driver->setMaterial(list.m);
+			
+			for(std::vector<scene::IMeshBuffer*>::iterator j = list.bufs.begin();
+					j != list.bufs.end(); ++j)
 			{
-				scene::IMeshBuffer *buf = mesh->getMeshBuffer(i);
-				const video::SMaterial& material = buf->getMaterial();
-				video::IMaterialRenderer* rnd =
-						driver->getMaterialRenderer(material.MaterialType);
-				bool transparent = (rnd && rnd->isTransparent());
-				// Render transparent on transparent pass and likewise.
-				if(transparent == is_transparent_pass)
+				scene::IMeshBuffer *buf = *j;
+				driver->drawMeshBuffer(buf);
+				vertex_count += buf->getVertexCount();
+				meshbuffer_count++;
+			}
+#if 0
+			/*
+				Draw the faces of the block
+			*/
+			{
+				//JMutexAutoLock lock(block->mesh_mutex);
+
+				MapBlockMesh *mapBlockMesh = block->mesh;
+				assert(mapBlockMesh);
+
+				scene::SMesh *mesh = mapBlockMesh->getMesh();
+				assert(mesh);
+
+				u32 c = mesh->getMeshBufferCount();
+				bool stuff_actually_drawn = false;
+				for(u32 i=0; i<c; i++)
 				{
-					if(buf->getVertexCount() == 0)
-						errorstream<<"Block ["<<analyze_block(block)
-								<<"] contains an empty meshbuf"<<std::endl;
-					/*
-						This *shouldn't* hurt too much because Irrlicht
-						doesn't change opengl textures if the old
-						material has the same texture.
-					*/
-					driver->setMaterial(buf->getMaterial());
-					driver->drawMeshBuffer(buf);
-					vertex_count += buf->getVertexCount();
-					meshbuffer_count++;
-					stuff_actually_drawn = true;
+					scene::IMeshBuffer *buf = mesh->getMeshBuffer(i);
+					const video::SMaterial& material = buf->getMaterial();
+					video::IMaterialRenderer* rnd =
+							driver->getMaterialRenderer(material.MaterialType);
+					bool transparent = (rnd && rnd->isTransparent());
+					// Render transparent on transparent pass and likewise.
+					if(transparent == is_transparent_pass)
+					{
+						if(buf->getVertexCount() == 0)
+							errorstream<<"Block ["<<analyze_block(block)
+									<<"] contains an empty meshbuf"<<std::endl;
+						/*
+							This *shouldn't* hurt too much because Irrlicht
+							doesn't change opengl textures if the old
+							material has the same texture.
+						*/
+						driver->setMaterial(buf->getMaterial());
+						driver->drawMeshBuffer(buf);
+						vertex_count += buf->getVertexCount();
+						meshbuffer_count++;
+						stuff_actually_drawn = true;
+					}
 				}
+				if(stuff_actually_drawn)
+					blocks_had_pass_meshbuf++;
+				else
+					blocks_without_stuff++;
 			}
-			if(stuff_actually_drawn)
-				blocks_had_pass_meshbuf++;
-			else
-				blocks_without_stuff++;
-		}
 #endif
+		}
+		g_profiler->avg(prefix+"material buckets", lists.size());
 	}
 	} // ScopeProfiler
 	
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "map.h"
 #include <set>
 #include <map>
+#include <vector>
 
 struct MapDrawControl
 {
@@ -56,6 +57,48 @@ struct MapDrawControl
 class Client;
 class ITextureSource;
 
+/*
+	Mesh buffers of the drawn blocks, bucketed by material so that the
+	material is set once per bucket. ClientMap keeps this between frames
+	so the buckets and their storage are reused; clear() only empties
+	them.
+*/
+
+struct MeshBufList
+{
+	video::SMaterial m;
+	std::vector<scene::IMeshBuffer*> bufs;
+};
+
+class MeshBufListList
+{
+public:
+	void clear();
+	void add(scene::IMeshBuffer *buf);
+
+	std::vector<MeshBufList> lists;
+private:
+	// Indices to lists by first texture and material type, so that a
+	// full SMaterial comparison is only needed between a few candidates
+	std::map<std::pair<video::ITexture*, s32>, std::vector<u32> > m_index;
+};
+
+// A transparent mesh buffer and the distance of its block from the camera
+struct TransparentMeshBuf
+{
+	f32 d;
+	scene::IMeshBuffer *buf;
+
+	TransparentMeshBuf(f32 d_, scene::IMeshBuffer *buf_):
+		d(d_),
+		buf(buf_)
+	{}
+};
+
+// Sorts back to front; buffers of the same block keep the order they
+// were added in, so that they are drawn the same way every frame
+void sortTransparentMeshBufs(std::vector<TransparentMeshBuf> &bufs);
+
 /*
 	ClientMap
 	
@@ -151,6 +194,10 @@ class ClientMap : public Map, public scene::ISceneNode
 	std::map<v3s16, MapBlock*> m_drawlist;
 	
 	std::set<v2s16> m_last_drawn_sectors;
+
+	// Render queues reused between frames by renderMap()
+	MeshBufListList m_solid_bufs;
+	std::vector<TransparentMeshBuf> m_transparent_bufs;
 };
 
 #endif
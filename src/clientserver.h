@@ -100,9 +100,16 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 		version, heat and humidity transfer in MapBock
 		automatic_face_movement_dir and automatic_face_movement_dir_offset
 			added to object properties
+	PROTOCOL_VERSION 22:
+		TOCLIENT_NODEMETA_CHANGED
+		Node metadata in TOCLIENT_BLOCKDATA only contains the fields
+			clients use
+	PROTOCOL_VERSION 23:
+		Protocol version added to TOCLIENT_INIT
+		TOSERVER_INVENTORY_ACTIONS
 */
 
-#define LATEST_PROTOCOL_VERSION 21
+#define LATEST_PROTOCOL_VERSION 23
 
 // Server's supported network protocol range
 #define SERVER_PROTOCOL_VERSION_MIN 13
@@ -132,6 +139,7 @@ enum ToClientCommand
 		[3] v3s16 player's position + v3f(0,BS/2,0) floatToInt'd 
 		[12] u64 map seed (new as of 2011-02-27)
 		[20] f1000 recommended send interval (in seconds) (new as of 14)
+		[24] u16 protocol version in use (new as of 23)
 
 		NOTE: The position in here is deprecated; position is
 		      explicitly sent afterwards
@@ -499,6 +507,19 @@ enum ToClientCommand
 		u16 command
 		u16 breath
 	*/
+
+	TOCLIENT_NODEMETA_CHANGED = 0x4f,
+	/*
+		u16 command
+		u32 len
+		u8[len] zlib-compressed:
+			u16 count
+			for each:
+				v3s16 node position
+				u8 1 = has metadata, 0 = metadata removed
+				if has metadata:
+					NodeMetadata (only the fields clients use)
+	*/
 };
 
 enum ToServerCommand
@@ -728,6 +749,16 @@ enum ToServerCommand
 		u16 command
 		u16 breath
 	*/
+
+	TOSERVER_INVENTORY_ACTIONS = 0x43,
+	/*
+		Replaces TOSERVER_INVENTORY_ACTION with protocol version 23 and
+		up; consecutive moves between the same slots are merged.
+		u16 command
+		u16 count
+		for each action:
+			InventoryAction::serializeBinary()
+	*/
 };
 
 #endif
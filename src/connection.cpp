@@ -707,11 +707,12 @@ void Connection::receive()
 		/* Check if some buffer has relevant data */
 		{
 			u16 peer_id;
+			u8 channelnum;
 			SharedBuffer<u8> resultdata;
-			bool got = getFromBuffers(peer_id, resultdata);
+			bool got = getFromBuffers(peer_id, channelnum, resultdata);
 			if(got){
 				ConnectionEvent e;
-				e.dataReceived(peer_id, resultdata);
+				e.dataReceived(peer_id, resultdata, channelnum, true);
 				putEvent(e);
 				continue;
 			}
@@ -872,6 +873,10 @@ void Connection::receive()
 		memcpy(*strippeddata, &packetdata[BASE_HEADER_SIZE],
 				strippeddata.getSize());
 		
+		// Reliable packets wrap the others only at the outermost level
+		bool reliable = strippeddata.getSize() >= 1 &&
+				readU8(&strippeddata[0]) == TYPE_RELIABLE;
+
 		try{
 			// Process it (the result is some data with no headers made by us)
 			SharedBuffer<u8> resultdata = processPacket
@@ -882,7 +887,7 @@ void Connection::receive()
 					<<resultdata.getSize()<<std::endl;
 			
 			ConnectionEvent e;
-			e.dataReceived(peer_id, resultdata);
+			e.dataReceived(peer_id, resultdata, channelnum, reliable);
 			putEvent(e);
 			continue;
 		}catch(ProcessedSilentlyException &e){
@@ -1221,7 +1226,8 @@ std::list<Peer*> Connection::getPeers()
 	return list;
 }
 
-bool Connection::getFromBuffers(u16 &peer_id, SharedBuffer<u8> &dst)
+bool Connection::getFromBuffers(u16 &peer_id, u8 &channelnum,
+		SharedBuffer<u8> &dst)
 {
 	for(std::map<u16, Peer*>::iterator j = m_peers.begin();
 		j != m_peers.end(); ++j)
@@ -1233,6 +1239,7 @@ bool Connection::getFromBuffers(u16 &peer_id, SharedBuffer<u8> &dst)
 			SharedBuffer<u8> resultdata;
 			bool got = checkIncomingBuffers(channel, peer_id, resultdata);
 			if(got){
+				channelnum = i;
 				dst = resultdata;
 				return true;
 			}
@@ -1614,6 +1621,14 @@ void Connection::Disconnect()
 }
 
 u32 Connection::Receive(u16 &peer_id, SharedBuffer<u8> &data)
+{
+	u8 channelnum;
+	bool reliable;
+	return Receive(peer_id, data, channelnum, reliable);
+}
+
+u32 Connection::Receive(u16 &peer_id, SharedBuffer<u8> &data,
+		u8 &channelnum, bool &reliable)
 {
 	for(;;){
 		ConnectionEvent e = waitEvent(m_bc_receive_timeout);
@@ -1626,6 +1641,8 @@ u32 Connection::Receive(u16 &peer_id, SharedBuffer<u8> &data)
 		case CONNEVENT_DATA_RECEIVED:
 			peer_id = e.peer_id;
 			data = SharedBuffer<u8>(e.data);
+			channelnum = e.channelnum;
+			reliable = e.reliable;
 			return e.data.getSize();
 		case CONNEVENT_PEER_ADDED: {
 			Peer tmp(e.peer_id, e.address);
@@ -440,8 +440,11 @@ struct ConnectionEvent
 	Buffer<u8> data;
 	bool timeout;
 	Address address;
+	// How the data of CONNEVENT_DATA_RECEIVED was sent
+	u8 channelnum;
+	bool reliable;
 
-	ConnectionEvent(): type(CONNEVENT_NONE) {}
+	ConnectionEvent(): type(CONNEVENT_NONE), channelnum(0), reliable(false) {}
 
 	std::string describe()
 	{
@@ -460,11 +463,14 @@ struct ConnectionEvent
 		return "Invalid ConnectionEvent";
 	}
 	
-	void dataReceived(u16 peer_id_, SharedBuffer<u8> data_)
+	void dataReceived(u16 peer_id_, SharedBuffer<u8> data_,
+			u8 channelnum_, bool reliable_)
 	{
 		type = CONNEVENT_DATA_RECEIVED;
 		peer_id = peer_id_;
 		data = data_;
+		channelnum = channelnum_;
+		reliable = reliable_;
 	}
 	void peerAdded(u16 peer_id_, Address address_)
 	{
@@ -565,6 +571,9 @@ class Connection: public SimpleThread
 	bool Connected();
 	void Disconnect();
 	u32 Receive(u16 &peer_id, SharedBuffer<u8> &data);
+	// Also tells the channel and reliability the data was sent with
+	u32 Receive(u16 &peer_id, SharedBuffer<u8> &data,
+			u8 &channelnum, bool &reliable);
 	void SendToAll(u8 channelnum, SharedBuffer<u8> data, bool reliable);
 	void Send(u16 peer_id, u8 channelnum, SharedBuffer<u8> data, bool reliable);
 	void RunTimeouts(float dtime); // dummy
@@ -592,7 +601,7 @@ class Connection: public SimpleThread
 	Peer* getPeer(u16 peer_id);
 	Peer* getPeerNoEx(u16 peer_id);
 	std::list<Peer*> getPeers();
-	bool getFromBuffers(u16 &peer_id, SharedBuffer<u8> &dst);
+	bool getFromBuffers(u16 &peer_id, u8 &channelnum, SharedBuffer<u8> &dst);
 	// Returns next data from a buffer if possible
 	// If found, returns true; if not, false.
 	// If found, sets peer_id and dst
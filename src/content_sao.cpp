@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "content_sao.h"
 #include "collision.h"
 #include "environment.h"
+#include "map.h"
 #include "settings.h"
 #include "main.h" // For g_profiler
 #include "profiler.h"
@@ -34,6 +35,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 std::map<u16, ServerActiveObject::Factory> ServerActiveObject::m_types;
 
+// How often sleeping entities look at the nodes around them
+#define LUAENTITY_SLEEP_CHECK_INTERVAL 0.5
+
 /*
 	DummyLoadSAO
 */
@@ -384,7 +388,9 @@ LuaEntitySAO::LuaEntitySAO(ServerEnvironment *env, v3f pos,
 	m_animation_sent(false),
 	m_bone_position_sent(false),
 	m_attachment_parent_id(0),
-	m_attachment_sent(false)
+	m_attachment_sent(false),
+	m_sleeping(false),
+	m_sleep_check_timer(0)
 {
 	// Only register type if no environment supplied
 	if(env == NULL){
@@ -492,6 +498,20 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 
 	m_last_sent_position_timer += dtime;
 
+	if(m_sleeping)
+	{
+		g_profiler->add("SEnv: sleeping entity steps (num)", 1);
+		m_sleep_check_timer -= dtime;
+		if(m_sleep_check_timer <= 0)
+		{
+			m_sleep_check_timer = LUAENTITY_SLEEP_CHECK_INTERVAL;
+			content_t nodes[2];
+			getSleepNodes(nodes);
+			if(nodes[0] != m_sleep_nodes[0] || nodes[1] != m_sleep_nodes[1])
+				wakeUp();
+		}
+	}
+
 	// Each frame, parent position is copied if the object is attached, otherwise it's calculated normally
 	// If the object gets detached this comes into effect automatically from the last known origin
 	if(isAttached())
@@ -501,7 +521,7 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 		m_velocity = v3f(0,0,0);
 		m_acceleration = v3f(0,0,0);
 	}
-	else
+	else if(!m_sleeping)
 	{
 		if(m_prop.physical){
 			core::aabbox3d<f32> box = m_prop.collisionbox;
@@ -533,7 +553,7 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 		}
 	}
 
-	if(m_registered){
+	if(m_registered && !m_sleeping){
 		m_env->getScriptIface()->luaentity_Step(m_id, dtime);
 	}
 
@@ -673,6 +693,8 @@ int LuaEntitySAO::punch(v3f dir,
 	// It's best that attachments cannot be punched 
 	if(isAttached())
 		return 0;
+
+	wakeUp();
 	
 	ItemStack *punchitem = NULL;
 	ItemStack punchitem_static;
@@ -725,6 +747,7 @@ void LuaEntitySAO::rightClick(ServerActiveObject *clicker)
 	// It's best that attachments cannot be clicked
 	if(isAttached())
 		return;
+	wakeUp();
 	m_env->getScriptIface()->luaentity_Rightclick(m_id, clicker);
 }
 
@@ -732,6 +755,7 @@ void LuaEntitySAO::setPos(v3f pos)
 {
 	if(isAttached())
 		return;
+	wakeUp();
 	m_base_position = pos;
 	sendPosition(false, true);
 }
@@ -740,6 +764,7 @@ void LuaEntitySAO::moveTo(v3f pos, bool continuous)
 {
 	if(isAttached())
 		return;
+	wakeUp();
 	m_base_position = pos;
 	if(!continuous)
 		sendPosition(true, true);
@@ -802,6 +827,7 @@ void LuaEntitySAO::setAttachment(int parent_id, std::string bone, v3f position,
 	// This breaks some things so we also give the server the most accurate representation
 	// even if players only see the client changes.
 
+	wakeUp();
 	m_attachment_parent_id = parent_id;
 	m_attachment_bone = bone;
 	m_attachment_position = position;
@@ -821,6 +847,7 @@ void LuaEntitySAO::notifyObjectPropertiesModified()
 
 void LuaEntitySAO::setVelocity(v3f velocity)
 {
+	wakeUp();
 	m_velocity = velocity;
 }
 
@@ -831,6 +858,7 @@ v3f LuaEntitySAO::getVelocity()
 
 void LuaEntitySAO::setAcceleration(v3f acceleration)
 {
+	wakeUp();
 	m_acceleration = acceleration;
 }
 
@@ -931,6 +959,24 @@ bool LuaEntitySAO::collideWithObjects(){
 	return m_prop.collideWithObjects;
 }
 
+void LuaEntitySAO::sleep()
+{
+	if(isAttached())
+		return;
+	m_sleeping = true;
+	m_sleep_check_timer = LUAENTITY_SLEEP_CHECK_INTERVAL;
+	getSleepNodes(m_sleep_nodes);
+}
+
+void LuaEntitySAO::getSleepNodes(content_t *nodes)
+{
+	Map &map = m_env->getMap();
+	v3f below = m_base_position +
+			v3f(0, m_prop.collisionbox.MinEdge.Y * BS - 0.1 * BS, 0);
+	nodes[0] = map.getNodeNoEx(floatToInt(m_base_position, BS)).getContent();
+	nodes[1] = map.getNodeNoEx(floatToInt(below, BS)).getContent();
+}
+
 /*
 	PlayerSAO
 */
@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "itemgroup.h"
 #include "player.h"
 #include "object_properties.h"
+#include "mapnode.h" // content_t
 
 ServerActiveObject* createItemSAO(ServerEnvironment *env, v3f pos,
 		const std::string itemstring);
@@ -62,6 +63,8 @@ class LuaEntitySAO : public ServerActiveObject
 	void setHP(s16 hp);
 	s16 getHP() const;
 	void setArmorGroups(const ItemGroupList &armor_groups);
+	int getArmorGroup(const std::string &name) const
+	{ return itemgroup_get(m_armor_groups, name); }
 	void setAnimation(v2f frame_range, float frame_speed, float frame_blend);
 	void setBonePosition(std::string bone, v3f position, v3f rotation);
 	void setAttachment(int parent_id, std::string bone, v3f position, v3f rotation);
@@ -80,9 +83,20 @@ class LuaEntitySAO : public ServerActiveObject
 	std::string getName();
 	bool getCollisionBox(aabb3f *toset);
 	bool collideWithObjects();
+	/*
+		A sleeping entity does no physics and its on_step isn't called
+		until it is moved, punched, its velocity or acceleration is set
+		or the nodes at and under it change
+	*/
+	void sleep();
+	bool isSleeping()
+	{ return m_sleeping; }
 private:
 	std::string getPropertyPacket();
 	void sendPosition(bool do_interpolate, bool is_movement_end);
+	void wakeUp()
+	{ m_sleeping = false; }
+	void getSleepNodes(content_t *nodes);
 
 	std::string m_init_name;
 	std::string m_init_state;
@@ -116,6 +130,11 @@ class LuaEntitySAO : public ServerActiveObject
 	v3f m_attachment_position;
 	v3f m_attachment_rotation;
 	bool m_attachment_sent;
+
+	bool m_sleeping;
+	float m_sleep_check_timer;
+	// Contents of the node at the entity and the one under it
+	content_t m_sleep_nodes[2];
 };
 
 /*
@@ -197,6 +216,8 @@ class PlayerSAO : public ServerActiveObject
 	u16 getBreath() const;
 	void setBreath(u16 breath);
 	void setArmorGroups(const ItemGroupList &armor_groups);
+	int getArmorGroup(const std::string &name) const
+	{ return itemgroup_get(m_armor_groups, name); }
 	void setAnimation(v2f frame_range, float frame_speed, float frame_blend);
 	void setBonePosition(std::string bone, v3f position, v3f rotation);
 	void setAttachment(int parent_id, std::string bone, v3f position, v3f rotation);
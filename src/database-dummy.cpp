@@ -48,36 +48,22 @@ void Database_Dummy::endSave() {}
 void Database_Dummy::saveBlock(MapBlock *block)
 {
 	DSTACK(__FUNCTION_NAME);
-	/*
-		Dummy blocks are not written
-	*/
-	if(block->isDummy())
-	{
+	std::string data;
+	// Dummy blocks are not written
+	if(!serializeBlock(block, data))
 		return;
-	}
-
-	// Format used for writing
-	u8 version = SER_FMT_VER_HIGHEST_WRITE;
-	// Get destination
-	v3s16 p3d = block->getPos();
-
-	/*
-		[0] u8 serialization version
-		[1] data
-	*/
 
-	std::ostringstream o(std::ios_base::binary);
-	o.write((char*)&version, 1);
-	// Write basic data
-	block->serialize(o, version, true);
-	// Write block to database
-	std::string tmp = o.str();
+	saveBlockData(block->getPos(), data);
 
-	m_database[getBlockAsInteger(p3d)] = tmp;
 	// We just wrote it to the disk so clear modified flag
 	block->resetModified();
 }
 
+void Database_Dummy::saveBlockData(v3s16 blockpos, const std::string &data)
+{
+	m_database[getBlockAsInteger(blockpos)] = data;
+}
+
 MapBlock* Database_Dummy::loadBlock(v3s16 blockpos)
 {
 	v2s16 p2d(blockpos.X, blockpos.Z);
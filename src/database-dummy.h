@@ -33,6 +33,7 @@ class Database_Dummy : public Database
 	virtual void beginSave();
 	virtual void endSave();
         virtual void saveBlock(MapBlock *block);
+        virtual void saveBlockData(v3s16 blockpos, const std::string &data);
         virtual MapBlock* loadBlock(v3s16 blockpos);
         virtual void listAllLoadableBlocks(std::list<v3s16> &dst);
         virtual int Initialized(void);
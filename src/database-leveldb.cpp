@@ -35,6 +35,89 @@ LevelDB databases
 #include "main.h"
 #include "settings.h"
 #include "log.h"
+#include "porting.h"
+#include "util/thread.h"
+#include "leveldb/write_batch.h"
+
+/*
+	Copies the blocks for Database_LevelDB::startBackup() from a
+	snapshot, so saves done while copying don't end up in the copy.
+*/
+class LevelDBBackupThread : public SimpleThread
+{
+public:
+	LevelDBBackupThread(leveldb::DB *source, const leveldb::Snapshot *snapshot,
+			const std::string &target_path):
+		SimpleThread(),
+		m_source(source),
+		m_snapshot(snapshot),
+		m_target_path(target_path)
+	{
+	}
+
+	void * Thread()
+	{
+		ThreadStarted();
+
+		log_register_thread("LevelDBBackupThread");
+
+		DSTACK(__FUNCTION_NAME);
+
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		u32 time1 = porting::getTimeMs();
+		u32 copied = 0;
+		leveldb::DB *target = NULL;
+		leveldb::Options options;
+		options.create_if_missing = true;
+		options.error_if_exists = true;
+		leveldb::Status status = leveldb::DB::Open(options, m_target_path,
+				&target);
+
+		if(status.ok()) {
+			leveldb::ReadOptions read_options;
+			read_options.snapshot = m_snapshot;
+			read_options.fill_cache = false;
+			leveldb::Iterator *it = m_source->NewIterator(read_options);
+			leveldb::WriteBatch batch;
+			for(it->SeekToFirst(); it->Valid() && status.ok(); it->Next()) {
+				if(!getRun()) {
+					status = leveldb::Status::IOError("aborted");
+					break;
+				}
+				batch.Put(it->key(), it->value());
+				if(++copied % 1000 == 0) {
+					status = target->Write(leveldb::WriteOptions(), &batch);
+					batch.Clear();
+				}
+			}
+			if(status.ok())
+				status = it->status();
+			if(status.ok())
+				status = target->Write(leveldb::WriteOptions(), &batch);
+			delete it;
+		}
+		delete target;
+		m_source->ReleaseSnapshot(m_snapshot);
+
+		if(status.ok())
+			actionstream<<"Database_LevelDB: Copied "<<copied
+					<<" blocks to \""<<m_target_path<<"\" in "
+					<<(porting::getTimeMs() - time1)<<"ms"<<std::endl;
+		else
+			errorstream<<"Database_LevelDB: Backup to \""<<m_target_path
+					<<"\" failed: "<<status.ToString()<<std::endl;
+
+		END_DEBUG_EXCEPTION_HANDLER(errorstream)
+
+		return NULL;
+	}
+
+private:
+	leveldb::DB *m_source;
+	const leveldb::Snapshot *m_snapshot;
+	std::string m_target_path;
+};
 
 Database_LevelDB::Database_LevelDB(ServerMap *map, std::string savedir)
 {
@@ -43,6 +126,7 @@ Database_LevelDB::Database_LevelDB(ServerMap *map, std::string savedir)
 	leveldb::Status status = leveldb::DB::Open(options, savedir + DIR_DELIM + "map.db", &m_database);
 	assert(status.ok());
 	srvmap = map;
+	m_backup_thread = NULL;
 }
 
 int Database_LevelDB::Initialized(void)
@@ -56,37 +140,22 @@ void Database_LevelDB::endSave() {}
 void Database_LevelDB::saveBlock(MapBlock *block)
 {
 	DSTACK(__FUNCTION_NAME);
-	/*
-		Dummy blocks are not written
-	*/
-	if(block->isDummy())
-	{
+	std::string data;
+	// Dummy blocks are not written
+	if(!serializeBlock(block, data))
 		return;
-	}
-
-	// Format used for writing
-	u8 version = SER_FMT_VER_HIGHEST_WRITE;
-	// Get destination
-	v3s16 p3d = block->getPos();
 
-	/*
-		[0] u8 serialization version
-		[1] data
-	*/
-
-	std::ostringstream o(std::ios_base::binary);
-	o.write((char*)&version, 1);
-	// Write basic data
-	block->serialize(o, version, true);
-	// Write block to database
-	std::string tmp = o.str();
-
-	m_database->Put(leveldb::WriteOptions(), i64tos(getBlockAsInteger(p3d)), tmp);
+	saveBlockData(block->getPos(), data);
 
 	// We just wrote it to the disk so clear modified flag
 	block->resetModified();
 }
 
+void Database_LevelDB::saveBlockData(v3s16 p3d, const std::string &data)
+{
+	m_database->Put(leveldb::WriteOptions(), i64tos(getBlockAsInteger(p3d)), data);
+}
+
 MapBlock* Database_LevelDB::loadBlock(v3s16 blockpos)
 {
 	v2s16 p2d(blockpos.X, blockpos.Z);
@@ -180,8 +249,33 @@ void Database_LevelDB::listAllLoadableBlocks(std::list<v3s16> &dst)
 	delete it;
 }
 
+bool Database_LevelDB::startBackup(const std::string &target_dir)
+{
+	if(m_backup_thread) {
+		if(m_backup_thread->IsRunning())
+			return false;
+		delete m_backup_thread;
+		m_backup_thread = NULL;
+	}
+
+	m_backup_thread = new LevelDBBackupThread(m_database,
+			m_database->GetSnapshot(), target_dir + DIR_DELIM + "map.db");
+	m_backup_thread->Start();
+	return true;
+}
+
+void Database_LevelDB::stopBackup()
+{
+	if(m_backup_thread) {
+		m_backup_thread->stop();
+		delete m_backup_thread;
+		m_backup_thread = NULL;
+	}
+}
+
 Database_LevelDB::~Database_LevelDB()
 {
+	stopBackup();
 	delete m_database;
 }
 #endif
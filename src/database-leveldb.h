@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <string>
 
 class ServerMap;
+class LevelDBBackupThread;
 
 class Database_LevelDB : public Database
 {
@@ -37,13 +38,18 @@ class Database_LevelDB : public Database
 	virtual void beginSave();
 	virtual void endSave();
         virtual void saveBlock(MapBlock *block);
+        virtual void saveBlockData(v3s16 blockpos, const std::string &data);
         virtual MapBlock* loadBlock(v3s16 blockpos);
         virtual void listAllLoadableBlocks(std::list<v3s16> &dst);
         virtual int Initialized(void);
+	virtual bool startBackup(const std::string &target_dir);
+	virtual void stopBackup();
 	~Database_LevelDB();
 private:
 	ServerMap *srvmap;
 	leveldb::DB* m_database;
+	// Copies blocks for startBackup(); NULL if none was started
+	LevelDBBackupThread *m_backup_thread;
 };
 #endif
 #endif
@@ -0,0 +1,288 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "database-sharded.h"
+
+#include "config.h"
+#include "database-sqlite3.h"
+#if USE_LEVELDB
+#include "database-leveldb.h"
+#endif
+#include "mapblock.h"
+#include "filesys.h"
+#include "exceptions.h"
+#include "log.h"
+#include "debug.h"
+#include "porting.h"
+#include "settings.h"
+#include "util/string.h"
+#include "util/container.h"
+#include "util/thread.h"
+
+static std::string shard_dir(const std::string &savedir, u32 i)
+{
+	return savedir + DIR_DELIM + "map.shards" + DIR_DELIM + itos(i);
+}
+
+/*
+	Blocks are assigned to shards by the shard count, so a world opened
+	with another count would lose track of its blocks. The count is kept
+	in map.shards/meta.txt; worlds sharded before that get it from the
+	number of shard directories.
+*/
+static void check_shard_count(const std::string &savedir, u32 shard_count)
+{
+	std::string dir = savedir + DIR_DELIM + "map.shards";
+	std::string path = dir + DIR_DELIM + "meta.txt";
+	Settings meta;
+	u32 saved_count = 0;
+	if(meta.readConfigFile(path.c_str()) && meta.exists("shards")) {
+		saved_count = meta.getU16("shards");
+	} else {
+		std::vector<fs::DirListNode> list = fs::GetDirListing(dir);
+		for(u32 i = 0; i < list.size(); i++)
+		{
+			if(list[i].dir && list[i].name == itos(stoi(list[i].name)))
+				saved_count++;
+		}
+	}
+
+	if(saved_count != 0 && saved_count != shard_count) {
+		errorstream<<"Database_Sharded: The world has "<<saved_count
+				<<" shards, but shards = "<<shard_count<<std::endl;
+		throw BaseException("Map shard count differs from the saved one");
+	}
+
+	if(!meta.exists("shards")) {
+		meta.set("shards", itos(shard_count));
+		if(!fs::CreateAllDirs(dir) || !meta.updateConfigFile(path.c_str()))
+			throw BaseException("Cannot write map shard metadata");
+	}
+}
+
+// Collected blocks are written out when there are this many of them, so
+// that eg. migrating a world doesn't keep all of it in memory
+#define SHARD_SAVE_MAX_PENDING 4096
+
+/*
+	Writes one shard's batch of serialized blocks in one transaction.
+	It is started again for every batch.
+*/
+class ShardSaveThread : public SimpleThread
+{
+public:
+	ShardSaveThread(Database *shard):
+		SimpleThread(),
+		m_shard(shard)
+	{
+	}
+
+	void save()
+	{
+		m_shard->beginSave();
+		for(std::vector<std::pair<v3s16, std::string> >::iterator
+				i = blocks.begin(); i != blocks.end(); ++i)
+			m_shard->saveBlockData(i->first, i->second);
+		m_shard->endSave();
+		blocks.clear();
+	}
+
+	void * Thread()
+	{
+		ThreadStarted();
+
+		log_register_thread("ShardSaveThread");
+
+		DSTACK(__FUNCTION_NAME);
+
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		save();
+
+		END_DEBUG_EXCEPTION_HANDLER(errorstream)
+
+		return NULL;
+	}
+
+	// Only touched by the owner while the thread isn't running
+	std::vector<std::pair<v3s16, std::string> > blocks;
+
+private:
+	Database *m_shard;
+};
+
+Database_Sharded::Database_Sharded(ServerMap *map, std::string savedir,
+		const std::string &shard_backend, u32 shard_count)
+{
+	if(shard_count == 0)
+		throw BaseException("Sharded map backend needs at least one shard");
+	check_shard_count(savedir, shard_count);
+
+	for(u32 i = 0; i < shard_count; i++)
+	{
+		std::string dir = shard_dir(savedir, i);
+		if(!fs::CreateAllDirs(dir))
+			throw BaseException("Cannot create map shard directory");
+		if(shard_backend == "sqlite3")
+			m_shards.push_back(new Database_SQLite3(map, dir));
+		#if USE_LEVELDB
+		else if(shard_backend == "leveldb")
+			m_shards.push_back(new Database_LevelDB(map, dir));
+		#endif
+		else
+			throw BaseException("Unknown map shard backend");
+		m_save_threads.push_back(new ShardSaveThread(m_shards[i]));
+	}
+	m_saving = false;
+	m_save_pending = 0;
+	infostream<<"Database_Sharded: Using "<<shard_count<<" "
+			<<shard_backend<<" shards"<<std::endl;
+}
+
+u32 Database_Sharded::getShardIndex(v3s16 blockpos)
+{
+	// Keep the blocks of a region together; regions are spread by hash
+	u32 x = blockpos.X >> 3;
+	u32 z = blockpos.Z >> 3;
+	u32 h = (x * 73856093) ^ (z * 19349663);
+	return h % m_shards.size();
+}
+
+void Database_Sharded::beginSave()
+{
+	m_saving = true;
+}
+
+void Database_Sharded::endSave()
+{
+	flushSave();
+	m_saving = false;
+}
+
+void Database_Sharded::flushSave()
+{
+	std::vector<ShardSaveThread*> busy;
+	for(u32 i = 0; i < m_save_threads.size(); i++)
+	{
+		if(!m_save_threads[i]->blocks.empty())
+			busy.push_back(m_save_threads[i]);
+	}
+	m_save_pending = 0;
+
+	// Starting a thread isn't worth it for a single batch
+	if(busy.size() == 1) {
+		busy[0]->save();
+		return;
+	}
+
+	for(u32 i = 0; i < busy.size(); i++)
+	{
+		if(busy[i]->Start() != 0)
+			busy[i]->save();
+	}
+	for(u32 i = 0; i < busy.size(); i++)
+	{
+		while(busy[i]->IsRunning())
+			sleep_ms(1);
+	}
+}
+
+void Database_Sharded::saveBlock(MapBlock *block)
+{
+	std::string data;
+	// Dummy blocks are not written
+	if(!serializeBlock(block, data))
+		return;
+
+	saveBlockData(block->getPos(), data);
+
+	// Written by the time endSave() returns
+	block->resetModified();
+}
+
+void Database_Sharded::saveBlockData(v3s16 blockpos, const std::string &data)
+{
+	u32 i = getShardIndex(blockpos);
+	if(!m_saving) {
+		m_shards[i]->saveBlockData(blockpos, data);
+		return;
+	}
+
+	m_save_threads[i]->blocks.push_back(std::make_pair(blockpos, data));
+	if(++m_save_pending >= SHARD_SAVE_MAX_PENDING)
+		flushSave();
+}
+
+MapBlock* Database_Sharded::loadBlock(v3s16 blockpos)
+{
+	// The block might be waiting in a batch
+	if(m_save_pending != 0)
+		flushSave();
+	return m_shards[getShardIndex(blockpos)]->loadBlock(blockpos);
+}
+
+void Database_Sharded::listAllLoadableBlocks(std::list<v3s16> &dst)
+{
+	if(m_save_pending != 0)
+		flushSave();
+	for(u32 i = 0; i < m_shards.size(); i++)
+		m_shards[i]->listAllLoadableBlocks(dst);
+}
+
+int Database_Sharded::Initialized(void)
+{
+	// Shards may open their databases on first use, but a sharded world
+	// never has blocks in the legacy sectors/ directories
+	return 1;
+}
+
+bool Database_Sharded::startBackup(const std::string &target_dir)
+{
+	for(u32 i = 0; i < m_shards.size(); i++)
+	{
+		std::string dir = shard_dir(target_dir, i);
+		if(!fs::CreateAllDirs(dir) || !m_shards[i]->startBackup(dir))
+		{
+			errorstream<<"Database_Sharded: Backup of shard "<<i
+					<<" could not be started"<<std::endl;
+			// Don't leave the other shards copying into a failed backup
+			for(u32 j = 0; j < i; j++)
+				m_shards[j]->stopBackup();
+			return false;
+		}
+	}
+	return true;
+}
+
+void Database_Sharded::stopBackup()
+{
+	for(u32 i = 0; i < m_shards.size(); i++)
+		m_shards[i]->stopBackup();
+}
+
+Database_Sharded::~Database_Sharded()
+{
+	if(m_saving)
+		flushSave();
+	for(u32 i = 0; i < m_shards.size(); i++)
+	{
+		delete m_save_threads[i];
+		delete m_shards[i];
+	}
+}
@@ -0,0 +1,78 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef DATABASE_SHARDED_HEADER
+#define DATABASE_SHARDED_HEADER
+
+#include "database.h"
+#include <string>
+#include <vector>
+
+class ServerMap;
+
+/*
+	Splits the blocks of a world over several databases of one backend,
+	stored in <world>/map.shards/<index>/. Blocks are assigned by region
+	(columns of 8x8 blocks), so a region's blocks share a database.
+
+	Between beginSave() and endSave() blocks are serialized right away
+	and collected per shard. endSave() then writes each shard's batch in
+	its own thread, in its own transaction, and returns when all of them
+	are done. Nothing is written in the background after that.
+
+	world.mt:
+		backend = sharded
+		shard_backend = sqlite3 or leveldb
+		shards = number of databases; must not change once blocks are
+			saved, the count in map.shards/meta.txt is checked on start
+*/
+class ShardSaveThread;
+
+class Database_Sharded : public Database
+{
+public:
+	Database_Sharded(ServerMap *map, std::string savedir,
+			const std::string &shard_backend, u32 shard_count);
+	virtual void beginSave();
+	virtual void endSave();
+
+	virtual void saveBlock(MapBlock *block);
+	virtual void saveBlockData(v3s16 blockpos, const std::string &data);
+	virtual MapBlock* loadBlock(v3s16 blockpos);
+	virtual void listAllLoadableBlocks(std::list<v3s16> &dst);
+	virtual int Initialized(void);
+	virtual bool startBackup(const std::string &target_dir);
+	virtual void stopBackup();
+	~Database_Sharded();
+private:
+	u32 getShardIndex(v3s16 blockpos);
+	// Writes the collected batches, in parallel if more than one shard
+	// has one
+	void flushSave();
+
+	std::vector<Database*> m_shards;
+	// One per shard, holding its batch
+	std::vector<ShardSaveThread*> m_save_threads;
+	// Between beginSave() and endSave()
+	bool m_saving;
+	// Blocks collected in all batches
+	u32 m_save_pending;
+};
+
+#endif
@@ -44,6 +44,175 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "main.h"
 #include "settings.h"
 #include "log.h"
+#include "porting.h"
+#include "util/thread.h"
+
+/*
+	Copies the write-ahead log back into the database file every few
+	seconds with its own connection. In WAL mode this doesn't block the
+	main connection, so the server thread doesn't have to wait for
+	checkpoints at the end of a save.
+*/
+class SQLiteCheckpointThread : public SimpleThread
+{
+public:
+	// Takes over db, an open connection of its own
+	SQLiteCheckpointThread(sqlite3 *db, u32 interval_ms):
+		SimpleThread(),
+		m_db(db),
+		m_interval_ms(interval_ms)
+	{
+	}
+
+	void * Thread()
+	{
+		ThreadStarted();
+
+		log_register_thread("SQLiteCheckpointThread");
+
+		DSTACK(__FUNCTION_NAME);
+
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		sqlite3 *db = m_db;
+		u32 waited_ms = 0;
+		while(getRun())
+		{
+			sleep_ms(100);
+			waited_ms += 100;
+			if(waited_ms < m_interval_ms)
+				continue;
+			waited_ms = 0;
+
+			int log_frames = 0;
+			int checkpointed_frames = 0;
+			if(sqlite3_wal_checkpoint_v2(db, NULL, SQLITE_CHECKPOINT_PASSIVE,
+					&log_frames, &checkpointed_frames) != SQLITE_OK)
+				infostream<<"SQLiteCheckpointThread: Checkpoint failed: "
+						<<sqlite3_errmsg(db)<<std::endl;
+			else
+				verbosestream<<"SQLiteCheckpointThread: Checkpointed "
+						<<checkpointed_frames<<"/"<<log_frames
+						<<" frames"<<std::endl;
+		}
+
+		sqlite3_close(db);
+
+		END_DEBUG_EXCEPTION_HANDLER(errorstream)
+
+		return NULL;
+	}
+
+private:
+	sqlite3 *m_db;
+	u32 m_interval_ms;
+};
+
+static const char *blocks_table_sql =
+	"CREATE TABLE IF NOT EXISTS `blocks` ("
+		"`pos` INT NOT NULL PRIMARY KEY,"
+		"`data` BLOB"
+	");";
+
+/*
+	Copies all blocks that source sees into a new database at
+	target_path. Stops early if thread is given and asked to stop.
+	Returns the number of blocks copied, or -1 on failure.
+*/
+static s32 copy_blocks(sqlite3 *source, const std::string &target_path,
+		SimpleThread *thread)
+{
+	sqlite3 *target = NULL;
+	sqlite3_stmt *read = NULL;
+	sqlite3_stmt *write = NULL;
+	s32 copied = 0;
+	bool ok = sqlite3_open_v2(target_path.c_str(), &target,
+			SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) == SQLITE_OK
+		&& sqlite3_exec(target, blocks_table_sql, NULL, NULL, NULL) == SQLITE_OK
+		&& sqlite3_prepare(source, "SELECT `pos`, `data` FROM `blocks`",
+				-1, &read, NULL) == SQLITE_OK
+		&& sqlite3_prepare(target, "INSERT INTO `blocks` VALUES(?, ?)",
+				-1, &write, NULL) == SQLITE_OK
+		&& sqlite3_exec(target, "BEGIN;", NULL, NULL, NULL) == SQLITE_OK;
+	if(!ok)
+		errorstream<<"Database_SQLite3: Cannot create backup database \""
+				<<target_path<<"\": "<<sqlite3_errmsg(target)<<std::endl;
+
+	while(ok && sqlite3_step(read) == SQLITE_ROW)
+	{
+		if(thread && !thread->getRun()) {
+			errorstream<<"Database_SQLite3: Backup to \""<<target_path
+					<<"\" aborted"<<std::endl;
+			ok = false;
+			break;
+		}
+		sqlite3_bind_int64(write, 1, sqlite3_column_int64(read, 0));
+		sqlite3_bind_blob(write, 2, sqlite3_column_blob(read, 1),
+				sqlite3_column_bytes(read, 1), SQLITE_STATIC);
+		if(sqlite3_step(write) != SQLITE_DONE) {
+			errorstream<<"Database_SQLite3: Writing backup failed: "
+					<<sqlite3_errmsg(target)<<std::endl;
+			ok = false;
+		}
+		sqlite3_reset(write);
+		copied++;
+	}
+
+	if(ok && sqlite3_exec(target, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+		errorstream<<"Database_SQLite3: Committing backup failed: "
+				<<sqlite3_errmsg(target)<<std::endl;
+		ok = false;
+	}
+	sqlite3_finalize(read);
+	sqlite3_finalize(write);
+	sqlite3_close(target);
+	return ok ? copied : -1;
+}
+
+/*
+	Copies the blocks for Database_SQLite3::startBackup() with its own
+	connection, which holds a read transaction started while the server
+	was paused. In WAL mode that doesn't block the server from saving,
+	and later saves are not seen by the copy.
+*/
+class SQLiteBackupThread : public SimpleThread
+{
+public:
+	SQLiteBackupThread(sqlite3 *source, const std::string &target_path):
+		SimpleThread(),
+		m_source(source),
+		m_target_path(target_path)
+	{
+	}
+
+	void * Thread()
+	{
+		ThreadStarted();
+
+		log_register_thread("SQLiteBackupThread");
+
+		DSTACK(__FUNCTION_NAME);
+
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		u32 time1 = porting::getTimeMs();
+		s32 copied = copy_blocks(m_source, m_target_path, this);
+		sqlite3_exec(m_source, "COMMIT;", NULL, NULL, NULL);
+		sqlite3_close(m_source);
+		if(copied >= 0)
+			actionstream<<"Database_SQLite3: Copied "<<copied
+					<<" blocks to \""<<m_target_path<<"\" in "
+					<<(porting::getTimeMs() - time1)<<"ms"<<std::endl;
+
+		END_DEBUG_EXCEPTION_HANDLER(errorstream)
+
+		return NULL;
+	}
+
+private:
+	sqlite3 *m_source;
+	std::string m_target_path;
+};
 
 Database_SQLite3::Database_SQLite3(ServerMap *map, std::string savedir)
 {
@@ -51,6 +220,8 @@ Database_SQLite3::Database_SQLite3(ServerMap *map, std::string savedir)
 	m_database_read = NULL;
 	m_database_write = NULL;
 	m_database_list = NULL;
+	m_checkpoint_thread = NULL;
+	m_backup_thread = NULL;
 	m_savedir = savedir;
 	srvmap = map;
 }
@@ -109,14 +280,7 @@ void Database_SQLite3::verifyDatabase() {
 		if(needs_create)
 			createDatabase();
 
-		std::string querystr = std::string("PRAGMA synchronous = ")
-				 + itos(g_settings->getU16("sqlite_synchronous"));
-		d = sqlite3_exec(m_database, querystr.c_str(), NULL, NULL, NULL);
-		if(d != SQLITE_OK) {
-			infostream<<"WARNING: Database pragma set failed: "
-					<<sqlite3_errmsg(m_database)<<std::endl;
-			throw FileNotGoodException("Cannot set pragma");
-		}
+		setPragmas(dbp);
 
 		d = sqlite3_prepare(m_database, "SELECT `data` FROM `blocks` WHERE `pos`=? LIMIT 1", -1, &m_database_read, NULL);
 		if(d != SQLITE_OK) {
@@ -140,59 +304,97 @@ void Database_SQLite3::verifyDatabase() {
 	}
 }
 
-void Database_SQLite3::saveBlock(MapBlock *block)
+void Database_SQLite3::setPragmas(const std::string &dbp)
 {
-	DSTACK(__FUNCTION_NAME);
+	std::string querystr = std::string("PRAGMA synchronous = ")
+			 + itos(g_settings->getU16("sqlite_synchronous"));
+	int d = sqlite3_exec(m_database, querystr.c_str(), NULL, NULL, NULL);
+	if(d != SQLITE_OK) {
+		infostream<<"WARNING: Database pragma set failed: "
+				<<sqlite3_errmsg(m_database)<<std::endl;
+		throw FileNotGoodException("Cannot set pragma");
+	}
+
 	/*
-		Dummy blocks are not written
+		Journal mode. This pragma returns the mode that is actually in
+		use, which is not the wanted one if eg. the file system doesn't
+		support WAL.
 	*/
-	if(block->isDummy())
-	{
-		/*v3s16 p = block->getPos();
-		infostream<<"Database_SQLite3::saveBlock(): WARNING: Not writing dummy block "
-				<<"("<<p.X<<","<<p.Y<<","<<p.Z<<")"<<std::endl;*/
-		return;
+	std::string journal_mode = lowercase(
+			g_settings->get("sqlite_journal_mode"));
+	querystr = "PRAGMA journal_mode = " + journal_mode;
+	sqlite3_stmt *stmt = NULL;
+	std::string mode_set;
+	if(sqlite3_prepare(m_database, querystr.c_str(), -1, &stmt, NULL)
+			== SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+		mode_set = (const char*)sqlite3_column_text(stmt, 0);
+	sqlite3_finalize(stmt);
+	m_journal_mode = mode_set;
+	if(mode_set != journal_mode)
+		infostream<<"WARNING: SQLite3 journal mode \""<<journal_mode
+				<<"\" could not be set, using \""<<mode_set<<"\""<<std::endl;
+
+	// Negative cache sizes are in KiB instead of pages
+	s32 cache_size = g_settings->getS32("sqlite_cache_size");
+	if(cache_size > 0) {
+		querystr = "PRAGMA cache_size = -" + itos(cache_size);
+		sqlite3_exec(m_database, querystr.c_str(), NULL, NULL, NULL);
 	}
 
-	// Format used for writing
-	u8 version = SER_FMT_VER_HIGHEST_WRITE;
-	// Get destination
-	v3s16 p3d = block->getPos();
-	
-	
-#if 0
-	v2s16 p2d(p3d.X, p3d.Z);
-	std::string sectordir = getSectorDir(p2d);
+	// Ignored by SQLite versions older than 3.7.17
+	s32 mmap_size = g_settings->getS32("sqlite_mmap_size");
+	if(mmap_size > 0) {
+		querystr = "PRAGMA mmap_size = " + itos(mmap_size);
+		sqlite3_exec(m_database, querystr.c_str(), NULL, NULL, NULL);
+	}
 
-	createDirs(sectordir);
+	float checkpoint_interval =
+			g_settings->getFloat("sqlite_checkpoint_interval");
+	if(mode_set == "wal" && checkpoint_interval > 0) {
+		/*
+			Checkpoint in a thread instead of after commits. Automatic
+			checkpoints are only turned off once the connection of the
+			thread is open, so that the log never goes unchecked.
+		*/
+		sqlite3 *db = NULL;
+		if(sqlite3_open_v2(dbp.c_str(), &db, SQLITE_OPEN_READWRITE, NULL)
+				!= SQLITE_OK) {
+			errorstream<<"SQLite3: Failed to open a connection for "
+					<<"checkpoints, SQLite will do them after commits: "
+					<<sqlite3_errmsg(db)<<std::endl;
+			sqlite3_close(db);
+			return;
+		}
+		sqlite3_busy_timeout(db, 1000);
+		sqlite3_exec(m_database, "PRAGMA wal_autocheckpoint = 0",
+				NULL, NULL, NULL);
+		m_checkpoint_thread = new SQLiteCheckpointThread(db,
+				checkpoint_interval * 1000);
+		m_checkpoint_thread->Start();
+	}
+}
 
-	std::string fullpath = sectordir+DIR_DELIM+getBlockFilename(p3d);
-	std::ofstream o(fullpath.c_str(), std::ios_base::binary);
-	if(o.good() == false)
-		throw FileNotGoodException("Cannot open block data");
-#endif
-	/*
-		[0] u8 serialization version
-		[1] data
-	*/
-	
+void Database_SQLite3::saveBlock(MapBlock *block)
+{
+	DSTACK(__FUNCTION_NAME);
+	std::string data;
+	// Dummy blocks are not written
+	if(!serializeBlock(block, data))
+		return;
+
+	saveBlockData(block->getPos(), data);
+
+	// We just wrote it to the disk so clear modified flag
+	block->resetModified();
+}
+
+void Database_SQLite3::saveBlockData(v3s16 p3d, const std::string &data)
+{
 	verifyDatabase();
 	
-	std::ostringstream o(std::ios_base::binary);
-	
-	o.write((char*)&version, 1);
-	
-	// Write basic data
-	block->serialize(o, version, true);
-	
-	// Write block to database
-	
-	std::string tmp = o.str();
-	const char *bytes = tmp.c_str();
-	
 	if(sqlite3_bind_int64(m_database_write, 1, getBlockAsInteger(p3d)) != SQLITE_OK)
 		infostream<<"WARNING: Block position failed to bind: "<<sqlite3_errmsg(m_database)<<std::endl;
-	if(sqlite3_bind_blob(m_database_write, 2, (void *)bytes, o.tellp(), NULL) != SQLITE_OK) // TODO this mught not be the right length
+	if(sqlite3_bind_blob(m_database_write, 2, (void *)data.c_str(), data.size(), NULL) != SQLITE_OK)
 		infostream<<"WARNING: Block data failed to bind: "<<sqlite3_errmsg(m_database)<<std::endl;
 	int written = sqlite3_step(m_database_write);
 	if(written != SQLITE_DONE)
@@ -200,9 +402,6 @@ void Database_SQLite3::saveBlock(MapBlock *block)
 		<<sqlite3_errmsg(m_database)<<std::endl;
 	// Make ready for later reuse
 	sqlite3_reset(m_database_write);
-	
-	// We just wrote it to the disk so clear modified flag
-	block->resetModified();
 }
 
 MapBlock* Database_SQLite3::loadBlock(v3s16 blockpos)
@@ -313,12 +512,7 @@ void Database_SQLite3::createDatabase()
 {
 	int e;
 	assert(m_database);
-	e = sqlite3_exec(m_database,
-		"CREATE TABLE IF NOT EXISTS `blocks` ("
-			"`pos` INT NOT NULL PRIMARY KEY,"
-			"`data` BLOB"
-		");"
-	, NULL, NULL, NULL);
+	e = sqlite3_exec(m_database, blocks_table_sql, NULL, NULL, NULL);
 	if(e == SQLITE_ABORT)
 		throw FileNotGoodException("Could not create sqlite3 database structure");
 	else
@@ -339,8 +533,72 @@ void Database_SQLite3::listAllLoadableBlocks(std::list<v3s16> &dst)
 	}
 }
 
+bool Database_SQLite3::startBackup(const std::string &target_dir)
+{
+	verifyDatabase();
+
+	if(m_backup_thread) {
+		if(m_backup_thread->IsRunning())
+			return false;
+		delete m_backup_thread;
+		m_backup_thread = NULL;
+	}
+
+	std::string target_path = target_dir + DIR_DELIM + "map.sqlite";
+
+	// Without WAL an open read transaction would make saving fail, and
+	// copying right away would stall the server for the whole copy
+	if(m_journal_mode != "wal") {
+		errorstream<<"Database_SQLite3: Snapshots need "
+				<<"sqlite_journal_mode = wal, the database uses \""
+				<<m_journal_mode<<"\""<<std::endl;
+		return false;
+	}
+
+	/*
+		Open a second connection and pin the current state of the
+		database with a read transaction; it's only taken on the first
+		read, so read something.
+	*/
+	std::string dbp = m_savedir + DIR_DELIM + "map.sqlite";
+	sqlite3 *source = NULL;
+	sqlite3_stmt *stmt = NULL;
+	bool ok = sqlite3_open_v2(dbp.c_str(), &source,
+			SQLITE_OPEN_READONLY, NULL) == SQLITE_OK
+		&& sqlite3_exec(source, "BEGIN;", NULL, NULL, NULL) == SQLITE_OK
+		&& sqlite3_prepare(source, "SELECT 1 FROM `blocks` LIMIT 1",
+				-1, &stmt, NULL) == SQLITE_OK;
+	if(ok)
+		ok = sqlite3_step(stmt) != SQLITE_ERROR;
+	sqlite3_finalize(stmt);
+	if(!ok) {
+		errorstream<<"Database_SQLite3: Cannot start backup: "
+				<<sqlite3_errmsg(source)<<std::endl;
+		sqlite3_close(source);
+		return false;
+	}
+
+	m_backup_thread = new SQLiteBackupThread(source, target_path);
+	m_backup_thread->Start();
+	return true;
+}
+
+void Database_SQLite3::stopBackup()
+{
+	if(m_backup_thread) {
+		m_backup_thread->stop();
+		delete m_backup_thread;
+		m_backup_thread = NULL;
+	}
+}
+
 Database_SQLite3::~Database_SQLite3()
 {
+	stopBackup();
+	if(m_checkpoint_thread) {
+		m_checkpoint_thread->stop();
+		delete m_checkpoint_thread;
+	}
 	if(m_database_read)
 		sqlite3_finalize(m_database_read);
 	if(m_database_write)
@@ -28,6 +28,8 @@ extern "C" {
 }
 
 class ServerMap;
+class SQLiteCheckpointThread;
+class SQLiteBackupThread;
 
 class Database_SQLite3 : public Database
 {
@@ -37,9 +39,12 @@ class Database_SQLite3 : public Database
         virtual void endSave();
 
         virtual void saveBlock(MapBlock *block);
+        virtual void saveBlockData(v3s16 blockpos, const std::string &data);
         virtual MapBlock* loadBlock(v3s16 blockpos);
         virtual void listAllLoadableBlocks(std::list<v3s16> &dst);
         virtual int Initialized(void);
+	virtual bool startBackup(const std::string &target_dir);
+	virtual void stopBackup();
 	~Database_SQLite3();
 private:
 	ServerMap *srvmap;
@@ -48,12 +53,20 @@ class Database_SQLite3 : public Database
 	sqlite3_stmt *m_database_read;
 	sqlite3_stmt *m_database_write;
 	sqlite3_stmt *m_database_list;
+	// Checkpoints the write-ahead log; NULL if SQLite does it itself
+	SQLiteCheckpointThread *m_checkpoint_thread;
+	// Copies blocks for startBackup(); NULL if none was started
+	SQLiteBackupThread *m_backup_thread;
+	// Journal mode in use, as reported by SQLite
+	std::string m_journal_mode;
 
 	// Create the database structure
 	void createDatabase();
         // Verify we can read/write to the database
         void verifyDatabase();
         void createDirs(std::string path);
+	// Set the journal mode, cache and checkpointing from settings
+	void setPragmas(const std::string &dbp);
 };
 
 #endif
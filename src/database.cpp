@@ -19,6 +19,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "database.h"
 #include "irrlichttypes.h"
+#include "mapblock.h"
+#include "serialization.h"
+#include <sstream>
 
 static s32 unsignedToSigned(s32 i, s32 max_positive)
 {
@@ -36,6 +39,25 @@ static s64 pythonmodulo(s64 i, s64 mod)
 	return mod - ((-i) % mod);
 }
 
+bool Database::serializeBlock(MapBlock *block, std::string &data)
+{
+	if(block->isDummy())
+		return false;
+
+	// Format used for writing
+	u8 version = SER_FMT_VER_HIGHEST_WRITE;
+
+	/*
+		[0] u8 serialization version
+		[1] data
+	*/
+	std::ostringstream o(std::ios_base::binary);
+	o.write((char*)&version, 1);
+	block->serialize(o, version, true);
+	data = o.str();
+	return true;
+}
+
 long long Database::getBlockAsInteger(const v3s16 pos) {
 	return (unsigned long long)pos.Z*16777216 +
 		(unsigned long long)pos.Y*4096 + 
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define DATABASE_HEADER
 
 #include <list>
+#include <string>
 #include "irr_v3d.h"
 
 class MapBlock;
@@ -32,11 +33,28 @@ class Database
 	virtual void endSave()=0;
 
 	virtual void saveBlock(MapBlock *block)=0;
+	// Writes data made by serializeBlock() for the block at blockpos
+	virtual void saveBlockData(v3s16 blockpos, const std::string &data)=0;
 	virtual MapBlock* loadBlock(v3s16 blockpos)=0;
+	// The serialization version followed by the block, as stored in the
+	// database; false for dummy blocks, which are not written
+	static bool serializeBlock(MapBlock *block, std::string &data);
 	long long getBlockAsInteger(const v3s16 pos);
 	v3s16 getIntegerAsBlock(long long i);
 	virtual void listAllLoadableBlocks(std::list<v3s16> &dst)=0;
 	virtual int Initialized(void)=0;
+	/*
+		Start copying all saved blocks, as they are at the time of the
+		call, into a new database in target_dir. The copy may finish in
+		a background thread. Returns false if the backend can't do it or
+		a copy is still in progress.
+	*/
+	virtual bool startBackup(const std::string &target_dir)
+	{ return false; }
+	// Aborts a copy started by startBackup() and waits for it to stop;
+	// what was copied so far is left in target_dir
+	virtual void stopBackup()
+	{}
 	virtual ~Database() {};
 };
 #endif
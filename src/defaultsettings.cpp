@@ -192,7 +192,12 @@ void set_default_settings(Settings *settings)
 	settings->setDefault("max_objects_per_block", "49");
 	settings->setDefault("server_map_save_interval", "5.3");
 	settings->setDefault("sqlite_synchronous", "2");
+	settings->setDefault("sqlite_journal_mode", "wal");
+	settings->setDefault("sqlite_cache_size", "0");
+	settings->setDefault("sqlite_mmap_size", "0");
+	settings->setDefault("sqlite_checkpoint_interval", "10");
 	settings->setDefault("full_block_send_enable_min_time_from_building", "2.0");
+	settings->setDefault("block_send_settle_time", "0.5");
 	settings->setDefault("dedicated_server_step", "0.1");
 	settings->setDefault("ignore_world_load_errors", "false");
 	settings->setDefault("congestion_control_aim_rtt", "0.2");
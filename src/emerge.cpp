@@ -103,6 +103,9 @@ EmergeManager::EmergeManager(IGameDef *gamedef) {
 	this->luaoverride_params          = NULL;
 	this->luaoverride_params_modified = 0;
 	this->luaoverride_flagmask        = 0;
+
+	this->deco_cutoff_count = 0;
+	deco_cutoff_mutex.Init();
 	
 	mapgen_debug_info = g_settings->getBool("enable_mapgen_debug_info");
 
@@ -140,9 +143,12 @@ EmergeManager::~EmergeManager() {
 		emergethread[i]->qevent.signal();
 		emergethread[i]->stop();
 		delete emergethread[i];
-		delete mapgen[i];
 	}
 	emergethread.clear();
+
+	// Mapgens only exist after initMapgens()
+	for (unsigned int i = 0; i != mapgen.size(); i++)
+		delete mapgen[i];
 	mapgen.clear();
 
 	for (unsigned int i = 0; i < ores.size(); i++)
@@ -178,6 +184,23 @@ void EmergeManager::initMapgens(MapgenParams *mgparams) {
 		
 	for (size_t i = 0; i != decorations.size(); i++)
 		decorations[i]->resolveNodeNames(ndef);
+
+	// Bucket the decorations by biome so that mapgens only try the ones
+	// that can appear in the biomes of a chunk
+	decos_by_biome.clear();
+	decos_by_biome.resize(256);
+	decos_any_biome.clear();
+	for (size_t i = 0; i != decorations.size(); i++) {
+		Decoration *deco = decorations[i];
+		deco->resolveBiomes();
+		if (deco->biomes.empty()) {
+			decos_any_biome.push_back(i);
+			continue;
+		}
+		for (std::set<u8>::iterator it = deco->biomes.begin();
+				it != deco->biomes.end(); ++it)
+			decos_by_biome[*it].push_back(i);
+	}
 	
 	// Apply mapgen parameter overrides from Lua
 	if (luaoverride_params) {
@@ -214,6 +237,51 @@ void EmergeManager::initMapgens(MapgenParams *mgparams) {
 }
 
 
+void EmergeManager::addDecoCutoffs(size_t deco_index, v3s16 chunkpos_above,
+									std::vector<v3s16> &positions) {
+	JMutexAutoLock cutofflock(deco_cutoff_mutex);
+
+	// Entries for chunks that turn out to be generated already are dropped
+	// by ServerMap::finishBlockMake; the cap is only a safety net
+	if (deco_cutoff_count + positions.size() > DECO_CUTOFF_QUEUE_MAX)
+		return;
+
+	std::vector<DecoCutoff> &cutoffs = deco_cutoffs[chunkpos_above];
+	for (size_t i = 0; i != positions.size(); i++)
+		cutoffs.push_back(DecoCutoff(deco_index, positions[i]));
+	deco_cutoff_count += positions.size();
+}
+
+
+bool EmergeManager::popDecoCutoffs(v3s16 chunkpos,
+								std::vector<DecoCutoff> &cutoffs) {
+	JMutexAutoLock cutofflock(deco_cutoff_mutex);
+
+	std::map<v3s16, std::vector<DecoCutoff> >::iterator it =
+		deco_cutoffs.find(chunkpos);
+	if (it == deco_cutoffs.end())
+		return false;
+
+	cutoffs.swap(it->second);
+	deco_cutoffs.erase(it);
+	deco_cutoff_count -= cutoffs.size();
+	return true;
+}
+
+
+void EmergeManager::dropDecoCutoffs(v3s16 chunkpos) {
+	JMutexAutoLock cutofflock(deco_cutoff_mutex);
+
+	std::map<v3s16, std::vector<DecoCutoff> >::iterator it =
+		deco_cutoffs.find(chunkpos);
+	if (it == deco_cutoffs.end())
+		return;
+
+	deco_cutoff_count -= it->second.size();
+	deco_cutoffs.erase(it);
+}
+
+
 Mapgen *EmergeManager::getCurrentMapgen() {
 	for (unsigned int i = 0; i != emergethread.size(); i++) {
 		if (emergethread[i]->IsSameThread())
@@ -501,6 +569,10 @@ void *EmergeThread::Thread() {
 						"Mapgen::makeChunk (envlock)", SPT_AVG);
 
 				map->finishBlockMake(&data, modified_blocks);
+
+				// The neighbours of these blocks are likely to be
+				// generated soon, changing them again
+				m_server->setBlocksSettling(modified_blocks);
 				
 				block = map->getBlockNoCreateNoEx(p);
 				if (block) {
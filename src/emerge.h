@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irr_v3d.h"
 #include "util/container.h"
 #include "map.h" // for ManualMapVoxelManipulator
+#include "mapgen.h" // for DecoCutoff
 
 #define MGPARAMS_SET_MGNAME      1
 #define MGPARAMS_SET_SEED        2
@@ -107,6 +108,16 @@ class EmergeManager : public IBackgroundBlockEmerger {
 	BiomeDefManager *biomedef;
 	std::vector<Ore *> ores;
 	std::vector<Decoration *> decorations;
+	// Indices of the decorations restricted to each biome id, and of those
+	// that are not restricted to any biome
+	std::vector<std::vector<size_t> > decos_by_biome;
+	std::vector<size_t> decos_any_biome;
+
+	// Decorations cut off by the top of their chunk, keyed by the minimum
+	// node position of the chunk above
+	JMutex deco_cutoff_mutex;
+	std::map<v3s16, std::vector<DecoCutoff> > deco_cutoffs;
+	u32 deco_cutoff_count;
 
 	EmergeManager(IGameDef *gamedef);
 	~EmergeManager();
@@ -122,6 +133,11 @@ class EmergeManager : public IBackgroundBlockEmerger {
 	void registerMapgen(std::string name, MapgenFactory *mgfactory);
 	MapgenParams *getParamsFromSettings(Settings *settings);
 	void setParamsToSettings(Settings *settings);
+
+	void addDecoCutoffs(size_t deco_index, v3s16 chunkpos_above,
+		std::vector<v3s16> &positions);
+	bool popDecoCutoffs(v3s16 chunkpos, std::vector<DecoCutoff> &cutoffs);
+	void dropDecoCutoffs(v3s16 chunkpos);
 	
 	//mapgen helper methods
 	Biome *getBiomeAtPoint(v3s16 p);
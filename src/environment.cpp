@@ -320,9 +320,13 @@ ServerEnvironment::ServerEnvironment(ServerMap *map,
 	m_game_time(0),
 	m_game_time_fraction_counter(0),
 	m_recommended_send_interval(0.1),
-	m_max_lag_estimate(0.1)
+	m_max_lag_estimate(0.1),
+	m_falling_clock(0)
 {
 	m_use_weather = g_settings->getBool("weather");
+
+	for(u32 id=1; id<=0xffff; id++)
+		m_free_object_ids.push_back(id);
 }
 
 ServerEnvironment::~ServerEnvironment()
@@ -874,6 +878,202 @@ bool ServerEnvironment::removeNode(v3s16 p)
 	return true;
 }
 
+// Falling and attached nodes are only supported by nodes that have no
+// definition, like in builtin/falling.lua.  ignore is defined there as not
+// walkable, so nodes keep falling into unloaded areas.
+static bool supports_falling(content_t c, const ContentFeatures &f)
+{
+	return (c == CONTENT_UNKNOWN || f.name == "");
+}
+
+// How far a column of falling nodes is moved down without an entity
+#define FALLING_NODE_MAX_DROP 64
+// Falling neighbours of a changed node are checked this much later, like
+// the minetest.after(0.1, ...) of the old nodeupdate.  It only delayed the
+// falling check; attached neighbours were dropped at once.
+#define FALLING_NODE_NEIGHBOUR_DELAY 0.1
+
+void ServerEnvironment::checkForFalling(v3s16 p)
+{
+	std::vector<v3s16> check;
+	check.push_back(p);
+	delayFallingNeighbours(p, check);
+	updateFallingNodes(check);
+}
+
+bool ServerEnvironment::checkSingleForFalling(v3s16 p)
+{
+	std::vector<v3s16> changed;
+	if(!updateFallingNode(p, changed))
+		return false;
+	std::vector<v3s16> check = changed;
+	for(u32 i = 0; i < changed.size(); i++)
+		delayFallingNeighbours(changed[i], check);
+	updateFallingNodes(check);
+	return true;
+}
+
+void ServerEnvironment::delayFallingNeighbours(v3s16 p,
+		std::vector<v3s16> &check)
+{
+	INodeDefManager *ndef = m_gamedef->ndef();
+	for(s16 z = -1; z <= 1; z++)
+	for(s16 y = -1; y <= 1; y++)
+	for(s16 x = -1; x <= 1; x++)
+	{
+		if(x == 0 && y == 0 && z == 0)
+			continue;
+		v3s16 p2 = p + v3s16(x, y, z);
+		if(ndef->get(m_map->getNodeNoEx(p2)).is_attached_node)
+			check.push_back(p2);
+		if(m_falling_delayed_set.insert(p2).second)
+			m_falling_delayed.push_back(std::make_pair(
+					m_falling_clock + FALLING_NODE_NEIGHBOUR_DELAY, p2));
+	}
+}
+
+void ServerEnvironment::stepFallingNodes(float dtime)
+{
+	m_falling_clock += dtime;
+
+	std::vector<v3s16> check;
+	while(!m_falling_delayed.empty() &&
+			m_falling_delayed.front().first <= m_falling_clock)
+	{
+		v3s16 p = m_falling_delayed.front().second;
+		m_falling_delayed.pop_front();
+		m_falling_delayed_set.erase(p);
+		check.push_back(p);
+	}
+	if(!check.empty())
+		updateFallingNodes(check);
+}
+
+void ServerEnvironment::updateFallingNodes(std::vector<v3s16> &check)
+{
+	ScopeProfiler sp(g_profiler, "SEnv: update falling nodes avg", SPT_AVG);
+
+	// A changed node and its attached neighbours are checked again at
+	// once, its other neighbours later
+	std::vector<v3s16> changed;
+	for(u32 i = 0; i < check.size(); i++)
+	{
+		changed.clear();
+		if(!updateFallingNode(check[i], changed))
+			continue;
+		for(u32 j = 0; j < changed.size(); j++)
+		{
+			check.push_back(changed[j]);
+			delayFallingNeighbours(changed[j], check);
+		}
+	}
+}
+
+bool ServerEnvironment::updateFallingNode(v3s16 p,
+		std::vector<v3s16> &changed)
+{
+	INodeDefManager *ndef = m_gamedef->ndef();
+	MapNode n = m_map->getNodeNoEx(p);
+	const ContentFeatures &f = ndef->get(n);
+
+	if(f.is_falling_node)
+	{
+		MapNode nb = m_map->getNodeNoEx(p + v3s16(0,-1,0));
+		const ContentFeatures &fb = ndef->get(nb);
+		// Note: walkable is in the node definition, not in item groups
+		if(!supports_falling(nb.getContent(), fb) &&
+				(!f.is_float || fb.liquid_type == LIQUID_NONE) &&
+				(n.getContent() != nb.getContent() || (fb.leveled &&
+					nb.getLevel(ndef) < nb.getMaxLevel(ndef))) &&
+				(!fb.walkable || fb.buildable_to))
+		{
+			if(dropFallingColumn(p, changed))
+				return true;
+			// The node is removed first, like the builtin did
+			removeNode(p);
+			m_script->node_falling_spawn(p, n);
+			changed.push_back(p);
+			return true;
+		}
+	}
+
+	if(f.is_attached_node)
+	{
+		v3s16 dir(0,-1,0);
+		if(f.param_type_2 == CPT2_WALLMOUNTED)
+			dir = n.getWallMountedDir(ndef);
+		MapNode ns = m_map->getNodeNoEx(p + dir);
+		const ContentFeatures &fs = ndef->get(ns);
+		if(!supports_falling(ns.getContent(), fs) && !fs.walkable)
+		{
+			m_script->node_drop_attached(p);
+			changed.push_back(p);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ServerEnvironment::dropFallingColumn(v3s16 p,
+		std::vector<v3s16> &changed)
+{
+	INodeDefManager *ndef = m_gamedef->ndef();
+
+	/*
+		Only a fall through plain air onto something solid is done here.
+		Leveled nodes, liquids and buildable_to nodes (which the falling
+		entity may replace or merge with) are left to the entity.
+	*/
+	MapNode n = m_map->getNodeNoEx(p);
+	if(ndef->get(n).leveled != 0)
+		return false;
+
+	s16 bottom = p.Y - 1;
+	for(;;)
+	{
+		if(p.Y - bottom > FALLING_NODE_MAX_DROP)
+			return false;
+		content_t c = m_map->getNodeNoEx(
+				v3s16(p.X, bottom, p.Z)).getContent();
+		if(c != CONTENT_AIR)
+			break;
+		bottom--;
+	}
+	if(bottom == p.Y - 1)
+		return false;
+	MapNode nl = m_map->getNodeNoEx(v3s16(p.X, bottom, p.Z));
+	const ContentFeatures &fl = ndef->get(nl);
+	if(supports_falling(nl.getContent(), fl) || !fl.walkable ||
+			fl.buildable_to)
+		return false;
+
+	// Everything stacked on top falls along with the node
+	s16 top = p.Y;
+	for(;;)
+	{
+		MapNode na = m_map->getNodeNoEx(v3s16(p.X, top + 1, p.Z));
+		const ContentFeatures &fa = ndef->get(na);
+		if(!fa.is_falling_node || fa.leveled != 0)
+			break;
+		top++;
+	}
+
+	s16 drop = p.Y - (bottom + 1);
+	for(s16 y = p.Y; y <= top; y++)
+	{
+		v3s16 from(p.X, y, p.Z);
+		v3s16 to(p.X, y - drop, p.Z);
+		MapNode nf = m_map->getNodeNoEx(from);
+		removeNode(from);
+		setNode(to, nf);
+		changed.push_back(from);
+		changed.push_back(to);
+	}
+	g_profiler->add("SEnv: falling nodes dropped (num)", top - p.Y + 1);
+	return true;
+}
+
 std::set<u16> ServerEnvironment::getObjectsInsideRadius(v3f pos, float radius)
 {
 	std::set<u16> objects;
@@ -891,6 +1091,49 @@ std::set<u16> ServerEnvironment::getObjectsInsideRadius(v3f pos, float radius)
 	return objects;
 }
 
+void ServerEnvironment::getObjectsInArea(const aabb3f &box,
+		const ActiveObjectQuery &query, std::vector<u16> &result)
+{
+	for(std::map<u16, ServerActiveObject*>::iterator
+			i = m_active_objects.begin();
+			i != m_active_objects.end(); ++i)
+	{
+		ServerActiveObject* obj = i->second;
+		if(obj->m_removed)
+			continue;
+		if(!box.isPointInside(obj->getBasePosition()))
+			continue;
+		u8 type = obj->getType();
+		if(query.type != ACTIVEOBJECT_TYPE_INVALID && type != query.type)
+			continue;
+		if(!query.name.empty())
+		{
+			if(type == ACTIVEOBJECT_TYPE_LUAENTITY)
+			{
+				LuaEntitySAO *entity = (LuaEntitySAO*)obj;
+				if(entity->getName() != query.name)
+					continue;
+			}
+			else if(type == ACTIVEOBJECT_TYPE_PLAYER)
+			{
+				Player *player = ((PlayerSAO*)obj)->getPlayer();
+				if(player == NULL || query.name != player->getName())
+					continue;
+			}
+			else
+			{
+				continue;
+			}
+		}
+		if(!query.armor_group.empty() &&
+				obj->getArmorGroup(query.armor_group) == 0)
+			continue;
+		result.push_back(i->first);
+	}
+	g_profiler->add("SEnv: objects in area queried (num)",
+			m_active_objects.size());
+}
+
 void ServerEnvironment::clearAllObjects()
 {
 	infostream<<"ServerEnvironment::clearAllObjects(): "
@@ -937,6 +1180,7 @@ void ServerEnvironment::clearAllObjects()
 			i != objects_to_remove.end(); ++i)
 	{
 		m_active_objects.erase(*i);
+		m_free_object_ids.push_back(*i);
 	}
 
 	// Get list of loaded blocks
@@ -1244,6 +1488,11 @@ void ServerEnvironment::step(float dtime)
 		}
 	}while(0);
 	
+	/*
+		Check falling and attached nodes next to the ones that changed
+	*/
+	stepFallingNodes(dtime);
+
 	/*
 		Step script environment (run global on_step())
 	*/
@@ -1323,20 +1572,20 @@ bool isFreeServerActiveObjectId(u16 id,
 }
 
 u16 getFreeServerActiveObjectId(
-		std::map<u16, ServerActiveObject*> &objects)
+		std::map<u16, ServerActiveObject*> &objects,
+		std::deque<u16> &free_ids)
 {
-	//try to reuse id's as late as possible
-	static u16 last_used_id = 0;
-	u16 startid = last_used_id;
-	for(;;)
+	// Ids are queued in the order they became free, so they are reused as
+	// late as possible.  Objects added with a given id leave it in the
+	// queue, skip those.
+	while(!free_ids.empty())
 	{
-		last_used_id ++;
-		if(isFreeServerActiveObjectId(last_used_id, objects))
-			return last_used_id;
-		
-		if(last_used_id == startid)
-			return 0;
+		u16 id = free_ids.front();
+		free_ids.pop_front();
+		if(isFreeServerActiveObjectId(id, objects))
+			return id;
 	}
+	return 0;
 }
 
 u16 ServerEnvironment::addActiveObject(ServerActiveObject *object)
@@ -1509,7 +1758,8 @@ u16 ServerEnvironment::addActiveObjectRaw(ServerActiveObject *object,
 {
 	assert(object);
 	if(object->getId() == 0){
-		u16 new_id = getFreeServerActiveObjectId(m_active_objects);
+		u16 new_id = getFreeServerActiveObjectId(m_active_objects,
+				m_free_object_ids);
 		if(new_id == 0)
 		{
 			errorstream<<"ServerEnvironment::addActiveObjectRaw(): "
@@ -1663,6 +1913,7 @@ void ServerEnvironment::removeRemovedObjects()
 			i != objects_to_remove.end(); ++i)
 	{
 		m_active_objects.erase(*i);
+		m_free_object_ids.push_back(*i);
 	}
 }
 
@@ -2029,6 +2280,7 @@ void ServerEnvironment::deactivateFarObjects(bool force_delete)
 			i != objects_to_remove.end(); ++i)
 	{
 		m_active_objects.erase(*i);
+		m_free_object_ids.push_back(*i);
 	}
 }
 
@@ -32,6 +32,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <set>
 #include <list>
+#include <deque>
+#include <vector>
 #include <map>
 #include "irr_v3d.h"
 #include "activeobject.h"
@@ -174,6 +176,36 @@ class ActiveBlockList
 private:
 };
 
+/*
+	Filter for ServerEnvironment::getObjectsInArea. Empty fields and
+	ACTIVEOBJECT_TYPE_INVALID match everything.
+*/
+
+struct ActiveObjectQuery
+{
+	// ACTIVEOBJECT_TYPE_PLAYER or ACTIVEOBJECT_TYPE_LUAENTITY
+	u8 type;
+	// Entity name or player name
+	std::string name;
+	// Only objects that have a nonzero rating in this armor group
+	std::string armor_group;
+
+	ActiveObjectQuery():
+		type(ACTIVEOBJECT_TYPE_INVALID)
+	{}
+};
+
+/*
+	Active object id allocation. free_ids holds the ids in the order they
+	became free; ids already present in objects are skipped.
+*/
+
+bool isFreeServerActiveObjectId(u16 id,
+		std::map<u16, ServerActiveObject*> &objects);
+u16 getFreeServerActiveObjectId(
+		std::map<u16, ServerActiveObject*> &objects,
+		std::deque<u16> &free_ids);
+
 /*
 	The server-side environment.
 
@@ -283,9 +315,26 @@ class ServerEnvironment : public Environment
 	// Script-aware node setters
 	bool setNode(v3s16 p, const MapNode &n);
 	bool removeNode(v3s16 p);
+
+	/*
+		Make unsupported falling_node nodes fall and drop unsupported
+		attached_node nodes at p.  Of the 26 neighbours of p and of
+		everything that changes, attached nodes are checked at once and
+		falling nodes 0.1 seconds later, like the recursive nodeupdate of
+		builtin/falling.lua did.
+	*/
+	void checkForFalling(v3s16 p);
+	// Same, but only checks p itself. Returns true if p was changed.
+	bool checkSingleForFalling(v3s16 p);
+	// Checks the queued neighbours that are due; called by step()
+	void stepFallingNodes(float dtime);
 	
 	// Find all active objects inside a radius around a point
 	std::set<u16> getObjectsInsideRadius(v3f pos, float radius);
+	// Find active objects inside a box that match query, in id order.
+	// Appends to result.
+	void getObjectsInArea(const aabb3f &box, const ActiveObjectQuery &query,
+			std::vector<u16> &result);
 	
 	// Clear all objects, loading and going through every MapBlock
 	void clearAllObjects();
@@ -344,6 +393,21 @@ class ServerEnvironment : public Environment
 	*/
 	void deactivateFarObjects(bool force_delete);
 
+	/*
+		Falling and attached nodes
+	*/
+	// Checks the node at p; positions that were changed are appended
+	bool updateFallingNode(v3s16 p, std::vector<v3s16> &changed);
+	// Moves a column of falling nodes straight down onto the ground,
+	// returns false if it needs a falling entity instead
+	bool dropFallingColumn(v3s16 p, std::vector<v3s16> &changed);
+	// Checks the positions in check, and again every position that
+	// changes; the neighbours of those are delayed
+	void updateFallingNodes(std::vector<v3s16> &check);
+	// Queues the 26 neighbours of p to be checked a bit later; the
+	// attached nodes among them are also appended to check
+	void delayFallingNeighbours(v3s16 p, std::vector<v3s16> &check);
+
 	/*
 		Member variables
 	*/
@@ -358,6 +422,8 @@ class ServerEnvironment : public Environment
 	IBackgroundBlockEmerger *m_emerger;
 	// Active object list
 	std::map<u16, ServerActiveObject*> m_active_objects;
+	// Ids of no active object, oldest freed first
+	std::deque<u16> m_free_object_ids;
 	// Outgoing network message buffer for active objects
 	std::list<ActiveObjectMessage> m_active_object_messages;
 	// Some timers
@@ -381,6 +447,11 @@ class ServerEnvironment : public Environment
 	// Estimate for general maximum lag as determined by server.
 	// Can raise to high values like 15s with eg. map generation mods.
 	float m_max_lag_estimate;
+	// Neighbours of changed falling and attached nodes, waiting to be
+	// checked, in the order of the time they are due
+	std::deque<std::pair<double, v3s16> > m_falling_delayed;
+	std::set<v3s16> m_falling_delayed_set;
+	double m_falling_clock;
 };
 
 #ifndef SERVER
@@ -68,6 +68,7 @@
 #include "event_manager.h"
 #include <iomanip>
 #include <list>
+#include <set>
 #include "util/directiontables.h"
 
 /*
@@ -219,6 +220,75 @@ inline bool isPointableNode(const MapNode& n,
     (liquids_pointable && features.isLiquid());
 }
 
+/*
+  Check whether the shootline hits a face of the node at np, and make it
+  the result if the face is closer than anything found so far
+*/
+static void checkPointedNode(v3s16 np, const MapNode &n,
+			     INodeDefManager *nodedef, v3f camera_position,
+			     const core::line3d<f32> &shootline,
+			     PointedThing &result, f32 &mindistance,
+			     std::vector<aabb3f> &hilightboxes)
+{
+  std::vector<aabb3f> boxes = n.getSelectionBoxes(nodedef);
+
+  v3f npf = intToFloat(np, BS);
+
+  for(std::vector<aabb3f>::const_iterator
+	i = boxes.begin();
+      i != boxes.end(); i++)
+    {
+      aabb3f box = *i;
+      box.MinEdge += npf;
+      box.MaxEdge += npf;
+      
+      for(u16 j=0; j<6; j++)
+	{
+	  v3s16 facedir = g_6dirs[j];
+	  aabb3f facebox = box;
+
+	  f32 d = 0.001*BS;
+	  if(facedir.X > 0)
+	    facebox.MinEdge.X = facebox.MaxEdge.X-d;
+	  else if(facedir.X < 0)
+	    facebox.MaxEdge.X = facebox.MinEdge.X+d;
+	  else if(facedir.Y > 0)
+	    facebox.MinEdge.Y = facebox.MaxEdge.Y-d;
+	  else if(facedir.Y < 0)
+	    facebox.MaxEdge.Y = facebox.MinEdge.Y+d;
+	  else if(facedir.Z > 0)
+	    facebox.MinEdge.Z = facebox.MaxEdge.Z-d;
+	  else if(facedir.Z < 0)
+	    facebox.MaxEdge.Z = facebox.MinEdge.Z+d;
+
+	  v3f centerpoint = facebox.getCenter();
+	  f32 distance = (centerpoint - camera_position).getLength();
+	  if(distance >= mindistance)
+	    continue;
+	  if(!facebox.intersectsWithLine(shootline))
+	    continue;
+
+	  v3s16 np_above = np + facedir;
+
+	  result.type = POINTEDTHING_NODE;
+	  result.node_undersurface = np;
+	  result.node_abovesurface = np_above;
+	  mindistance = distance;
+
+	  hilightboxes.clear();
+	  for(std::vector<aabb3f>::const_iterator
+		i2 = boxes.begin();
+	      i2 != boxes.end(); i2++)
+	    {
+	      aabb3f box = *i2;
+	      box.MinEdge += npf + v3f(-d,-d,-d);
+	      box.MaxEdge += npf + v3f(d,d,d);
+	      hilightboxes.push_back(box);
+	    }
+	}
+    }
+}
+
 /*
   Find what the player is pointing at
 */
@@ -291,81 +361,107 @@ PointedThing getPointedThing(Client *client, v3f player_position,
   if(xend==32767)
     xend=32766;
 
-  for(s16 y = ystart; y <= yend; y++)
-    for(s16 z = zstart; z <= zend; z++)
-      for(s16 x = xstart; x <= xend; x++)
-	{
-	  MapNode n;
-	  try
-	    {
-	      n = map.getNode(v3s16(x,y,z));
-	    }
-	  catch(InvalidPositionException &e)
+  /*
+    Walk the nodes the shootline passes through, in order.  Selection
+    boxes may reach out of their node by up to one node, so the neighbours
+    of every node on the way are checked too.  Only nodes inside the
+    range above are considered.
+  */
+  v3f dir = shootline.end - shootline.start;
+  f32 length = dir.getLength();
+  f32 start_offset = (shootline.start - camera_position).getLength();
+  // Largest distance from where the shootline enters a face to the
+  // face center, for boxes reaching one node out of their node
+  f32 max_face_radius = 1.5 * BS * 1.415 + 0.01 * BS;
+
+  v3s16 cell = floatToInt(shootline.start, BS);
+  v3s16 step(0,0,0);
+  v3f tmax(2.0, 2.0, 2.0); // As fraction of the shootline
+  v3f tdelta(0.0, 0.0, 0.0);
+  if(dir.X != 0)
+    {
+      step.X = dir.X > 0 ? 1 : -1;
+      tmax.X = ((cell.X + 0.5 * step.X) * BS - shootline.start.X) / dir.X;
+      tdelta.X = BS / fabs(dir.X);
+    }
+  if(dir.Y != 0)
+    {
+      step.Y = dir.Y > 0 ? 1 : -1;
+      tmax.Y = ((cell.Y + 0.5 * step.Y) * BS - shootline.start.Y) / dir.Y;
+      tdelta.Y = BS / fabs(dir.Y);
+    }
+  if(dir.Z != 0)
+    {
+      step.Z = dir.Z > 0 ? 1 : -1;
+      tmax.Z = ((cell.Z + 0.5 * step.Z) * BS - shootline.start.Z) / dir.Z;
+      tdelta.Z = BS / fabs(dir.Z);
+    }
+
+  /*
+    The walk never turns back along any axis, so every node that was
+    looked at before is also a neighbour of the previous cell.  Comparing
+    against that cell is enough to skip them.
+  */
+  v3s16 prev_cell = cell;
+  bool have_prev_cell = false;
+
+  for(;;)
+    {
+      for(s16 y = cell.Y - 1; y <= cell.Y + 1; y++)
+	for(s16 z = cell.Z - 1; z <= cell.Z + 1; z++)
+	  for(s16 x = cell.X - 1; x <= cell.X + 1; x++)
 	    {
-	      continue;
-	    }
-	  if(!isPointableNode(n, client, liquids_pointable))
-	    continue;
+	      if(x < xstart || x > xend ||
+		 y < ystart || y > yend ||
+		 z < zstart || z > zend)
+		continue;
 
-	  std::vector<aabb3f> boxes = n.getSelectionBoxes(nodedef);
+	      if(have_prev_cell &&
+		 abs(x - prev_cell.X) <= 1 &&
+		 abs(y - prev_cell.Y) <= 1 &&
+		 abs(z - prev_cell.Z) <= 1)
+		continue;
 
-	  v3s16 np(x,y,z);
-	  v3f npf = intToFloat(np, BS);
+	      v3s16 np(x,y,z);
 
-	  for(std::vector<aabb3f>::const_iterator
-		i = boxes.begin();
-	      i != boxes.end(); i++)
-	    {
-	      aabb3f box = *i;
-	      box.MinEdge += npf;
-	      box.MaxEdge += npf;
-	      
-	      for(u16 j=0; j<6; j++)
-		{
-		  v3s16 facedir = g_6dirs[j];
-		  aabb3f facebox = box;
-
-		  f32 d = 0.001*BS;
-		  if(facedir.X > 0)
-		    facebox.MinEdge.X = facebox.MaxEdge.X-d;
-		  else if(facedir.X < 0)
-		    facebox.MaxEdge.X = facebox.MinEdge.X+d;
-		  else if(facedir.Y > 0)
-		    facebox.MinEdge.Y = facebox.MaxEdge.Y-d;
-		  else if(facedir.Y < 0)
-		    facebox.MaxEdge.Y = facebox.MinEdge.Y+d;
-		  else if(facedir.Z > 0)
-		    facebox.MinEdge.Z = facebox.MaxEdge.Z-d;
-		  else if(facedir.Z < 0)
-		    facebox.MaxEdge.Z = facebox.MinEdge.Z+d;
-
-		  v3f centerpoint = facebox.getCenter();
-		  f32 distance = (centerpoint - camera_position).getLength();
-		  if(distance >= mindistance)
-		    continue;
-		  if(!facebox.intersectsWithLine(shootline))
-		    continue;
-
-		  v3s16 np_above = np + facedir;
-
-		  result.type = POINTEDTHING_NODE;
-		  result.node_undersurface = np;
-		  result.node_abovesurface = np_above;
-		  mindistance = distance;
-
-		  hilightboxes.clear();
-		  for(std::vector<aabb3f>::const_iterator
-			i2 = boxes.begin();
-		      i2 != boxes.end(); i2++)
-		    {
-		      aabb3f box = *i2;
-		      box.MinEdge += npf + v3f(-d,-d,-d);
-		      box.MaxEdge += npf + v3f(d,d,d);
-		      hilightboxes.push_back(box);
-		    }
-		}
+	      MapNode n = map.getNodeNoEx(np);
+	      if(n.getContent() == CONTENT_IGNORE)
+		continue;
+	      if(!isPointableNode(n, client, liquids_pointable))
+		continue;
+
+	      checkPointedNode(np, n, nodedef, camera_position, shootline,
+			       result, mindistance, hilightboxes);
 	    }
-	} // for coords
+
+      prev_cell = cell;
+      have_prev_cell = true;
+
+      f32 texit = MYMIN(tmax.X, MYMIN(tmax.Y, tmax.Z));
+      if(texit >= 1.0)
+	break;
+
+      // Whatever is further along can't be closer than what was found
+      if(result.type == POINTEDTHING_NODE &&
+	 texit * length - start_offset - max_face_radius >= mindistance)
+	break;
+
+      if(tmax.X <= tmax.Y && tmax.X <= tmax.Z)
+	{
+	  cell.X += step.X;
+	  tmax.X += tdelta.X;
+	}
+      else if(tmax.Y <= tmax.Z)
+	{
+	  cell.Y += step.Y;
+	  tmax.Y += tdelta.Y;
+	}
+      else
+	{
+	  cell.Z += step.Z;
+	  tmax.Z += tdelta.Z;
+	}
+    }
 
   return result;
 }
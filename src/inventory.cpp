@@ -28,6 +28,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "nameidmapping.h" // For loading legacy MaterialItems
 #include "util/serialize.h"
 #include "util/string.h"
+#include "jthread/jmutexautolock.h"
+#include <map>
 
 /*
 	ItemStack
@@ -45,19 +47,7 @@ static content_t content_translate_from_19_to_internal(content_t c_from)
 	return c_from;
 }
 
-// If the string contains spaces, quotes or control characters, encodes as JSON.
-// Else returns the string unmodified.
-static std::string serializeJsonStringIfNeeded(const std::string &s)
-{
-	for(size_t i = 0; i < s.size(); ++i)
-	{
-		if(s[i] <= 0x1f || s[i] >= 0x7f || s[i] == ' ' || s[i] == '\"')
-			return serializeJsonString(s);
-	}
-	return s;
-}
-
-// Parses a string serialized by serializeJsonStringIfNeeded.
+// Parses a string serialized by appendJsonStringIfNeeded.
 static std::string deSerializeJsonStringIfNeeded(std::istream &is)
 {
 	std::ostringstream tmp_os;
@@ -128,25 +118,7 @@ void ItemStack::serialize(std::ostream &os) const
 {
 	DSTACK(__FUNCTION_NAME);
 
-	if(empty())
-		return;
-
-	// Check how many parts of the itemstring are needed
-	int parts = 1;
-	if(count != 1)
-		parts = 2;
-	if(wear != 0)
-		parts = 3;
-	if(metadata != "")
-		parts = 4;
-
-	os<<serializeJsonStringIfNeeded(name);
-	if(parts >= 2)
-		os<<" "<<count;
-	if(parts >= 3)
-		os<<" "<<wear;
-	if(parts >= 4)
-		os<<" "<<serializeJsonStringIfNeeded(metadata);
+	os<<getItemString();
 }
 
 void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
@@ -300,18 +272,183 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 		count = 1;
 }
 
+// Item names that deSerialize() has to convert from an obsolete format
+static bool isLegacyItemName(const char *s, size_t len)
+{
+	static const char *legacy_names[] = {
+		"MaterialItem", "MaterialItem2", "MaterialItem3", "MBOItem",
+		"node", "NodeItem", "craft", "CraftItem", "tool", "ToolItem",
+	};
+	for(u32 i=0; i<sizeof(legacy_names)/sizeof(legacy_names[0]); i++)
+	{
+		if(strlen(legacy_names[i]) == len &&
+				memcmp(legacy_names[i], s, len) == 0)
+			return true;
+	}
+	return false;
+}
+
+// Parses an unsigned decimal field of at most 5 digits.
+// Returns false if the field contains anything else.
+static bool parseItemStringNumber(const char *s, size_t len, u16 &result)
+{
+	if(len == 0 || len > 5)
+		return false;
+	u32 value = 0;
+	for(size_t i = 0; i < len; i++)
+	{
+		if(s[i] < '0' || s[i] > '9')
+			return false;
+		value = value * 10 + (s[i] - '0');
+	}
+	// Wraps around like the stream parser does
+	result = value;
+	return true;
+}
+
+/*
+	Parses the common form of an item string ("name [count [wear
+	[metadata]]]" with no JSON quoting) directly from the buffer.
+	Returns false without touching the stack if the string needs the
+	full stream parser (legacy formats, quoted strings, odd numbers).
+*/
+bool ItemStack::deSerializeFast(const std::string &str,
+		IItemDefManager *itemdef)
+{
+	const char *s = str.c_str();
+	size_t len = str.size();
+	if(len > 0 && s[0] == '"')
+		return false;
+
+	size_t pos = 0;
+	while(pos < len && s[pos] != ' ')
+		pos++;
+	size_t name_len = pos;
+	if(isLegacyItemName(s, name_len))
+		return false;
+
+	u16 new_count = 1;
+	u16 new_wear = 0;
+	const char *meta = s;
+	size_t meta_len = 0;
+
+	do  // This loop is just to allow "break;"
+	{
+		// Read the count
+		if(pos >= len)
+			break;
+		size_t start = ++pos;
+		while(pos < len && s[pos] != ' ')
+			pos++;
+		if(pos == start)
+			break;
+		if(!parseItemStringNumber(s + start, pos - start, new_count))
+			return false;
+
+		// Read the wear
+		if(pos >= len)
+			break;
+		start = ++pos;
+		while(pos < len && s[pos] != ' ')
+			pos++;
+		if(pos == start)
+			break;
+		if(!parseItemStringNumber(s + start, pos - start, new_wear))
+			return false;
+
+		// Read metadata; anything after it is ignored
+		if(pos >= len)
+			break;
+		start = ++pos;
+		if(pos < len && s[pos] == '"')
+			return false;
+		while(pos < len && s[pos] != ' ')
+			pos++;
+		meta = s + start;
+		meta_len = pos - start;
+	} while(false);
+
+	name.assign(s, name_len);
+	name = itemdef->getAlias(name);
+	count = new_count;
+	wear = new_wear;
+	metadata.assign(meta, meta_len);
+
+	if(name.empty() || count == 0)
+		clear();
+	else if(itemdef->get(name).type == ITEM_TOOL)
+		count = 1;
+	return true;
+}
+
 void ItemStack::deSerialize(const std::string &str, IItemDefManager *itemdef)
 {
+	if(deSerializeFast(str, itemdef))
+		return;
 	std::istringstream is(str, std::ios::binary);
 	deSerialize(is, itemdef);
 }
 
+// If the string contains spaces, quotes or control characters, appends it
+// encoded as JSON. Else appends the string unmodified.
+static void appendJsonStringIfNeeded(std::string &to, const std::string &s)
+{
+	for(size_t i = 0; i < s.size(); ++i)
+	{
+		if(s[i] <= 0x1f || s[i] >= 0x7f || s[i] == ' ' || s[i] == '\"')
+		{
+			to += serializeJsonString(s);
+			return;
+		}
+	}
+	to += s;
+}
+
+static void appendItemStringNumber(std::string &to, u16 n)
+{
+	char buf[6];
+	char *p = buf + sizeof(buf);
+	do
+	{
+		*--p = '0' + n % 10;
+		n /= 10;
+	} while(n != 0);
+	to.append(p, buf + sizeof(buf) - p);
+}
+
 std::string ItemStack::getItemString() const
 {
-	// Get item string
-	std::ostringstream os(std::ios::binary);
-	serialize(os);
-	return os.str();
+	std::string s;
+	if(empty())
+		return s;
+
+	// Check how many parts of the itemstring are needed
+	int parts = 1;
+	if(count != 1)
+		parts = 2;
+	if(wear != 0)
+		parts = 3;
+	if(metadata != "")
+		parts = 4;
+
+	s.reserve(name.size() + metadata.size() + 16);
+	appendJsonStringIfNeeded(s, name);
+	if(parts >= 2)
+	{
+		s += ' ';
+		appendItemStringNumber(s, count);
+	}
+	if(parts >= 3)
+	{
+		s += ' ';
+		appendItemStringNumber(s, wear);
+	}
+	if(parts >= 4)
+	{
+		s += ' ';
+		appendJsonStringIfNeeded(s, metadata);
+	}
+	return s;
 }
 
 ItemStack ItemStack::addItem(const ItemStack &newitem_,
@@ -427,9 +564,44 @@ ItemStack ItemStack::peekItem(u32 peekcount) const
 	Inventory
 */
 
+class InventoryListNames
+{
+public:
+	InventoryListNames()
+	{
+		m_mutex.Init();
+	}
+
+	u32 getId(const std::string &name, bool add)
+	{
+		// Lists are also created by the emerge threads, for node metadata
+		JMutexAutoLock lock(m_mutex);
+		std::map<std::string, u32>::const_iterator i = m_ids.find(name);
+		if(i != m_ids.end())
+			return i->second;
+		if(!add)
+			return 0;
+		u32 id = m_ids.size() + 1;
+		m_ids[name] = id;
+		return id;
+	}
+
+private:
+	JMutex m_mutex;
+	std::map<std::string, u32> m_ids;
+};
+
+static InventoryListNames g_inventory_list_names;
+
+u32 getInventoryListNameId(const std::string &name, bool add)
+{
+	return g_inventory_list_names.getId(name, add);
+}
+
 InventoryList::InventoryList(std::string name, u32 size, IItemDefManager *itemdef)
 {
 	m_name = name;
+	m_name_id = getInventoryListNameId(name);
 	m_size = size;
 	m_width = 0;
 	m_itemdef = itemdef;
@@ -468,6 +640,7 @@ void InventoryList::setWidth(u32 newwidth)
 void InventoryList::setName(const std::string &name)
 {
 	m_name = name;
+	m_name_id = getInventoryListNameId(name);
 }
 
 void InventoryList::serialize(std::ostream &os) const
@@ -507,11 +680,8 @@ void InventoryList::deSerialize(std::istream &is)
 		std::string line;
 		std::getline(is, line, '\n');
 
-		std::istringstream iss(line);
-		//iss.imbue(std::locale("C"));
-
-		std::string name;
-		std::getline(iss, name, ' ');
+		size_t name_end = line.find(' ');
+		std::string name = line.substr(0, name_end);
 
 		if(name == "EndInventoryList")
 		{
@@ -524,6 +694,8 @@ void InventoryList::deSerialize(std::istream &is)
 		}
 		else if(name == "Width")
 		{
+			std::istringstream iss(line);
+			std::getline(iss, name, ' ');
 			iss >> m_width;
 			if (iss.fail())
 				throw SerializationError("incorrect width property");
@@ -532,9 +704,10 @@ void InventoryList::deSerialize(std::istream &is)
 		{
 			if(item_i > getSize() - 1)
 				throw SerializationError("too many items");
-			ItemStack item;
-			item.deSerialize(iss, m_itemdef);
-			m_items[item_i++] = item;
+			std::string itemstring;
+			if(name_end != std::string::npos)
+				itemstring = line.substr(name_end + 1);
+			m_items[item_i++].deSerialize(itemstring, m_itemdef);
 		}
 		else if(name == "Empty")
 		{
@@ -556,6 +729,7 @@ InventoryList & InventoryList::operator = (const InventoryList &other)
 	m_size = other.m_size;
 	m_width = other.m_width;
 	m_name = other.m_name;
+	m_name_id = other.m_name_id;
 	m_itemdef = other.m_itemdef;
 	//setDirty(true);
 
@@ -587,6 +761,11 @@ const std::string &InventoryList::getName() const
 	return m_name;
 }
 
+u32 InventoryList::getNameId() const
+{
+	return m_name_id;
+}
+
 u32 InventoryList::getSize() const
 {
 	return m_items.size();
@@ -995,6 +1174,16 @@ bool Inventory::deleteList(const std::string &name)
 	return true;
 }
 
+InventoryList * Inventory::getListById(u32 name_id)
+{
+	for(u32 i=0; i<m_lists.size(); i++)
+	{
+		if(m_lists[i]->getNameId() == name_id)
+			return m_lists[i];
+	}
+	return NULL;
+}
+
 const InventoryList * Inventory::getList(const std::string &name) const
 {
 	s32 i = getListIndex(name);
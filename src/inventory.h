@@ -41,6 +41,9 @@ struct ItemStack
 	void serialize(std::ostream &os) const;
 	void deSerialize(std::istream &is, IItemDefManager *itemdef);
 	void deSerialize(const std::string &s, IItemDefManager *itemdef);
+	// Parses plain item strings without a stream; returns false if
+	// the string needs deSerialize(std::istream&) instead
+	bool deSerializeFast(const std::string &s, IItemDefManager *itemdef);
 
 	// Returns the string used for inventory
 	std::string getItemString() const;
@@ -168,6 +171,13 @@ struct ItemStack
 	std::string metadata;
 };
 
+/*
+	Returns a process-wide id for an inventory list name, so that lists
+	can be looked up without comparing strings. Ids start at 1.
+	If add is false, returns 0 for names no list has had yet.
+*/
+u32 getInventoryListNameId(const std::string &name, bool add=true);
+
 class InventoryList
 {
 public:
@@ -185,6 +195,8 @@ class InventoryList
 	bool operator == (const InventoryList &other);
 
 	const std::string &getName() const;
+	// getInventoryListNameId() of the name
+	u32 getNameId() const;
 	u32 getSize() const;
 	u32 getWidth() const;
 	// Count used slots
@@ -244,6 +256,7 @@ class InventoryList
 	std::vector<ItemStack> m_items;
 	u32 m_size, m_width;
 	std::string m_name;
+	u32 m_name_id;
 	IItemDefManager *m_itemdef;
 };
 
@@ -266,6 +279,8 @@ class Inventory
 	InventoryList * addList(const std::string &name, u32 size);
 	InventoryList * getList(const std::string &name);
 	const InventoryList * getList(const std::string &name) const;
+	// name_id is from getInventoryListNameId()
+	InventoryList * getListById(u32 name_id);
 	std::vector<const InventoryList*> getLists();
 	bool deleteList(const std::string &name);
 	// A shorthand for adding items. Returns leftover item (possibly empty).
@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "settings.h"
 #include "craftdef.h"
 #include "rollback_interface.h"
+#include "util/serialize.h"
 
 #define PP(x) "("<<(x).X<<","<<(x).Y<<","<<(x).Z<<")"
 
@@ -110,6 +111,46 @@ void InventoryLocation::deSerialize(std::string s)
 	deSerialize(is);
 }
 
+void InventoryLocation::serializeBinary(std::ostream &os) const
+{
+	writeU8(os, type);
+	switch(type){
+	case InventoryLocation::UNDEFINED:
+	case InventoryLocation::CURRENT_PLAYER:
+		break;
+	case InventoryLocation::PLAYER:
+	case InventoryLocation::DETACHED:
+		os<<serializeString(name);
+		break;
+	case InventoryLocation::NODEMETA:
+		writeV3S16(os, p);
+		break;
+	default:
+		assert(0);
+	}
+}
+
+void InventoryLocation::deSerializeBinary(std::istream &is)
+{
+	u8 t = readU8(is);
+	switch(t){
+	case InventoryLocation::UNDEFINED:
+	case InventoryLocation::CURRENT_PLAYER:
+		break;
+	case InventoryLocation::PLAYER:
+	case InventoryLocation::DETACHED:
+		name = deSerializeString(is);
+		break;
+	case InventoryLocation::NODEMETA:
+		p = readV3S16(is);
+		break;
+	default:
+		infostream<<"Unknown InventoryLocation type="<<(int)t<<std::endl;
+		throw SerializationError("Unknown InventoryLocation type");
+	}
+	type = (Type)t;
+}
+
 /*
 	InventoryAction
 */
@@ -137,6 +178,78 @@ InventoryAction * InventoryAction::deSerialize(std::istream &is)
 	return a;
 }
 
+InventoryAction * InventoryAction::deSerializeBinary(std::istream &is)
+{
+	u8 type = readU8(is);
+	if(is.eof())
+		throw SerializationError("InventoryAction: no type");
+
+	InventoryAction *a = NULL;
+
+	try{
+		if(type == IACTION_MOVE)
+		{
+			IMoveAction *ma = new IMoveAction;
+			a = ma;
+			ma->deSerializeBinary(is);
+		}
+		else if(type == IACTION_DROP)
+		{
+			IDropAction *da = new IDropAction;
+			a = da;
+			da->deSerializeBinary(is);
+		}
+		else if(type == IACTION_CRAFT)
+		{
+			ICraftAction *ca = new ICraftAction;
+			a = ca;
+			ca->deSerializeBinary(is);
+		}
+
+		if(a && is.fail())
+			throw SerializationError("InventoryAction: data cut short");
+	}
+	catch(SerializationError &e)
+	{
+		delete a;
+		throw;
+	}
+	return a;
+}
+
+void InventoryAction::coalesce(std::vector<InventoryAction*> &actions)
+{
+	if(actions.empty())
+		return;
+
+	u32 last = 0;
+	for(u32 i=1; i<actions.size(); i++)
+	{
+		InventoryAction *a = actions[i];
+		InventoryAction *prev = actions[last];
+		if(a->getType() == IACTION_MOVE && prev->getType() == IACTION_MOVE)
+		{
+			IMoveAction *ma = (IMoveAction*)a;
+			IMoveAction *pa = (IMoveAction*)prev;
+			// count=0 ("everything") can't be added up
+			if(ma->count != 0 && pa->count != 0 &&
+					(u32)ma->count + pa->count <= 0xffff &&
+					ma->from_i == pa->from_i && ma->to_i == pa->to_i &&
+					ma->from_list == pa->from_list &&
+					ma->to_list == pa->to_list &&
+					ma->from_inv == pa->from_inv &&
+					ma->to_inv == pa->to_inv)
+			{
+				pa->count += ma->count;
+				delete a;
+				continue;
+			}
+		}
+		actions[++last] = a;
+	}
+	actions.resize(last + 1);
+}
+
 /*
 	IMoveAction
 */
@@ -163,6 +276,37 @@ IMoveAction::IMoveAction(std::istream &is)
 
 	std::getline(is, ts, ' ');
 	to_i = stoi(ts);
+
+	// Names from the network are not interned, names no list has
+	// ever had get 0 and are looked up (and not found) by name
+	from_list_id = getInventoryListNameId(from_list, false);
+	to_list_id = getInventoryListNameId(to_list, false);
+}
+
+void IMoveAction::serializeBinary(std::ostream &os) const
+{
+	writeU8(os, IACTION_MOVE);
+	writeU16(os, count);
+	from_inv.serializeBinary(os);
+	os<<serializeString(from_list);
+	writeS16(os, from_i);
+	to_inv.serializeBinary(os);
+	os<<serializeString(to_list);
+	writeS16(os, to_i);
+}
+
+void IMoveAction::deSerializeBinary(std::istream &is)
+{
+	count = readU16(is);
+	from_inv.deSerializeBinary(is);
+	from_list = deSerializeString(is);
+	from_i = readS16(is);
+	to_inv.deSerializeBinary(is);
+	to_list = deSerializeString(is);
+	to_i = readS16(is);
+
+	from_list_id = getInventoryListNameId(from_list, false);
+	to_list_id = getInventoryListNameId(to_list, false);
 }
 
 void IMoveAction::apply(InventoryManager *mgr, ServerActiveObject *player, IGameDef *gamedef)
@@ -183,8 +327,10 @@ void IMoveAction::apply(InventoryManager *mgr, ServerActiveObject *player, IGame
 		return;
 	}
 
-	InventoryList *list_from = inv_from->getList(from_list);
-	InventoryList *list_to = inv_to->getList(to_list);
+	InventoryList *list_from = from_list_id ?
+			inv_from->getListById(from_list_id) : inv_from->getList(from_list);
+	InventoryList *list_to = to_list_id ?
+			inv_to->getListById(to_list_id) : inv_to->getList(to_list);
 
 	/*
 		If a list doesn't exist or the source item doesn't exist
@@ -507,6 +653,23 @@ IDropAction::IDropAction(std::istream &is)
 	from_i = stoi(ts);
 }
 
+void IDropAction::serializeBinary(std::ostream &os) const
+{
+	writeU8(os, IACTION_DROP);
+	writeU16(os, count);
+	from_inv.serializeBinary(os);
+	os<<serializeString(from_list);
+	writeS16(os, from_i);
+}
+
+void IDropAction::deSerializeBinary(std::istream &is)
+{
+	count = readU16(is);
+	from_inv.deSerializeBinary(is);
+	from_list = deSerializeString(is);
+	from_i = readS16(is);
+}
+
 void IDropAction::apply(InventoryManager *mgr, ServerActiveObject *player, IGameDef *gamedef)
 {
 	Inventory *inv_from = mgr->getInventory(from_inv);
@@ -691,6 +854,19 @@ ICraftAction::ICraftAction(std::istream &is)
 	craft_inv.deSerialize(ts);
 }
 
+void ICraftAction::serializeBinary(std::ostream &os) const
+{
+	writeU8(os, IACTION_CRAFT);
+	writeU16(os, count);
+	craft_inv.serializeBinary(os);
+}
+
+void ICraftAction::deSerializeBinary(std::istream &is)
+{
+	count = readU16(is);
+	craft_inv.deSerializeBinary(is);
+}
+
 void ICraftAction::apply(InventoryManager *mgr, ServerActiveObject *player, IGameDef *gamedef)
 {
 	Inventory *inv_craft = mgr->getInventory(craft_inv);
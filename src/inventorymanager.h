@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "inventory.h"
 #include <iostream>
 #include <string>
+#include <vector>
 class ServerActiveObject;
 
 struct InventoryLocation
@@ -99,6 +100,9 @@ struct InventoryLocation
 	void serialize(std::ostream &os) const;
 	void deSerialize(std::istream &is);
 	void deSerialize(std::string s);
+	// For TOSERVER_INVENTORY_ACTIONS
+	void serializeBinary(std::ostream &os) const;
+	void deSerializeBinary(std::istream &is);
 };
 
 struct InventoryAction;
@@ -124,9 +128,20 @@ class InventoryManager
 struct InventoryAction
 {
 	static InventoryAction * deSerialize(std::istream &is);
+	// Returns NULL for unknown types, throws SerializationError if the
+	// data is cut short
+	static InventoryAction * deSerializeBinary(std::istream &is);
+	/*
+		Merges runs of moves of some items between the same two slots
+		into one move, so that their checks and callbacks run once.
+		Deletes the merged actions.
+	*/
+	static void coalesce(std::vector<InventoryAction*> &actions);
 	
 	virtual u16 getType() const = 0;
 	virtual void serialize(std::ostream &os) const = 0;
+	// The type as u8, then the fields; for TOSERVER_INVENTORY_ACTIONS
+	virtual void serializeBinary(std::ostream &os) const = 0;
 	virtual void apply(InventoryManager *mgr, ServerActiveObject *player,
 			IGameDef *gamedef) = 0;
 	virtual void clientApply(InventoryManager *mgr, IGameDef *gamedef) = 0;
@@ -143,12 +158,18 @@ struct IMoveAction : public InventoryAction
 	InventoryLocation to_inv;
 	std::string to_list;
 	s16 to_i;
+	// getInventoryListNameId() of from_list and to_list, set when
+	// deserializing; 0 to look the lists up by name
+	u32 from_list_id;
+	u32 to_list_id;
 	
 	IMoveAction()
 	{
 		count = 0;
 		from_i = -1;
 		to_i = -1;
+		from_list_id = 0;
+		to_list_id = 0;
 	}
 	
 	IMoveAction(std::istream &is);
@@ -170,6 +191,9 @@ struct IMoveAction : public InventoryAction
 		os<<to_i;
 	}
 
+	void serializeBinary(std::ostream &os) const;
+	void deSerializeBinary(std::istream &is);
+
 	void apply(InventoryManager *mgr, ServerActiveObject *player, IGameDef *gamedef);
 
 	void clientApply(InventoryManager *mgr, IGameDef *gamedef);
@@ -205,6 +229,9 @@ struct IDropAction : public InventoryAction
 		os<<from_i;
 	}
 
+	void serializeBinary(std::ostream &os) const;
+	void deSerializeBinary(std::istream &is);
+
 	void apply(InventoryManager *mgr, ServerActiveObject *player, IGameDef *gamedef);
 
 	void clientApply(InventoryManager *mgr, IGameDef *gamedef);
@@ -235,6 +262,9 @@ struct ICraftAction : public InventoryAction
 		os<<craft_inv.dump()<<" ";
 	}
 
+	void serializeBinary(std::ostream &os) const;
+	void deSerializeBinary(std::istream &is);
+
 	void apply(InventoryManager *mgr, ServerActiveObject *player, IGameDef *gamedef);
 
 	void clientApply(InventoryManager *mgr, IGameDef *gamedef);
@@ -50,6 +50,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irrlichttypes_extrabloated.h"
 #include "debug.h"
 #include "test.h"
+#include "benchmark.h"
 #include "clouds.h"
 #include "server.h"
 #include "constants.h"
@@ -79,8 +80,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "serverlist.h"
 #include "guiEngine.h"
 #include "mapsector.h"
+#include "mapblock.h"
+#include "inventory.h"
+#include "servertrace.h"
+#include "strfnd.h"
 
 #include "database-sqlite3.h"
+#include "database-sharded.h"
 #ifdef USE_LEVELDB
 #include "database-leveldb.h"
 #endif
@@ -722,6 +728,29 @@ void SpeedTests()
 		infostream<<"Done. "<<dtime<<"ms, "
 				<<per_ms<<"/ms"<<std::endl;
 	}
+
+	{
+		TimeTaker timer("Testing item string parse/print speed");
+
+		IWritableItemDefManager *idef = createItemDefManager();
+		const char *itemstrings[] = {
+			"default:dirt 99", "default:pick_steel 1 12000",
+			"default:sign_wall 1 0 hello", "default:cobble",
+		};
+		const u32 ii = 200000;
+		u32 total_count = 0;
+		ItemStack item;
+		for(u32 i=0; i<ii; i++){
+			item.deSerialize(std::string(itemstrings[i % 4]), idef);
+			tempstring = item.getItemString();
+			total_count += item.count;
+		}
+		delete idef;
+
+		u32 dtime = timer.stop();
+		infostream<<"Done. "<<dtime<<"ms for "<<ii<<" item strings"
+				<<" (count sum "<<total_count<<")"<<std::endl;
+	}
 }
 
 static void print_worldspecs(const std::vector<WorldSpec> &worldspecs,
@@ -768,6 +797,12 @@ int main(int argc, char *argv[])
 			_("Disable unit tests"))));
 	allowed_options.insert(std::make_pair("enable-unittests", ValueSpec(VALUETYPE_FLAG,
 			_("Enable unit tests"))));
+	allowed_options.insert(std::make_pair("benchmark", ValueSpec(VALUETYPE_FLAG,
+			_("Run benchmarks, print the results as JSON and exit"))));
+	allowed_options.insert(std::make_pair("benchmark-scale", ValueSpec(VALUETYPE_STRING,
+			_("Multiply benchmark iteration counts by this (default 1)"))));
+	allowed_options.insert(std::make_pair("benchmark-filter", ValueSpec(VALUETYPE_STRING,
+			_("Only run benchmarks whose names start with this"))));
 	allowed_options.insert(std::make_pair("map-dir", ValueSpec(VALUETYPE_STRING,
 			_("Same as --world (deprecated)"))));
 	allowed_options.insert(std::make_pair("world", ValueSpec(VALUETYPE_STRING,
@@ -786,6 +821,14 @@ int main(int argc, char *argv[])
 			_("Set gameid (\"--gameid list\" prints available ones)"))));
 	allowed_options.insert(std::make_pair("migrate", ValueSpec(VALUETYPE_STRING,
 			_("Migrate from current map backend to another (Only works when using minetestserver or with --server)"))));
+	allowed_options.insert(std::make_pair("extra-worlds", ValueSpec(VALUETYPE_STRING,
+			_("Host more existing worlds of the same game in the same process, as \"port:path;port:path\"; all of them share one set of settings (Only works when using minetestserver or with --server)"))));
+	allowed_options.insert(std::make_pair("record-trace", ValueSpec(VALUETYPE_STRING,
+			_("Record everything clients send, except passwords, to a trace file (Only works when using minetestserver or with --server)"))));
+	allowed_options.insert(std::make_pair("replay-trace", ValueSpec(VALUETYPE_STRING,
+			_("Replay a recorded trace on a fresh copy of the world in <user path>/replay and print statistics (Only works when using minetestserver or with --server)"))));
+	allowed_options.insert(std::make_pair("replay-speed", ValueSpec(VALUETYPE_STRING,
+			_("Speed of --replay-trace relative to real time, 0 = as fast as possible"))));
 #ifndef SERVER
 	allowed_options.insert(std::make_pair("videomodes", ValueSpec(VALUETYPE_FLAG,
 			_("Show available video modes"))));
@@ -1002,6 +1045,22 @@ int main(int argc, char *argv[])
 	{
 		run_tests();
 	}
+
+	/*
+		Run benchmarks
+	*/
+
+	if(cmd_args.getFlag("benchmark"))
+	{
+		float scale = 1.0;
+		if(cmd_args.exists("benchmark-scale"))
+			scale = stof(cmd_args.get("benchmark-scale"));
+		std::string filter;
+		if(cmd_args.exists("benchmark-filter"))
+			filter = cmd_args.get("benchmark-filter");
+		run_benchmarks(std::cout, scale, filter);
+		return 0;
+	}
 #ifdef _MSC_VER
 	init_gettext((porting::path_share + DIR_DELIM + "locale").c_str(),g_settings->get("language"),argc,argv);
 #else
@@ -1206,6 +1265,23 @@ int main(int argc, char *argv[])
 		}
 		verbosestream<<_("Using gameid")<<" ["<<gamespec.id<<"]"<<std::endl;
 
+		// Replaying a trace changes the world, so it is done on a fresh
+		// copy every time
+		if (cmd_args.exists("replay-trace")) {
+			if (!getWorldExists(world_path)) {
+				errorstream << "Cannot replay a trace on the nonexistent world ["
+						<< world_path << "]" << std::endl;
+				return 1;
+			}
+			std::string copy_path = porting::path_user + DIR_DELIM + "replay"
+					+ DIR_DELIM + "world";
+			if (!ServerTraceReplayer::copyWorld(world_path, copy_path))
+				return 1;
+			actionstream << "Replaying on a copy of [" << world_path
+					<< "] at [" << copy_path << "]" << std::endl;
+			world_path = copy_path;
+		}
+
 		// Create server
 		Server server(world_path, gamespec, false);
 
@@ -1220,7 +1296,7 @@ int main(int argc, char *argv[])
 			}
 			if (!world_mt.exists("backend")) {
 				errorstream << "Please specify your current backend in world.mt file:"
-					<< std::endl << "	backend = {sqlite3|leveldb|dummy}" << std::endl;
+					<< std::endl << "	backend = {sqlite3|leveldb|sharded|dummy}" << std::endl;
 				return 1;
 			}
 			std::string backend = world_mt.get("backend");
@@ -1235,6 +1311,15 @@ int main(int argc, char *argv[])
 			else if (migrate_to == "leveldb")
 				new_db = new Database_LevelDB(&(ServerMap&)server.getMap(), world_path);
 			#endif
+			else if (migrate_to == "sharded") {
+				// Shard layout can be preset in world.mt
+				if (!world_mt.exists("shard_backend"))
+					world_mt.set("shard_backend", "sqlite3");
+				if (!world_mt.exists("shards"))
+					world_mt.set("shards", "4");
+				new_db = new Database_Sharded(&(ServerMap&)server.getMap(), world_path,
+					world_mt.get("shard_backend"), world_mt.getU16("shards"));
+			}
 			else {
 				errorstream << "Migration to " << migrate_to << " is not supported" << std::endl;
 				return 1;
@@ -1256,6 +1341,7 @@ int main(int argc, char *argv[])
 						<< (100.0 * count / blocks.size()) << "% completed" << std::endl;
 			}
 			new_db->endSave();
+			delete new_db;
 
 			actionstream << "Successfully migrated " << count << " blocks" << std::endl;
 			world_mt.set("backend", migrate_to);
@@ -1267,10 +1353,121 @@ int main(int argc, char *argv[])
 			return 0;
 		}
 
+		// Replay a trace instead of waiting for clients
+		if (cmd_args.exists("replay-trace")) {
+			ServerTraceReplayer replayer(cmd_args.get("replay-trace"), port);
+			if (!replayer.open())
+				return 1;
+			mysrand(replayer.getRandSeed());
+
+			float speed = 1.0;
+			if (cmd_args.exists("replay-speed"))
+				speed = mystof(cmd_args.get("replay-speed"));
+
+			server.start(port);
+
+			float steplen = g_settings->getFloat("dedicated_server_step");
+			u32 time_start = porting::getTimeMs();
+			bool more = true;
+			while (more && !kill && !server.getShutdownRequested()) {
+				if (speed > 0)
+					sleep_ms((int)(steplen * 1000.0 / speed));
+				server.step(steplen);
+				more = replayer.step(steplen);
+				// Let the server keep up when not running in real time
+				if (speed <= 0) {
+					while (server.getPendingStepDtime() >= steplen && !kill)
+						sleep_ms(1);
+				}
+			}
+
+			dstream << "Replay took " << (porting::getTimeMs() - time_start)
+					<< "ms" << std::endl;
+			replayer.printReport(dstream);
+			dstream << "Profiler:" << std::endl;
+			g_profiler->print(dstream);
+			return 0;
+		}
+
+		if (cmd_args.exists("record-trace")) {
+			u32 rand_seed = time(0);
+			mysrand(rand_seed);
+			if (!server.startTraceRecording(cmd_args.get("record-trace"), rand_seed))
+				return 1;
+		}
+
+		// Additional worlds hosted by this process.  They share g_settings
+		// with the main world, so they have to run the same game.
+		std::vector<std::pair<u16, std::string> > extra_worlds;
+		if (cmd_args.exists("extra-worlds")) {
+			Strfnd f(cmd_args.get("extra-worlds"));
+			while (!f.atend()) {
+				std::string extra_port_s = trim(f.next(":"));
+				std::string extra_path = trim(f.next(";"));
+				if (extra_port_s == "" && extra_path == "")
+					continue;
+				s32 extra_port = 0;
+				if (extra_port_s.find_first_not_of("0123456789") == std::string::npos
+						&& extra_port_s.size() <= 5)
+					extra_port = stoi(extra_port_s);
+				if (extra_port < 1 || extra_port > 65535 || extra_port == port) {
+					errorstream << "Invalid port [" << extra_port_s
+							<< "] for extra world [" << extra_path << "]" << std::endl;
+					return 1;
+				}
+				for (u32 i = 0; i < extra_worlds.size(); i++) {
+					if (extra_worlds[i].first == extra_port) {
+						errorstream << "Port " << extra_port
+								<< " is used by more than one extra world" << std::endl;
+						return 1;
+					}
+				}
+				if (extra_path == "" || !getWorldExists(extra_path)) {
+					errorstream << "Extra world [" << extra_path
+							<< "] does not exist" << std::endl;
+					return 1;
+				}
+				SubgameSpec extra_gamespec = findWorldSubgame(extra_path);
+				if (!extra_gamespec.isValid()) {
+					errorstream << "Subgame [" << extra_gamespec.id
+							<< "] of world [" << extra_path
+							<< "] could not be found." << std::endl;
+					return 1;
+				}
+				if (extra_gamespec.id != gamespec.id) {
+					errorstream << "Extra world [" << extra_path << "] uses game ["
+							<< extra_gamespec.id << "], but the main world uses ["
+							<< gamespec.id << "]; all worlds of one process share "
+							<< "their settings and must run the same game" << std::endl;
+					return 1;
+				}
+				extra_worlds.push_back(std::make_pair((u16)extra_port, extra_path));
+			}
+		}
+
+		std::vector<Server*> servers;
+		servers.push_back(&server);
+		for (u32 i = 0; i < extra_worlds.size(); i++) {
+			u64 rss_before = porting::getResidentMemory();
+			Server *extra = new Server(extra_worlds[i].second, gamespec, false);
+			extra->start(extra_worlds[i].first);
+			servers.push_back(extra);
+			u64 rss_after = porting::getResidentMemory();
+			actionstream << "Hosting extra world [" << extra_worlds[i].second
+					<< "] on port " << extra_worlds[i].first;
+			if (rss_after > rss_before)
+				actionstream << ", resident memory grew by "
+						<< (rss_after - rss_before) / 1024 << " KiB";
+			actionstream << std::endl;
+		}
+
 		server.start(port);
 		
 		// Run server
-		dedicated_server_loop(server, kill);
+		dedicated_server_loop(servers, kill);
+
+		for (u32 i = 1; i < servers.size(); i++)
+			delete servers[i];
 
 		return 0;
 	}
@@ -43,6 +43,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "database.h"
 #include "database-dummy.h"
 #include "database-sqlite3.h"
+#include "database-sharded.h"
 #if USE_LEVELDB
 #include "database-leveldb.h"
 #endif
@@ -2460,6 +2461,11 @@ ServerMap::ServerMap(std::string savedir, IGameDef *gamedef, EmergeManager *emer
 		else if (backend == "leveldb")
 			dbase = new Database_LevelDB(this, savedir);
 		#endif
+		else if (backend == "sharded")
+			dbase = new Database_Sharded(this, savedir,
+				conf.exists("shard_backend") ?
+					conf.get("shard_backend") : "sqlite3",
+				conf.exists("shards") ? conf.getU16("shards") : 4);
 		else
 			throw BaseException("Unknown map backend");
 	}
@@ -2818,6 +2824,17 @@ MapBlock* ServerMap::finishBlockMake(BlockMakeData *data,
 		block->setGenerated(true);
 	}
 
+	/*
+		Drop decorations queued for chunks that are already generated.
+		Anything queued for this chunk after its mapgen took the queue, or
+		for the chunk above if that exists, would never be placed.
+	*/
+	m_emerge->dropDecoCutoffs(blockpos_min * MAP_BLOCKSIZE);
+	v3s16 blockpos_above(blockpos_min.X, blockpos_max.Y + 1, blockpos_min.Z);
+	MapBlock *block_above = getBlockNoCreateNoEx(blockpos_above);
+	if (block_above && block_above->isGenerated())
+		m_emerge->dropDecoCutoffs(blockpos_above * MAP_BLOCKSIZE);
+
 	/*
 		Save changed parts of map
 		NOTE: Will be saved later.
@@ -3709,6 +3726,10 @@ void ServerMap::endSave() {
 	dbase->endSave();
 }
 
+bool ServerMap::startBackup(const std::string &target_dir) {
+	return dbase->startBackup(target_dir);
+}
+
 void ServerMap::saveBlock(MapBlock *block)
 {
   dbase->saveBlock(block);
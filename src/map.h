@@ -64,6 +64,8 @@ enum MapEditEventType{
 	// Node metadata of block changed (not knowing which node exactly)
 	// p stores block coordinate
 	MEET_BLOCK_NODE_METADATA_CHANGED,
+	// Node metadata changed, p stores node coordinate
+	MEET_NODEMETA_CHANGED,
 	// Anything else (modified_blocks are set unsent)
 	MEET_OTHER
 };
@@ -99,6 +101,8 @@ struct MapEditEvent
 			return VoxelArea(p);
 		case MEET_REMOVENODE:
 			return VoxelArea(p);
+		case MEET_NODEMETA_CHANGED:
+			return VoxelArea(p);
 		case MEET_BLOCK_NODE_METADATA_CHANGED:
 		{
 			v3s16 np1 = p*MAP_BLOCKSIZE;
@@ -435,6 +439,10 @@ class ServerMap : public Map
 	void beginSave();
 	void endSave();
 
+	// Copy the saved blocks into a new database in target_dir;
+	// see Database::startBackup()
+	bool startBackup(const std::string &target_dir);
+
 	void save(ModifiedState save_level);
 	void listAllLoadableBlocks(std::list<v3s16> &dst);
 	void listAllLoadedBlocks(std::list<v3s16> &dst);
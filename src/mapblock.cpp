@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapblock.h"
 
 #include <sstream>
+#include <string.h> // memset
 #include "map.h"
 #include "light.h"
 #include "nodedef.h"
@@ -35,9 +36,110 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #endif
 #include "util/string.h"
 #include "util/serialize.h"
+#include "jthread/jmutexautolock.h"
 
 #define PP(x) "("<<(x).X<<","<<(x).Y<<","<<(x).Z<<")"
 
+/*
+	MapBlockPool
+*/
+
+MapBlockPool g_mapblock_pool;
+
+MapBlockPool::MapBlockPool()
+{
+	m_mutex.Init();
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+MapBlockPool::~MapBlockPool()
+{
+	clear();
+}
+
+MapNode *MapBlockPool::allocNodes()
+{
+	{
+		JMutexAutoLock lock(m_mutex);
+		if(!m_free_nodes.empty())
+		{
+			MapNode *nodes = m_free_nodes.back();
+			m_free_nodes.pop_back();
+			m_stats.nodes_reused++;
+			m_stats.nodes_free--;
+			return nodes;
+		}
+		m_stats.nodes_allocated++;
+	}
+	return new MapNode[MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE];
+}
+
+void MapBlockPool::freeNodes(MapNode *nodes)
+{
+	{
+		JMutexAutoLock lock(m_mutex);
+		if(m_free_nodes.size() < MAPBLOCK_POOL_MAX_FREE)
+		{
+			m_free_nodes.push_back(nodes);
+			m_stats.nodes_free++;
+			return;
+		}
+	}
+	delete[] nodes;
+}
+
+void *MapBlockPool::allocBlock()
+{
+	{
+		JMutexAutoLock lock(m_mutex);
+		if(!m_free_blocks.empty())
+		{
+			void *block = m_free_blocks.back();
+			m_free_blocks.pop_back();
+			m_stats.blocks_reused++;
+			m_stats.blocks_free--;
+			return block;
+		}
+		m_stats.blocks_allocated++;
+	}
+	return ::operator new(sizeof(MapBlock));
+}
+
+void MapBlockPool::freeBlock(void *block)
+{
+	{
+		JMutexAutoLock lock(m_mutex);
+		if(m_free_blocks.size() < MAPBLOCK_POOL_MAX_FREE)
+		{
+			m_free_blocks.push_back(block);
+			m_stats.blocks_free++;
+			return;
+		}
+	}
+	::operator delete(block);
+}
+
+void MapBlockPool::clear()
+{
+	JMutexAutoLock lock(m_mutex);
+	for(std::vector<MapNode*>::iterator i = m_free_nodes.begin();
+			i != m_free_nodes.end(); ++i)
+		delete[] *i;
+	for(std::vector<void*>::iterator i = m_free_blocks.begin();
+			i != m_free_blocks.end(); ++i)
+		::operator delete(*i);
+	m_free_nodes.clear();
+	m_free_blocks.clear();
+	m_stats.nodes_free = 0;
+	m_stats.blocks_free = 0;
+}
+
+MapBlockPoolStats MapBlockPool::getStats()
+{
+	JMutexAutoLock lock(m_mutex);
+	return m_stats;
+}
+
 /*
 	MapBlock
 */
@@ -88,7 +190,26 @@ MapBlock::~MapBlock()
 #endif
 
 	if(data)
-		delete[] data;
+		g_mapblock_pool.freeNodes(data);
+}
+
+void *MapBlock::operator new(size_t size)
+{
+	// Derived classes don't fit in the pool
+	if(size != sizeof(MapBlock))
+		return ::operator new(size);
+	return g_mapblock_pool.allocBlock();
+}
+
+void MapBlock::operator delete(void *p, size_t size)
+{
+	if(p == NULL)
+		return;
+	// Only what came from the pool goes back to it
+	if(size != sizeof(MapBlock))
+		::operator delete(p);
+	else
+		g_mapblock_pool.freeBlock(p);
 }
 
 bool MapBlock::isValidPositionParent(v3s16 p)
@@ -609,7 +730,7 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk)
 		Node metadata
 	*/
 	std::ostringstream oss(std::ios_base::binary);
-	m_node_metadata.serialize(oss);
+	m_node_metadata.serialize(oss, disk);
 	compressZlib(oss.str(), os);
 
 	/*
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define MAPBLOCK_HEADER
 
 #include <set>
+#include <vector>
 #include "debug.h"
 #include "irr_v3d.h"
 #include "mapnode.h"
@@ -31,6 +32,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "nodetimer.h"
 #include "modifiedstate.h"
 #include "util/numeric.h" // getContainerPos
+#include "jthread/jmutex.h"
 
 class Map;
 class NodeMetadataList;
@@ -97,6 +99,51 @@ class NodeContainer
 };
 #endif
 
+/*
+	Keeps the node arrays and the memory of MapBlocks that are deleted,
+	and hands them out again when new blocks are created.  Loading and
+	unloading blocks then doesn't churn the heap.  Thread safe.
+*/
+
+// Maximum number of unused node arrays and blocks kept around
+#define MAPBLOCK_POOL_MAX_FREE 1024
+
+struct MapBlockPoolStats
+{
+	u32 nodes_allocated;
+	u32 nodes_reused;
+	u32 nodes_free;
+	u32 blocks_allocated;
+	u32 blocks_reused;
+	u32 blocks_free;
+};
+
+class MapBlockPool
+{
+public:
+	MapBlockPool();
+	~MapBlockPool();
+
+	// The returned array is not initialized
+	MapNode *allocNodes();
+	void freeNodes(MapNode *nodes);
+
+	void *allocBlock();
+	void freeBlock(void *block);
+
+	// Frees all unused memory
+	void clear();
+	MapBlockPoolStats getStats();
+
+private:
+	JMutex m_mutex;
+	std::vector<MapNode*> m_free_nodes;
+	std::vector<void*> m_free_blocks;
+	MapBlockPoolStats m_stats;
+};
+
+extern MapBlockPool g_mapblock_pool;
+
 /*
 	MapBlock itself
 */
@@ -106,6 +153,10 @@ class MapBlock /*: public NodeContainer*/
 public:
 	MapBlock(Map *parent, v3s16 pos, IGameDef *gamedef, bool dummy=false);
 	~MapBlock();
+
+	// Blocks are allocated from g_mapblock_pool
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
 	
 	/*virtual u16 nodeContainerId() const
 	{
@@ -120,9 +171,9 @@ class MapBlock /*: public NodeContainer*/
 	void reallocate()
 	{
 		if(data != NULL)
-			delete[] data;
+			g_mapblock_pool.freeNodes(data);
 		u32 l = MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE;
-		data = new MapNode[l];
+		data = g_mapblock_pool.allocNodes();
 		for(u32 i=0; i<l; i++){
 			//data[i] = MapNode();
 			data[i] = MapNode(CONTENT_IGNORE);
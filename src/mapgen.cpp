@@ -38,6 +38,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "serialization.h"
 #include "util/serialize.h"
 #include "filesys.h"
+#include "emerge.h"
 
 FlagDesc flagdesc_mapgen[] = {
 	{"trees",          MG_TREES},
@@ -231,6 +232,7 @@ Decoration::Decoration() {
 	np         = NULL;
 	fill_ratio = 0;
 	sidelen    = 1;
+	memset(biome_mask, 0, sizeof(biome_mask));
 }
 
 
@@ -247,19 +249,20 @@ void Decoration::resolveNodeNames(INodeDefManager *ndef) {
 }
 
 
-void Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax) {
+void Decoration::resolveBiomes() {
+	memset(biome_mask, 0, sizeof(biome_mask));
+	for (std::set<u8>::iterator it = biomes.begin(); it != biomes.end(); ++it)
+		biome_mask[*it] = true;
+}
+
+
+void Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+		std::vector<v3s16> *cutoffs) {
 	PseudoRandom ps(blockseed + 53);
 	int carea_size = nmax.X - nmin.X + 1;
-
-	// Divide area into parts
-	if (carea_size % sidelen) {
-		errorstream << "Decoration::placeDeco: chunk size is not divisible by "
-			"sidelen; setting sidelen to " << carea_size << std::endl;
-		sidelen = carea_size;
-	}
-	
 	s16 divlen = carea_size / sidelen;
 	int area = sidelen * sidelen;
+	bool check_biome = mg->biomemap && biomes.size();
 
 	for (s16 z0 = 0; z0 < divlen; z0++)
 	for (s16 x0 = 0; x0 < divlen; x0++) {
@@ -295,26 +298,15 @@ void Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax) {
 			if (y < nmin.Y || y > nmax.Y)
 				continue;
 
+			if (check_biome && !biome_mask[mg->biomemap[mapindex]])
+				continue;
+
 			int height = getHeight();
-			int max_y = nmax.Y;// + MAP_BLOCKSIZE - 1;
+			int max_y = nmax.Y;
 			if (y + 1 + height > max_y) {
+				if (cutoffs)
+					cutoffs->push_back(v3s16(x, y, z));
 				continue;
-#if 0
-				printf("Decoration at (%d %d %d) cut off\n", x, y, z);
-				//add to queue
-				JMutexAutoLock cutofflock(cutoff_mutex);
-				cutoffs.push_back(CutoffData(x, y, z, height));
-#endif
-			}
-
-			if (mg->biomemap) {
-				std::set<u8>::iterator iter;
-				
-				if (biomes.size()) {
-					iter = biomes.find(mg->biomemap[mapindex]);
-					if (iter == biomes.end())
-						continue;
-				}
 			}
 
 			generate(mg, &ps, max_y, v3s16(x, y, z));
@@ -323,59 +315,6 @@ void Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax) {
 }
 
 
-#if 0
-void Decoration::placeCutoffs(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax) {
-	PseudoRandom pr(blockseed + 53);
-	std::vector<CutoffData> handled_cutoffs;
-	
-	// Copy over the cutoffs we're interested in so we don't needlessly hold a lock
-	{
-		JMutexAutoLock cutofflock(cutoff_mutex);
-		for (std::list<CutoffData>::iterator i = cutoffs.begin();
-			i != cutoffs.end(); ++i) {
-			CutoffData cutoff = *i;
-			v3s16 p    = cutoff.p;
-			s16 height = cutoff.height;
-			if (p.X < nmin.X || p.X > nmax.X ||
-				p.Z < nmin.Z || p.Z > nmax.Z)
-				continue;
-			if (p.Y + height < nmin.Y || p.Y > nmax.Y)
-				continue;
-			
-			handled_cutoffs.push_back(cutoff);
-		}
-	}
-	
-	// Generate the cutoffs
-	for (size_t i = 0; i != handled_cutoffs.size(); i++) {
-		v3s16 p    = handled_cutoffs[i].p;
-		s16 height = handled_cutoffs[i].height;
-		
-		if (p.Y + height > nmax.Y) {
-			//printf("Decoration at (%d %d %d) cut off again!\n", p.X, p.Y, p.Z);
-			cuttoffs.push_back(v3s16(p.X, p.Y, p.Z));
-		}
-		
-		generate(mg, &pr, nmax.Y, nmin.Y - p.Y, v3s16(p.X, nmin.Y, p.Z));
-	}
-	
-	// Remove cutoffs that were handled from the cutoff list
-	{
-		JMutexAutoLock cutofflock(cutoff_mutex);
-		for (std::list<CutoffData>::iterator i = cutoffs.begin();
-			i != cutoffs.end(); ++i) {
-			
-			for (size_t j = 0; j != handled_cutoffs.size(); j++) {
-				CutoffData coff = *i;
-				if (coff.p == handled_cutoffs[j].p)
-					i = cutoffs.erase(i);
-			}
-		}
-	}	
-}
-#endif
-
-
 ///////////////////////////////////////////////////////////////////////////////
 
 
@@ -542,6 +481,9 @@ void DecoSchematic::generate(Mapgen *mg, PseudoRandom *pr, s16 max_y, v3s16 p) {
 		p.Y -= (size.Y + 1) / 2;
 	if (flags & DECO_PLACE_CENTER_Z)
 		p.Z -= (size.Z + 1) / 2;
+	
+	if (!vm->m_area.contains(p))
+		return;
 		
 	u32 vi = vm->m_area.index(p);
 	if (vm->m_data[vi].getContent() != c_place_on &&
@@ -862,6 +804,88 @@ Mapgen::Mapgen() {
 }
 
 
+void Mapgen::placeDecorations(EmergeManager *emerge, u32 blockseed,
+							v3s16 nmin, v3s16 nmax) {
+	std::vector<Decoration *> &decos = emerge->decorations;
+	size_t ndecos = decos.size();
+	int carea_size = nmax.X - nmin.X + 1;
+
+	// Without a biome map every decoration is placed everywhere; otherwise
+	// only those of the biomes present in the chunk are tried at all
+	deco_candidate.assign(ndecos, biomemap == NULL);
+	if (biomemap) {
+		bool biome_present[256];
+		memset(biome_present, 0, sizeof(biome_present));
+		for (int i = 0; i != carea_size * carea_size; i++)
+			biome_present[biomemap[i]] = true;
+
+		for (size_t i = 0; i != emerge->decos_any_biome.size(); i++)
+			deco_candidate[emerge->decos_any_biome[i]] = true;
+
+		for (int biomeid = 0; biomeid != 256; biomeid++) {
+			if (!biome_present[biomeid])
+				continue;
+			std::vector<size_t> &bucket = emerge->decos_by_biome[biomeid];
+			for (size_t i = 0; i != bucket.size(); i++)
+				deco_candidate[bucket[i]] = true;
+		}
+	}
+
+	std::vector<v3s16> cutoffs;
+	for (size_t i = 0; i != ndecos; i++) {
+		if (!deco_candidate[i])
+			continue;
+
+		Decoration *deco = decos[i];
+
+		// Divide area into parts
+		if (carea_size % deco->sidelen) {
+			errorstream << "Decoration::placeDeco: chunk size is not divisible by "
+				"sidelen; setting sidelen to " << carea_size << std::endl;
+			deco->sidelen = carea_size;
+		}
+
+		deco->placeDeco(this, blockseed + i, nmin, nmax, &cutoffs);
+
+		if (cutoffs.size()) {
+			emerge->addDecoCutoffs(i, v3s16(nmin.X, nmax.Y + 1, nmin.Z), cutoffs);
+			cutoffs.clear();
+		}
+	}
+
+	placeDecoCutoffs(emerge, nmin, nmax);
+}
+
+
+void Mapgen::placeDecoCutoffs(EmergeManager *emerge, v3s16 nmin, v3s16 nmax) {
+	std::vector<DecoCutoff> cutoffs;
+	if (emerge->popDecoCutoffs(nmin, cutoffs))
+		placeDecoCutoffs(emerge->decorations, cutoffs, nmax);
+}
+
+
+void Mapgen::placeDecoCutoffs(std::vector<Decoration *> &decos,
+		std::vector<DecoCutoff> &cutoffs, v3s16 nmax) {
+	for (size_t i = 0; i != cutoffs.size(); i++) {
+		Decoration *deco = decos[cutoffs[i].deco_index];
+		v3s16 p = cutoffs[i].p;
+
+		// Too tall to fit even now; give up on it
+		if (p.Y + 1 + deco->getHeight() > nmax.Y)
+			continue;
+
+		// Tall ones can start below the bottom of this chunk's area
+		if (!vm->m_area.contains(p))
+			continue;
+
+		u32 pseed = (u32)seed + (u32)p.X * 73856093 +
+			(u32)p.Y * 19349663 + (u32)p.Z * 83492791;
+		PseudoRandom ps(pseed);
+		deco->generate(this, &ps, nmax.Y, p);
+	}
+}
+
+
 // Returns Y one under area minimum if not found
 s16 Mapgen::findGroundLevelFull(v2s16 p2d) {
 	v3s16 em = vm->m_area.getExtent();
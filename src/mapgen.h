@@ -53,12 +53,17 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define DECO_PLACE_CENTER_Y 2
 #define DECO_PLACE_CENTER_Z 4
 
+// Maximum number of decorations that wait for the chunk above to be generated
+#define DECO_CUTOFF_QUEUE_MAX 16384
+
 extern FlagDesc flagdesc_mapgen[];
 extern FlagDesc flagdesc_ore[];
 extern FlagDesc flagdesc_deco_schematic[];
 
 class BiomeDefManager;
 class Biome;
+class Decoration;
+struct DecoCutoff;
 class EmergeManager;
 class MapBlock;
 class ManualMapVoxelManipulator;
@@ -100,6 +105,8 @@ class Mapgen {
 	u8 *biomemap;
 	v3s16 csize;
 
+	std::vector<bool> deco_candidate;
+
 	Mapgen();
 	virtual ~Mapgen() {}
 
@@ -112,6 +119,12 @@ class Mapgen {
 	void calcLighting(v3s16 nmin, v3s16 nmax);
 	void calcLightingOld(v3s16 nmin, v3s16 nmax);
 
+	void placeDecorations(EmergeManager *emerge, u32 blockseed,
+		v3s16 nmin, v3s16 nmax);
+	void placeDecoCutoffs(EmergeManager *emerge, v3s16 nmin, v3s16 nmax);
+	void placeDecoCutoffs(std::vector<Decoration *> &decos,
+		std::vector<DecoCutoff> &cutoffs, v3s16 nmax);
+
 	virtual void makeChunk(BlockMakeData *data) {}
 	virtual int getGroundLevelAtPoint(v2s16 p) { return 0; }
 };
@@ -192,20 +205,17 @@ enum DecorationType {
 	DECO_LSYSTEM
 };
 
-#if 0
-struct CutoffData {
-	VoxelArea a;
-	Decoration *deco;
-	//v3s16 p;
-	//v3s16 size;
-	//s16 height;
-	
-	CutoffData(s16 x, s16 y, s16 z, s16 h) {
-		p = v3s16(x, y, z);
-		height = h;
+// A decoration that didn't fit below the top of its chunk, to be placed
+// once the chunk above it is generated
+struct DecoCutoff {
+	size_t deco_index;
+	v3s16 p;
+
+	DecoCutoff(size_t deco_index, v3s16 p) {
+		this->deco_index = deco_index;
+		this->p = p;
 	}
 };
-#endif
 
 class Decoration {
 public:
@@ -219,15 +229,16 @@ class Decoration {
 	NoiseParams *np;
 	
 	std::set<u8> biomes;
-	//std::list<CutoffData> cutoffs;
-	//JMutex cutoff_mutex;
+	// biome_mask[id] is true if biome id is in biomes
+	bool biome_mask[256];
 
 	Decoration();
 	virtual ~Decoration();
 	
 	virtual void resolveNodeNames(INodeDefManager *ndef);
-	void placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
-	void placeCutoffs(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
+	void resolveBiomes();
+	void placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+		std::vector<v3s16> *cutoffs);
 	
 	virtual void generate(Mapgen *mg, PseudoRandom *pr, s16 max_y, v3s16 p) = 0;
 	virtual int getHeight() = 0;
@@ -447,10 +447,7 @@ void MapgenV6::makeChunk(BlockMakeData *data) {
 		placeTreesAndJungleGrass();
 	
 	// Generate the registered decorations
-	for (unsigned int i = 0; i != emerge->decorations.size(); i++) {
-		Decoration *deco = emerge->decorations[i];
-		deco->placeDeco(this, blockseed + i, node_min, node_max);
-	}
+	placeDecorations(emerge, blockseed, node_min, node_max);
 
 	// Generate the registered ores
 	for (unsigned int i = 0; i != emerge->ores.size(); i++) {
@@ -608,138 +605,198 @@ void MapgenV6::addMud() {
 }
 
 
+void MapgenV6::updateMudFlowFlags() {
+	// Indexed by the full content_t range so lookups need no bounds check
+	mudflow_flags.resize(0x10000);
+	for (u32 c = 0; c < 0x10000; c++) {
+		u8 f = 0;
+		if (ndef->get((content_t)c).walkable)
+			f |= MUDFLOW_WALKABLE;
+		if (c == c_dirt || c == c_dirt_with_grass)
+			f |= MUDFLOW_MUD;
+		else if (c == c_gravel)
+			f |= MUDFLOW_GRAVEL;
+		mudflow_flags[c] = f;
+	}
+}
+
+
+s16 MapgenV6::findMudTop(v2s16 p2d) {
+	v3s16 em = vm->m_area.getExtent();
+	u32 i = vm->m_area.index(p2d.X, node_max.Y, p2d.Y);
+	s16 y;
+	for (y = node_max.Y; y >= node_min.Y; y--) {
+		if (mudflow_flags[vm->m_data[i].getContent()] &
+				(MUDFLOW_MUD | MUDFLOW_GRAVEL))
+			break;
+		vm->m_area.add_y(em, i, -1);
+	}
+	return y;
+}
+
+
 void MapgenV6::flowMud(s16 &mudflow_minpos, s16 &mudflow_maxpos) {
-	// 340ms @cs=8
+	// 340ms @cs=8 before columns were started from the mud heightmap
 	TimeTaker timer1("flow mud");
 
-	// Iterate a few times
-	for(s16 k = 0; k < 3; k++) {
-		for (s16 z = mudflow_minpos; z <= mudflow_maxpos; z++)
-		for (s16 x = mudflow_minpos; x <= mudflow_maxpos; x++) {
-			// Invert coordinates every 2nd iteration
-			if (k % 2 == 0) {
-				x = mudflow_maxpos - (x - mudflow_minpos);
-				z = mudflow_maxpos - (z - mudflow_minpos);
-			}
+	if (mudflow_flags.empty())
+		updateMudFlowFlags();
 
-			// Node position in 2d
-			v2s16 p2d = v2s16(node_min.X, node_min.Z) + v2s16(x, z);
+	// Topmost mud or gravel of each column.  Mud only ever leaves the
+	// column that is being flowed and lands lower down in a neighbor, so
+	// this stays exact for every column that hasn't been flowed yet.
+	s16 mudflow_width = mudflow_maxpos - mudflow_minpos + 1;
+	mudflow_top.resize(mudflow_width * mudflow_width);
+	u32 index = 0;
+	for (s16 z = mudflow_minpos; z <= mudflow_maxpos; z++)
+	for (s16 x = mudflow_minpos; x <= mudflow_maxpos; x++, index++)
+		mudflow_top[index] = findMudTop(v2s16(node_min.X + x, node_min.Z + z));
+
+	// The old three pass loop inverted its own loop counters on every
+	// second pass, so passes 0 and 2 only ever visited the last column.
+	// That order is kept here so that existing seeds produce the same map.
+	u32 index_last = mudflow_width * mudflow_width - 1;
+	flowMudColumn(mudflow_maxpos, mudflow_maxpos, mudflow_minpos, mudflow_maxpos);
+	mudflow_top[index_last] = findMudTop(
+		v2s16(node_min.X + mudflow_maxpos, node_min.Z + mudflow_maxpos));
+
+	for (s16 z = mudflow_minpos; z <= mudflow_maxpos; z++)
+	for (s16 x = mudflow_minpos; x <= mudflow_maxpos; x++)
+		flowMudColumn(x, z, mudflow_minpos, mudflow_maxpos);
+
+	mudflow_top[index_last] = findMudTop(
+		v2s16(node_min.X + mudflow_maxpos, node_min.Z + mudflow_maxpos));
+	flowMudColumn(mudflow_maxpos, mudflow_maxpos, mudflow_minpos, mudflow_maxpos);
+}
 
-			v3s16 em = vm->m_area.getExtent();
-			u32 i = vm->m_area.index(p2d.X, node_max.Y, p2d.Y);
-			s16 y = node_max.Y;
 
-			while(y >= node_min.Y)
-			{
+void MapgenV6::flowMudColumn(s16 x, s16 z,
+		s16 mudflow_minpos, s16 mudflow_maxpos) {
+	s16 mudflow_width = mudflow_maxpos - mudflow_minpos + 1;
+	s16 y = mudflow_top[(z - mudflow_minpos) * mudflow_width + (x - mudflow_minpos)];
+	if (y < node_min.Y)
+		return;
 
-			for(;; y--)
-			{
-				MapNode *n = NULL;
-				// Find mud
-				for(; y >= node_min.Y; y--) {
-					n = &vm->m_data[i];
-					if (n->getContent() == c_dirt ||
-						n->getContent() == c_dirt_with_grass ||
-						n->getContent() == c_gravel)
-						break;
-
-					vm->m_area.add_y(em, i, -1);
-				}
+	v2s16 p2d = v2s16(node_min.X, node_min.Z) + v2s16(x, z);
+	v3s16 em = vm->m_area.getExtent();
+	u32 i = vm->m_area.index(p2d.X, y, p2d.Y);
+
+	// The old scan lost one step of its y counter for every node that it
+	// moved away, ending the column that much higher up.
+	s16 y_lost = 0;
+
+	for (;;) {
+		// Find mud
+		while (y - y_lost >= node_min.Y &&
+				!(mudflow_flags[vm->m_data[i].getContent()] &
+				(MUDFLOW_MUD | MUDFLOW_GRAVEL))) {
+			vm->m_area.add_y(em, i, -1);
+			y--;
+		}
 
-				// Stop if out of area
-				//if(vmanip.m_area.contains(i) == false)
-				if (y < node_min.Y)
-					break;
+		// Stop if out of area
+		if (y - y_lost < node_min.Y)
+			return;
 
-				if (n->getContent() == c_dirt ||
-					n->getContent() == c_dirt_with_grass)
-				{
-					// Make it exactly mud
-					n->setContent(c_dirt);
-
-					// Don't flow it if the stuff under it is not mud
-					{
-						u32 i2 = i;
-						vm->m_area.add_y(em, i2, -1);
-						// Cancel if out of area
-						if(vm->m_area.contains(i2) == false)
-							continue;
-						MapNode *n2 = &vm->m_data[i2];
-						if (n2->getContent() != c_dirt &&
-							n2->getContent() != c_dirt_with_grass)
-							continue;
-					}
-				}
+		MapNode *n = &vm->m_data[i];
+		if (mudflow_flags[n->getContent()] & MUDFLOW_MUD) {
+			// Make it exactly mud
+			n->setContent(c_dirt);
+
+			// Don't flow it if the stuff under it is not mud
+			u32 i2 = i;
+			vm->m_area.add_y(em, i2, -1);
+			if (vm->m_area.contains(i2) == false ||
+				!(mudflow_flags[vm->m_data[i2].getContent()] &
+				MUDFLOW_MUD))
+				return;
+		}
 
-				v3s16 dirs4[4] = {
-					v3s16(0,0,1), // back
-					v3s16(1,0,0), // right
-					v3s16(0,0,-1), // front
-					v3s16(-1,0,0), // left
-				};
-
-				// Check that upper is air or doesn't exist.
-				// Cancel dropping if upper keeps it in place
-				u32 i3 = i;
-				vm->m_area.add_y(em, i3, 1);
-				if (vm->m_area.contains(i3) == true &&
-					ndef->get(vm->m_data[i3]).walkable)
-					continue;
+		// Cancel dropping if upper keeps it in place
+		u32 i3 = i;
+		vm->m_area.add_y(em, i3, 1);
+		if (vm->m_area.contains(i3) == true &&
+			(mudflow_flags[vm->m_data[i3].getContent()] &
+			MUDFLOW_WALKABLE))
+			return;
+
+		// Anything that doesn't move here would be found again in the same
+		// state on every following step of the old scan, so the column is
+		// done as soon as a node stays in place.
+		if (!dropMud(i, y, p2d, mudflow_minpos, mudflow_maxpos))
+			return;
+
+		y_lost++;
+	}
+}
 
-				// Drop mud on side
-				for(u32 di=0; di<4; di++) {
-					v3s16 dirp = dirs4[di];
-					u32 i2 = i;
-					// Move to side
-					vm->m_area.add_p(em, i2, dirp);
-					// Fail if out of area
-					if (vm->m_area.contains(i2) == false)
-						continue;
-					// Check that side is air
-					MapNode *n2 = &vm->m_data[i2];
-					if (ndef->get(*n2).walkable)
-						continue;
-					// Check that under side is air
-					vm->m_area.add_y(em, i2, -1);
-					if (vm->m_area.contains(i2) == false)
-						continue;
-					n2 = &vm->m_data[i2];
-					if (ndef->get(*n2).walkable)
-						continue;
-					// Loop further down until not air
-					bool dropped_to_unknown = false;
-					do {
-						vm->m_area.add_y(em, i2, -1);
-						n2 = &vm->m_data[i2];
-						// if out of known area
-						if(vm->m_area.contains(i2) == false ||
-							n2->getContent() == CONTENT_IGNORE) {
-							dropped_to_unknown = true;
-							break;
-						}
-					} while (ndef->get(*n2).walkable == false);
-					// Loop one up so that we're in air
-					vm->m_area.add_y(em, i2, 1);
-					n2 = &vm->m_data[i2];
-
-					bool old_is_water = (n->getContent() == c_water_source);
-					// Move mud to new place
-					if (!dropped_to_unknown) {
-						*n2 = *n;
-						// Set old place to be air (or water)
-						if(old_is_water)
-							*n = MapNode(c_water_source);
-						else
-							*n = MapNode(CONTENT_AIR);
-					}
-
-					// Done
-					break;
-				}
-			}
-			}
+
+bool MapgenV6::dropMud(u32 i, s16 y, v2s16 p2d,
+		s16 mudflow_minpos, s16 mudflow_maxpos) {
+	const v3s16 dirs4[4] = {
+		v3s16(0,0,1), // back
+		v3s16(1,0,0), // right
+		v3s16(0,0,-1), // front
+		v3s16(-1,0,0), // left
+	};
+	v3s16 em = vm->m_area.getExtent();
+
+	for (u32 di = 0; di < 4; di++) {
+		v3s16 dirp = dirs4[di];
+		u32 i2 = i;
+		// Move to side
+		vm->m_area.add_p(em, i2, dirp);
+		// Fail if out of area
+		if (vm->m_area.contains(i2) == false)
+			continue;
+		// Check that side is air
+		if (mudflow_flags[vm->m_data[i2].getContent()] &
+				MUDFLOW_WALKABLE)
+			continue;
+		// Check that under side is air
+		vm->m_area.add_y(em, i2, -1);
+		if (vm->m_area.contains(i2) == false)
+			continue;
+		if (mudflow_flags[vm->m_data[i2].getContent()] &
+				MUDFLOW_WALKABLE)
+			continue;
+
+		// Loop further down until not air
+		s16 y2 = y - 1;
+		do {
+			vm->m_area.add_y(em, i2, -1);
+			y2--;
+			// Give up if dropped out of the known area
+			if (vm->m_area.contains(i2) == false ||
+				vm->m_data[i2].getContent() == CONTENT_IGNORE)
+				return false;
+		} while (!(mudflow_flags[vm->m_data[i2].getContent()] &
+				MUDFLOW_WALKABLE));
+		// Loop one up so that we're in air
+		vm->m_area.add_y(em, i2, 1);
+		y2++;
+
+		// Move mud to new place
+		vm->m_data[i2] = vm->m_data[i];
+		vm->m_data[i] = MapNode(CONTENT_AIR);
+
+		// Keep the mud heightmap of the receiving column up to date
+		s16 x = p2d.X + dirp.X - node_min.X;
+		s16 z = p2d.Y + dirp.Z - node_min.Z;
+		if (y2 >= node_min.Y &&
+				x >= mudflow_minpos && x <= mudflow_maxpos &&
+				z >= mudflow_minpos && z <= mudflow_maxpos) {
+			s16 mudflow_width = mudflow_maxpos - mudflow_minpos + 1;
+			s16 &top = mudflow_top[(z - mudflow_minpos) * mudflow_width +
+				(x - mudflow_minpos)];
+			if (y2 > top)
+				top = y2;
 		}
+
+		return true;
 	}
+
+	return false;
 }
 
 
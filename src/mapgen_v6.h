@@ -24,6 +24,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define AVERAGE_MUD_AMOUNT 4
 
+/////////////////// Mud flow content flags
+#define MUDFLOW_WALKABLE 0x01
+#define MUDFLOW_MUD      0x02
+#define MUDFLOW_GRAVEL   0x04
+
 enum BiomeType
 {
 	BT_NORMAL,
@@ -119,6 +124,11 @@ class MapgenV6 : public Mapgen {
 	content_t c_desert_sand;
 	content_t c_desert_stone;
 
+	// Per content id MUDFLOW_* flags, built on first use
+	std::vector<u8> mudflow_flags;
+	// Topmost mud or gravel y of each mud flow column
+	std::vector<s16> mudflow_top;
+
 	MapgenV6(int mapgenid, MapgenV6Params *params, EmergeManager *emerge);
 	~MapgenV6();
 	
@@ -151,6 +161,11 @@ class MapgenV6 : public Mapgen {
 	int generateGround();
 	void addMud();
 	void flowMud(s16 &mudflow_minpos, s16 &mudflow_maxpos);
+	void updateMudFlowFlags();
+	s16 findMudTop(v2s16 p2d);
+	void flowMudColumn(s16 x, s16 z, s16 mudflow_minpos, s16 mudflow_maxpos);
+	bool dropMud(u32 i, s16 y, v2s16 p2d,
+		s16 mudflow_minpos, s16 mudflow_maxpos);
 	void addDirtGravelBlobs();
 	void growGrass();
 	void placeTreesAndJungleGrass();
@@ -84,6 +84,9 @@ MapgenV7::MapgenV7(int mapgenid, MapgenV7Params *params, EmergeManager *emerge)
 	this->biomemap  = new u8[csize.X * csize.Z];
 	this->heightmap = new s16[csize.X * csize.Z];
 	this->ridge_heightmap = new s16[csize.X * csize.Z];
+	this->column_ymin     = new s16[csize.X * csize.Z];
+	this->column_ymax     = new s16[csize.X * csize.Z];
+	this->full_3d_noise   = false;
 
 	// Terrain noise
 	noise_terrain_base    = new Noise(&params->np_terrain_base,    seed, csize.X, csize.Z);
@@ -118,6 +121,8 @@ MapgenV7::~MapgenV7() {
 	delete noise_heat;
 	delete noise_humidity;
 	
+	delete[] column_ymax;
+	delete[] column_ymin;
 	delete[] ridge_heightmap;
 	delete[] heightmap;
 	delete[] biomemap;
@@ -211,10 +216,7 @@ void MapgenV7::makeChunk(BlockMakeData *data) {
 		dgen.generate(vm, blockseed, full_node_min, full_node_max);
 	}
 
-	for (size_t i = 0; i != emerge->decorations.size(); i++) {
-		Decoration *deco = emerge->decorations[i];
-		deco->placeDeco(this, blockseed + i, node_min, node_max);
-	}
+	placeDecorations(emerge, blockseed, node_min, node_max);
 
 	for (size_t i = 0; i != emerge->ores.size(); i++) {
 		Ore *ore = emerge->ores[i];
@@ -241,7 +243,6 @@ void MapgenV7::makeChunk(BlockMakeData *data) {
 void MapgenV7::calculateNoise() {
 	//TimeTaker t("calculateNoise", NULL, PRECISION_MICRO);
 	int x = node_min.X;
-	int y = node_min.Y;
 	int z = node_min.Z;
 	
 	noise_height_select->perlinMap2D(x, z);
@@ -261,16 +262,16 @@ void MapgenV7::calculateNoise() {
 	
 	noise_filler_depth->perlinMap2D(x, z);
 	
+	// The 3d mountain and ridge noise is computed once the terrain is
+	// known, and only up to the height where it can still change anything
+	mountain_noise_rows = 0;
 	if (flags & MGV7_MOUNTAINS) {
-		noise_mountain->perlinMap3D(x, y, z);
 		noise_mount_height->perlinMap2D(x, z);
 		noise_mount_height->transformNoiseMap();
 	}
 
-	if (flags & MGV7_RIDGES) {
-		noise_ridge->perlinMap3D(x, y, z);
+	if (flags & MGV7_RIDGES)
 		noise_ridge_uwater->perlinMap2D(x, z);
-	}
 	
 	noise_heat->perlinMap2D(x, z);
 	noise_humidity->perlinMap2D(x, z);
@@ -329,6 +330,19 @@ bool MapgenV7::getMountainTerrainAtPoint(int x, int y, int z) {
 }
 
 
+// Upper bound of the magnitude of untransformed perlin noise
+static float noiseAmplitude(NoiseParams *np) {
+	float amplitude = 0.0;
+	float g = 1.0;
+	for (int i = 0; i < np->octaves; i++) {
+		amplitude += fabs(g);
+		g *= np->persist;
+	}
+	// Leave some room for rounding errors
+	return amplitude * 1.01 + 0.01;
+}
+
+
 bool MapgenV7::getMountainTerrainFromMap(int idx_xyz, int idx_xz, int y) {
 	float mounthn = noise_mount_height->result[idx_xz];
 	float height_modifier = -((float)y / rangelim(mounthn, 80.0, 150.0));
@@ -336,6 +350,28 @@ bool MapgenV7::getMountainTerrainFromMap(int idx_xyz, int idx_xz, int y) {
 }
 
 
+// Same as getMountainTerrainFromMap() for y = node_max.Y, which might not
+// have been computed by generateMountainTerrain()
+bool MapgenV7::getMountainTerrainAtTop(s16 x, s16 z, int idx_xz) {
+	if (!(flags & MGV7_MOUNTAINS))
+		return false;
+
+	if (mountain_noise_rows < csize.Y) {
+		float mount_height = rangelim(noise_mount_height->result[idx_xz], 80.0, 150.0);
+		if ((noiseAmplitude(noise_mountain->np) - 0.6) * mount_height + 1 < node_max.Y)
+			return false;
+
+		noise_mountain->perlinMap3D(node_min.X, node_min.Y, node_min.Z);
+		mountain_noise_rows = csize.Y;
+	}
+
+	int j = (z - node_min.Z) * zstride +
+			(csize.Y - 1) * ystride +
+			(x - node_min.X);
+	return getMountainTerrainFromMap(j, idx_xz, node_max.Y);
+}
+
+
 #if 0
 void MapgenV7::carveRivers() {
 	MapNode n_air(CONTENT_AIR), n_water_source(c_water_source);
@@ -427,19 +463,58 @@ void MapgenV7::generateMountainTerrain() {
 		return;
 		
 	MapNode n_stone(c_stone);
-	u32 j = 0;
-	
+	v3s16 em = vm->m_area.getExtent();
+	float amplitude = noiseAmplitude(noise_mountain->np);
+
+	// Mountains can only turn nodes into stone, and not above the height
+	// where even the largest noise value falls below the threshold.  Find
+	// the range of each column where they can still change something, and
+	// compute the 3d noise only up to the highest of these.
+	s16 noise_ymax = node_min.Y - 1;
+	u32 index = 0;
 	for (s16 z = node_min.Z; z <= node_max.Z; z++)
-	for (s16 y = node_min.Y; y <= node_max.Y; y++) {
-		u32 vi = vm->m_area.index(node_min.X, y, z);
-		for (s16 x = node_min.X; x <= node_max.X; x++) {
-			int index = (z - node_min.Z) * csize.X + (x - node_min.X);
+	for (s16 x = node_min.X; x <= node_max.X; x++, index++) {
+		float mount_height = rangelim(noise_mount_height->result[index], 80.0, 150.0);
+		float ymax = (amplitude - 0.6) * mount_height + 1;
+		s16 y1 = (ymax < node_max.Y && !full_3d_noise) ? (s16)ymax : node_max.Y;
+
+		s16 y0 = node_min.Y;
+		u32 vi = vm->m_area.index(x, y0, z);
+		while (y0 <= y1 && vm->m_data[vi] == n_stone && !full_3d_noise) {
+			y0++;
+			vm->m_area.add_y(em, vi, 1);
+		}
+
+		column_ymin[index] = y0;
+		column_ymax[index] = y1;
+		if (y0 <= y1 && y1 > noise_ymax)
+			noise_ymax = y1;
+	}
+
+	if (noise_ymax < node_min.Y)
+		return;
+
+	int rows = noise_ymax - node_min.Y + 1;
+	noise_mountain->perlinMap3D(node_min.X, node_min.Y, node_min.Z, rows);
+	mountain_noise_rows = rows;
+
+	index = 0;
+	for (s16 z = node_min.Z; z <= node_max.Z; z++)
+	for (s16 x = node_min.X; x <= node_max.X; x++, index++) {
+		s16 y0 = column_ymin[index];
+		s16 y1 = column_ymax[index];
+		if (y0 > y1)
+			continue;
 
+		u32 vi = vm->m_area.index(x, y0, z);
+		u32 j  = ((z - node_min.Z) * rows + (y0 - node_min.Y)) * csize.X +
+				(x - node_min.X);
+		for (s16 y = y0; y <= y1; y++) {
 			if (getMountainTerrainFromMap(j, index, y))
 				vm->m_data[vi] = n_stone;
-				
-			vi++;
-			j++;
+
+			vm->m_area.add_y(em, vi, 1);
+			j += csize.X;
 		}
 	}
 }
@@ -448,28 +523,96 @@ void MapgenV7::generateMountainTerrain() {
 void MapgenV7::generateRidgeTerrain() {
 	MapNode n_water(c_water_source);
 	MapNode n_air(CONTENT_AIR);
+	v3s16 em = vm->m_area.getExtent();
+	float amplitude = noiseAmplitude(noise_ridge->np);
+	float width = 0.3; // TODO: figure out acceptable perlin noise values
+
+	// Find the range of each column where the ridge noise can carve out
+	// anything that isn't air or water already, using the largest value
+	// the noise can take.  The 3d noise is computed only up to the highest
+	// of these.
+	s16 noise_ymax = node_min.Y - 1;
 	u32 index = 0;
-	
 	for (s16 z = node_min.Z; z <= node_max.Z; z++)
-	for (s16 y = node_min.Y; y <= node_max.Y; y++) {
-		u32 vi = vm->m_area.index(node_min.X, y, z);
-		for (s16 x = node_min.X; x <= node_max.X; x++, index++, vi++) {
-			int j = (z - node_min.Z) * csize.X + (x - node_min.X);
-			
-			if (heightmap[j] < water_level - 4)
+	for (s16 x = node_min.X; x <= node_max.X; x++, index++) {
+		column_ymin[index] = node_max.Y + 1;
+		column_ymax[index] = node_min.Y - 1;
+
+		if (heightmap[index] < water_level - 4)
+			continue;
+
+		float uwatern = noise_ridge_uwater->result[index] * 2;
+		if (uwatern < -width || uwatern > width)
+			continue;
+
+		float widthn    = (noise_terrain_persist->result[index] - 0.6) / 0.1;
+		float width_mod = (width - fabs(uwatern));
+
+		if (full_3d_noise) {
+			column_ymin[index] = node_min.Y;
+			column_ymax[index] = node_max.Y;
+			continue;
+		}
+
+		u32 vi = vm->m_area.index(x, node_min.Y, z);
+		for (s16 y = node_min.Y; y <= node_max.Y; y++) {
+			MapNode &n = vm->m_data[vi];
+			vm->m_area.add_y(em, vi, 1);
+
+			// Carving this node wouldn't change anything
+			if (y >= ridge_heightmap[index] &&
+				n == ((y > water_level) ? n_air : n_water))
 				continue;
-			
-			float widthn = (noise_terrain_persist->result[j] - 0.6) / 0.1;
-			//widthn = rangelim(widthn, -0.05, 0.5);
-			
-			float width = 0.3; // TODO: figure out acceptable perlin noise values
-			float uwatern = noise_ridge_uwater->result[j] * 2;
-			if (uwatern < -width || uwatern > width)
+
+			float height_mod = (float)(y + 17) / 2.5;
+			float nridge_max = amplitude * fabs((float)y) / 7.0;
+			if (y < water_level)
+				nridge_max *= 3.0 * 0.3 * MYMAX(-widthn, 0.0);
+
+			if (nridge_max + width_mod * height_mod < 0.6 - 0.01)
 				continue;
-			
+
+			if (y < column_ymin[index])
+				column_ymin[index] = y;
+			column_ymax[index] = y;
+		}
+
+		if (column_ymax[index] > noise_ymax)
+			noise_ymax = column_ymax[index];
+	}
+
+	if (full_3d_noise)
+		noise_ymax = node_max.Y;
+
+	if (noise_ymax < node_min.Y)
+		return;
+
+	int rows = noise_ymax - node_min.Y + 1;
+	noise_ridge->perlinMap3D(node_min.X, node_min.Y, node_min.Z, rows);
+
+	index = 0;
+	for (s16 z = node_min.Z; z <= node_max.Z; z++)
+	for (s16 x = node_min.X; x <= node_max.X; x++, index++) {
+		s16 y0 = column_ymin[index];
+		s16 y1 = column_ymax[index];
+		if (y0 > y1)
+			continue;
+
+		float widthn = (noise_terrain_persist->result[index] - 0.6) / 0.1;
+		//widthn = rangelim(widthn, -0.05, 0.5);
+
+		float uwatern = noise_ridge_uwater->result[index] * 2;
+		float width_mod = (width - fabs(uwatern));
+
+		u32 vi = vm->m_area.index(x, y0, z);
+		u32 j  = ((z - node_min.Z) * rows + (y0 - node_min.Y)) * csize.X +
+				(x - node_min.X);
+		for (s16 y = y0; y <= y1; y++, j += csize.X) {
+			u32 i = vi;
+			vm->m_area.add_y(em, vi, 1);
+
 			float height_mod = (float)(y + 17) / 2.5;
-			float width_mod  = (width - fabs(uwatern));
-			float nridge = noise_ridge->result[index] * (float)y / 7.0;
+			float nridge = noise_ridge->result[j] * (float)y / 7.0;
 
 			if (y < water_level)
 				nridge = -fabs(nridge) * 3.0 * widthn * 0.3;
@@ -477,10 +620,10 @@ void MapgenV7::generateRidgeTerrain() {
 			if (nridge + width_mod * height_mod < 0.6)
 				continue;
 			
-			if (y < ridge_heightmap[j])
-				ridge_heightmap[j] = y - 1; 
+			if (y < ridge_heightmap[index])
+				ridge_heightmap[index] = y - 1; 
 
-			vm->m_data[vi] = (y > water_level) ? n_air : n_water;
+			vm->m_data[i] = (y > water_level) ? n_air : n_water;
 		}
 	}
 }
@@ -516,12 +659,8 @@ void MapgenV7::generateBiomes() {
 			// It could be the case that the elevation is equal to the chunk
 			// boundary, but the chunk above has not been generated yet
 			if (y == node_max.Y && c_above == CONTENT_IGNORE &&
-				y == heightmap[index] && c == c_stone) {
-				int j = (z - node_min.Z) * zstride +
-						(y - node_min.Y) * ystride +
-						(x - node_min.X);
-				have_air = !getMountainTerrainFromMap(j, index, y);
-			}
+				y == heightmap[index] && c == c_stone)
+				have_air = !getMountainTerrainAtTop(x, z, index);
 			
 			if (c == c_stone && have_air) {
 				content_t c_below = vm->m_data[i - em.X].getContent();
@@ -77,6 +77,14 @@ class MapgenV7 : public Mapgen {
 	v3s16 full_node_max;
 	
 	s16 *ridge_heightmap;
+	// Per column y range in which the 3d terrain noise is evaluated
+	s16 *column_ymin;
+	s16 *column_ymax;
+	// Number of rows from node_min.Y computed in noise_mountain
+	int mountain_noise_rows;
+	// Evaluate the 3d terrain noise over the whole chunk, as before the
+	// per column ranges; only for comparing against in benchmarks
+	bool full_3d_noise;
 	
 	Noise *noise_terrain_base;
 	Noise *noise_terrain_alt;
@@ -114,6 +122,7 @@ class MapgenV7 : public Mapgen {
 	float baseTerrainLevelFromMap(int index);
 	bool getMountainTerrainAtPoint(int x, int y, int z);
 	bool getMountainTerrainFromMap(int idx_xyz, int idx_xz, int y);
+	bool getMountainTerrainAtTop(s16 x, s16 z, int idx_xz);
 	
 	void calculateNoise();
 	
@@ -183,6 +183,15 @@ void ContentFeatures::reset()
 	has_on_construct = false;
 	has_on_destruct = false;
 	has_after_destruct = false;
+	has_allow_metadata_inventory_move = false;
+	has_allow_metadata_inventory_put = false;
+	has_allow_metadata_inventory_take = false;
+	has_on_metadata_inventory_move = false;
+	has_on_metadata_inventory_put = false;
+	has_on_metadata_inventory_take = false;
+	is_falling_node = false;
+	is_attached_node = false;
+	is_float = false;
 	/*
 		Actual data
 
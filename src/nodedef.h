@@ -172,6 +172,16 @@ struct ContentFeatures
 	bool has_on_construct;
 	bool has_on_destruct;
 	bool has_after_destruct;
+	bool has_allow_metadata_inventory_move;
+	bool has_allow_metadata_inventory_put;
+	bool has_allow_metadata_inventory_take;
+	bool has_on_metadata_inventory_move;
+	bool has_on_metadata_inventory_put;
+	bool has_on_metadata_inventory_take;
+	// Server-side cached groups used by falling and attached node updates
+	bool is_falling_node;
+	bool is_attached_node;
+	bool is_float;
 
 	/*
 		Actual data
@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/serialize.h"
 #include "constants.h" // MAP_BLOCKSIZE
 #include <sstream>
+#include <list>
 
 /*
 	NodeMetadata
@@ -41,19 +42,76 @@ NodeMetadata::~NodeMetadata()
 	delete m_inventory;
 }
 
-void NodeMetadata::serialize(std::ostream &os) const
+void NodeMetadata::serialize(std::ostream &os, bool disk) const
 {
-	int num_vars = m_stringvars.size();
-	writeU32(os, num_vars);
-	for(std::map<std::string, std::string>::const_iterator
-			i = m_stringvars.begin(); i != m_stringvars.end(); i++){
-		os<<serializeString(i->first);
-		os<<serializeLongString(i->second);
+	if(disk)
+	{
+		int num_vars = m_stringvars.size();
+		writeU32(os, num_vars);
+		for(std::map<std::string, std::string>::const_iterator
+				i = m_stringvars.begin(); i != m_stringvars.end(); i++){
+			os<<serializeString(i->first);
+			os<<serializeLongString(i->second);
+		}
+	}
+	else
+	{
+		// Leave out data that is private to the server
+		std::set<std::string> names;
+		getClientFieldNames(names);
+		std::list<std::map<std::string, std::string>::const_iterator> vars;
+		for(std::set<std::string>::iterator
+				i = names.begin(); i != names.end(); i++){
+			std::map<std::string, std::string>::const_iterator
+					j = m_stringvars.find(*i);
+			if(j != m_stringvars.end())
+				vars.push_back(j);
+		}
+		writeU32(os, vars.size());
+		for(std::list<std::map<std::string, std::string>::const_iterator>
+				::iterator i = vars.begin(); i != vars.end(); i++){
+			os<<serializeString((*i)->first);
+			os<<serializeLongString((*i)->second);
+		}
 	}
 
 	m_inventory->serialize(os);
 }
 
+void NodeMetadata::getClientFieldNames(std::set<std::string> &names) const
+{
+	/*
+		Clients show formspec and infotext, the text of the old sign
+		formspec, and whatever these refer to as ${name}
+	*/
+	std::list<std::string> todo;
+	todo.push_back("formspec");
+	todo.push_back("infotext");
+	if(getString("formspec") == "hack:sign_text_input")
+		todo.push_back("text");
+	while(!todo.empty())
+	{
+		std::string name = todo.front();
+		todo.pop_front();
+		if(!names.insert(name).second)
+			continue;
+		std::map<std::string, std::string>::const_iterator
+				i = m_stringvars.find(name);
+		if(i == m_stringvars.end())
+			continue;
+		const std::string &value = i->second;
+		size_t start = 0;
+		while((start = value.find("${", start)) != std::string::npos)
+		{
+			size_t end = value.find('}', start + 2);
+			if(end == std::string::npos)
+				break;
+			todo.push_back(value.substr(start + 2, end - start - 2));
+			start = end + 1;
+		}
+	}
+}
+
 void NodeMetadata::deSerialize(std::istream &is)
 {
 	m_stringvars.clear();
@@ -77,7 +135,7 @@ void NodeMetadata::clear()
 	NodeMetadataList
 */
 
-void NodeMetadataList::serialize(std::ostream &os) const
+void NodeMetadataList::serialize(std::ostream &os, bool disk) const
 {
 	/*
 		Version 0 is a placeholder for "nothing to see here; go away."
@@ -103,7 +161,7 @@ void NodeMetadataList::serialize(std::ostream &os) const
 		u16 p16 = p.Z*MAP_BLOCKSIZE*MAP_BLOCKSIZE + p.Y*MAP_BLOCKSIZE + p.X;
 		writeU16(os, p16);
 
-		data->serialize(os);
+		data->serialize(os, disk);
 	}
 }
 
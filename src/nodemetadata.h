@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <string>
 #include <iostream>
 #include <map>
+#include <set>
 
 /*
 	NodeMetadata stores arbitary amounts of data for special blocks.
@@ -43,7 +44,8 @@ class NodeMetadata
 	NodeMetadata(IGameDef *gamedef);
 	~NodeMetadata();
 	
-	void serialize(std::ostream &os) const;
+	// With disk=false, only the fields clients use are written
+	void serialize(std::ostream &os, bool disk=true) const;
 	void deSerialize(std::istream &is);
 	
 	void clear();
@@ -82,6 +84,9 @@ class NodeMetadata
 		return m_inventory;
 	}
 
+	// Names of the fields clients use
+	void getClientFieldNames(std::set<std::string> &names) const;
+
 private:
 	std::map<std::string, std::string> m_stringvars;
 	Inventory *m_inventory;
@@ -97,7 +102,7 @@ class NodeMetadataList
 public:
 	~NodeMetadataList();
 
-	void serialize(std::ostream &os) const;
+	void serialize(std::ostream &os, bool disk=true) const;
 	void deSerialize(std::istream &is, IGameDef *gamedef);
 	
 	// Get pointer to data
@@ -426,7 +426,7 @@ void Noise::gradientMap2D(float x, float y, float step_x, float step_y, int seed
 #define idx(x, y, z) ((z) * nly * nlx + (y) * nlx + (x))
 void Noise::gradientMap3D(float x, float y, float z,
 						  float step_x, float step_y, float step_z,
-						  int seed) {
+						  int seed, int ny) {
 	float v000, v010, v100, v110;
 	float v001, v011, v101, v111;
 	float u, v, w, orig_u, orig_v;
@@ -444,7 +444,7 @@ void Noise::gradientMap3D(float x, float y, float z,
 
 	//calculate noise point lattice
 	nlx = (int)(u + sx * step_x) + 2;
-	nly = (int)(v + sy * step_y) + 2;
+	nly = (int)(v + ny * step_y) + 2;
 	nlz = (int)(w + sz * step_z) + 2;
 	index = 0;
 	for (k = 0; k != nlz; k++)
@@ -459,7 +459,7 @@ void Noise::gradientMap3D(float x, float y, float z,
 	for (k = 0; k != sz; k++) {
 		v = orig_v;
 		noisey = 0;
-		for (j = 0; j != sy; j++) {
+		for (j = 0; j != ny; j++) {
 			v000 = noisebuf[idx(0, noisey,     noisez)];
 			v100 = noisebuf[idx(1, noisey,     noisez)];
 			v010 = noisebuf[idx(0, noisey + 1, noisez)];
@@ -573,24 +573,26 @@ float *Noise::perlinMap2DModulated(float x, float y, float *persist_map) {
 }
 
 
-float *Noise::perlinMap3D(float x, float y, float z) {
+float *Noise::perlinMap3D(float x, float y, float z, int ny) {
 	float f = 1.0, g = 1.0;
 	int i, j, k, index, oct;
 
+	assert(ny >= 0 && ny <= sy);
+
 	x /= np->spread.X;
 	y /= np->spread.Y;
 	z /= np->spread.Z;
 
-	memset(result, 0, sizeof(float) * sx * sy * sz);
+	memset(result, 0, sizeof(float) * sx * ny * sz);
 
 	for (oct = 0; oct < np->octaves; oct++) {
 		gradientMap3D(x * f, y * f, z * f,
 			f / np->spread.X, f / np->spread.Y, f / np->spread.Z,
-			seed + np->seed + oct);
+			seed + np->seed + oct, ny);
 
 		index = 0;
 		for (k = 0; k != sz; k++) {
-			for (j = 0; j != sy; j++) {
+			for (j = 0; j != ny; j++) {
 				for (i = 0; i != sx; i++) {
 					result[index] += g * buf[index];
 					index++;
@@ -104,10 +104,16 @@ class Noise {
 	void gradientMap3D(
 		float x, float y, float z,
 		float step_x, float step_y, float step_z,
-		int seed);
+		int seed, int ny);
 	float *perlinMap2D(float x, float y);
 	float *perlinMap2DModulated(float x, float y, float *persist_map);
-	float *perlinMap3D(float x, float y, float z);
+	float *perlinMap3D(float x, float y, float z) {
+		return perlinMap3D(x, y, z, sy);
+	}
+	// Only the bottom ny rows of each z slice are computed, and the result
+	// is laid out with ny rows per slice.  The values are bit-identical to
+	// those of the full map since each slice is interpolated bottom up.
+	float *perlinMap3D(float x, float y, float z, int ny);
 	void transformNoiseMap();
 };
 
@@ -41,6 +41,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "log.h"
 #include "util/string.h"
 #include <list>
+#include <fstream>
 
 #ifdef __APPLE__
 	#include "CoreFoundation/CoreFoundation.h"
@@ -252,6 +253,20 @@ bool threadSetPriority(threadid_t tid, int prio) {
 }
 
 
+u64 getResidentMemory() {
+#if defined(linux)
+	// The second field is the resident set size in pages
+	std::ifstream is("/proc/self/statm");
+	u64 size = 0, resident = 0;
+	if (!(is >> size >> resident))
+		return 0;
+	return resident * sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+
 /*
 	Path mangler
 */
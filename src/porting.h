@@ -148,6 +148,12 @@ bool threadBindToProcessor(threadid_t tid, int pnumber);
 */
 bool threadSetPriority(threadid_t tid, int prio);
 
+/*
+	Resident memory of this process in bytes, or 0 if unknown.
+	Only implemented on Linux.
+*/
+u64 getResidentMemory();
+
 /*
 	Resolution is 10-20ms.
 	Remember to check for overflows.
@@ -261,6 +261,24 @@ ContentFeatures read_content_features(lua_State *L, int index)
 	lua_getfield(L, index, "after_destruct");
 	if(!lua_isnil(L, -1)) f.has_after_destruct = true;
 	lua_pop(L, 1);
+	lua_getfield(L, index, "allow_metadata_inventory_move");
+	if(!lua_isnil(L, -1)) f.has_allow_metadata_inventory_move = true;
+	lua_pop(L, 1);
+	lua_getfield(L, index, "allow_metadata_inventory_put");
+	if(!lua_isnil(L, -1)) f.has_allow_metadata_inventory_put = true;
+	lua_pop(L, 1);
+	lua_getfield(L, index, "allow_metadata_inventory_take");
+	if(!lua_isnil(L, -1)) f.has_allow_metadata_inventory_take = true;
+	lua_pop(L, 1);
+	lua_getfield(L, index, "on_metadata_inventory_move");
+	if(!lua_isnil(L, -1)) f.has_on_metadata_inventory_move = true;
+	lua_pop(L, 1);
+	lua_getfield(L, index, "on_metadata_inventory_put");
+	if(!lua_isnil(L, -1)) f.has_on_metadata_inventory_put = true;
+	lua_pop(L, 1);
+	lua_getfield(L, index, "on_metadata_inventory_take");
+	if(!lua_isnil(L, -1)) f.has_on_metadata_inventory_take = true;
+	lua_pop(L, 1);
 
 	lua_getfield(L, index, "on_rightclick");
 	f.rightclickable = lua_isfunction(L, -1);
@@ -273,6 +291,9 @@ ContentFeatures read_content_features(lua_State *L, int index)
 	lua_getfield(L, index, "groups");
 	read_groups(L, -1, f.groups);
 	lua_pop(L, 1);
+	f.is_falling_node = itemgroup_get(f.groups, "falling_node") != 0;
+	f.is_attached_node = itemgroup_get(f.groups, "attached_node") != 0;
+	f.is_float = itemgroup_get(f.groups, "float") != 0;
 
 	/* Visual definition */
 
@@ -530,11 +551,89 @@ NodeBox read_nodebox(lua_State *L, int index)
 	return nodebox;
 }
 
+/******************************************************************************/
+/*
+	Registry tables caching content id -> name string and name -> content id,
+	keyed by the addresses of these so that looking them up hashes no string
+*/
+static char content_names_key;
+static char content_ids_key;
+
+static void push_registry_cache(lua_State *L, void *key)
+{
+	lua_pushlightuserdata(L, key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	if(lua_isnil(L, -1)){
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_pushlightuserdata(L, key);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, LUA_REGISTRYINDEX);
+	}
+}
+
+void push_content_name(lua_State *L, content_t c, INodeDefManager *ndef)
+{
+	push_registry_cache(L, &content_names_key);
+	lua_rawgeti(L, -1, c);
+	if(lua_isnil(L, -1)){
+		lua_pop(L, 1);
+		const std::string &name = ndef->get(c).name;
+		lua_pushlstring(L, name.c_str(), name.size());
+		// Ids without a name may still be registered later
+		if(!name.empty()){
+			lua_pushvalue(L, -1);
+			lua_rawseti(L, -3, c);
+		}
+	}
+	lua_remove(L, -2); // Remove cache
+}
+
+// Reads the name at index (a string) as a content id,
+// CONTENT_IGNORE if there is no such node
+content_t read_content_id(lua_State *L, int index,
+		INodeDefManager *ndef)
+{
+	if(index < 0)
+		index = lua_gettop(L) + 1 + index;
+	push_registry_cache(L, &content_ids_key);
+	lua_pushvalue(L, index);
+	lua_rawget(L, -2);
+	if(lua_isnumber(L, -1)){
+		content_t c = lua_tointeger(L, -1);
+		lua_pop(L, 2);
+		return c;
+	}
+	lua_pop(L, 1);
+	content_t c = CONTENT_IGNORE;
+	// Unknown names may still be registered later, don't cache them
+	if(ndef->getId(lua_tostring(L, index), c)){
+		lua_pushvalue(L, index);
+		lua_pushinteger(L, c);
+		lua_rawset(L, -3);
+	}
+	lua_pop(L, 1); // Remove cache
+	return c;
+}
+
+void clear_content_id_cache(lua_State *L)
+{
+	lua_pushlightuserdata(L, &content_names_key);
+	lua_pushnil(L);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+	lua_pushlightuserdata(L, &content_ids_key);
+	lua_pushnil(L);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
 /******************************************************************************/
 MapNode readnode(lua_State *L, int index, INodeDefManager *ndef)
 {
+	if(index < 0)
+		index = lua_gettop(L) + 1 + index;
 	lua_getfield(L, index, "name");
-	const char *name = luaL_checkstring(L, -1);
+	luaL_checkstring(L, -1);
+	content_t c = read_content_id(L, -1, ndef);
 	lua_pop(L, 1);
 	u8 param1;
 	lua_getfield(L, index, "param1");
@@ -550,14 +649,14 @@ MapNode readnode(lua_State *L, int index, INodeDefManager *ndef)
 	else
 		param2 = lua_tonumber(L, -1);
 	lua_pop(L, 1);
-	return MapNode(ndef, name, param1, param2);
+	return MapNode(c, param1, param2);
 }
 
 /******************************************************************************/
 void pushnode(lua_State *L, const MapNode &n, INodeDefManager *ndef)
 {
-	lua_newtable(L);
-	lua_pushstring(L, ndef->get(n).name.c_str());
+	lua_createtable(L, 0, 3);
+	push_content_name(L, n.getContent(), ndef);
 	lua_setfield(L, -2, "name");
 	lua_pushnumber(L, n.getParam1());
 	lua_setfield(L, -2, "param1");
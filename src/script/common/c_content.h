@@ -38,6 +38,7 @@ extern "C" {
 
 #include "irrlichttypes_bloated.h"
 #include "util/string.h"
+#include "mapnode.h" // content_t
 
 namespace Json { class Value; }
 
@@ -105,6 +106,14 @@ MapNode            readnode                  (lua_State *L,
 void               pushnode                  (lua_State *L,
                                               const MapNode &n,
                                               INodeDefManager *ndef);
+void               push_content_name         (lua_State *L,
+                                              content_t c,
+                                              INodeDefManager *ndef);
+content_t          read_content_id           (lua_State *L,
+                                              int index,
+                                              INodeDefManager *ndef);
+// Call when names or aliases change; the caches above resolve aliases
+void               clear_content_id_cache    (lua_State *L);
 
 NodeBox            read_nodebox              (lua_State *L, int index);
 
@@ -28,7 +28,7 @@ extern "C" {
 
 void push_v3f(lua_State *L, v3f p)
 {
-	lua_newtable(L);
+	lua_createtable(L, 0, 3);
 	lua_pushnumber(L, p.X);
 	lua_setfield(L, -2, "x");
 	lua_pushnumber(L, p.Y);
@@ -117,7 +117,7 @@ v3f checkFloatPos(lua_State *L, int index)
 
 void push_v3s16(lua_State *L, v3s16 p)
 {
-	lua_newtable(L);
+	lua_createtable(L, 0, 3);
 	lua_pushnumber(L, p.X);
 	lua_setfield(L, -2, "x");
 	lua_pushnumber(L, p.Y);
@@ -24,6 +24,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "environment.h"
 #include "mapgen.h"
 #include "lua_api/l_env.h"
+#include <algorithm>
+
+ScriptApiEnv::ScriptApiEnv():
+	m_timer_clock(0),
+	m_timer_seq(0)
+{
+}
 
 void ScriptApiEnv::environment_OnGenerated(v3s16 minp, v3s16 maxp,
 		u32 blockseed)
@@ -45,6 +52,8 @@ void ScriptApiEnv::environment_Step(float dtime)
 	SCRIPTAPI_PRECHECKHEADER
 	//infostream<<"scriptapi_environment_step"<<std::endl;
 
+	runTimers(dtime);
+
 	// Get minetest.registered_globalsteps
 	lua_getglobal(L, "minetest");
 	lua_getfield(L, -1, "registered_globalsteps");
@@ -53,6 +62,74 @@ void ScriptApiEnv::environment_Step(float dtime)
 	script_run_callbacks(L, 1, RUN_CALLBACKS_MODE_FIRST);
 }
 
+void ScriptApiEnv::addTimer(float time, int ref)
+{
+	Timer timer;
+	timer.expire = m_timer_clock + time;
+	timer.seq = m_timer_seq++;
+	timer.ref = ref;
+	m_timers.push_back(timer);
+	std::push_heap(m_timers.begin(), m_timers.end(), TimerLater());
+}
+
+void ScriptApiEnv::runTimers(float dtime)
+{
+	lua_State *L = getStack();
+
+	m_timer_clock += dtime;
+
+	/*
+		Take out everything that has expired before calling anything,
+		so that timers added by the callbacks wait for the next step.
+		They are run in the order they were added, like before.
+	*/
+	std::vector<Timer> expired;
+	while(!m_timers.empty() && m_timers.front().expire <= m_timer_clock)
+	{
+		std::pop_heap(m_timers.begin(), m_timers.end(), TimerLater());
+		expired.push_back(m_timers.back());
+		m_timers.pop_back();
+	}
+	if(expired.empty())
+		return;
+	std::sort(expired.begin(), expired.end(), TimerAddedBefore());
+
+	lua_pushcfunction(L, script_error_handler);
+	int errorhandler = lua_gettop(L);
+
+	for(std::vector<Timer>::iterator i = expired.begin();
+			i != expired.end(); i++)
+	{
+		lua_rawgeti(L, LUA_REGISTRYINDEX, i->ref);
+		luaL_unref(L, LUA_REGISTRYINDEX, i->ref);
+		int timer = lua_gettop(L);
+
+		lua_getfield(L, timer, "func");
+		lua_getfield(L, timer, "args");
+		int nargs = 0;
+		if(lua_istable(L, -1)){
+			int args = lua_gettop(L);
+			nargs = lua_objlen(L, args);
+			luaL_checkstack(L, nargs, "too many timer arguments");
+			for(int j = 1; j <= nargs; j++)
+				lua_rawgeti(L, args, j);
+			lua_remove(L, args);
+		} else {
+			lua_pop(L, 1);
+		}
+		if(lua_pcall(L, nargs, 0, errorhandler)){
+			// The timers that did not get to run are dropped; release
+			// their tables before the error goes up
+			for(std::vector<Timer>::iterator j = i + 1;
+					j != expired.end(); j++)
+				luaL_unref(L, LUA_REGISTRYINDEX, j->ref);
+			scriptError();
+		}
+		lua_pop(L, 1); // Pop timer table
+	}
+	lua_pop(L, 1); // Pop error handler
+}
+
 void ScriptApiEnv::environment_OnMapgenInit(MapgenParams *mgparams)
 {
 	SCRIPTAPI_PRECHECKHEADER
@@ -101,7 +178,6 @@ void ScriptApiEnv::initializeEnvironment(ServerEnvironment *env)
 		lua_pushnil(L);
 		while(lua_next(L, table) != 0){
 			// key at index -2 and value at index -1
-			int id = lua_tonumber(L, -2);
 			int current_abm = lua_gettop(L);
 
 			std::set<std::string> trigger_contents;
@@ -144,8 +220,15 @@ void ScriptApiEnv::initializeEnvironment(ServerEnvironment *env)
 			int trigger_chance = 50;
 			getintfield(L, current_abm, "chance", trigger_chance);
 
-			LuaABM *abm = new LuaABM(L, id, trigger_contents,
-					required_neighbors, trigger_interval, trigger_chance);
+			bool reuse_arguments = getboolfield_default(L, current_abm,
+					"reuse_arguments", false);
+
+			lua_getfield(L, current_abm, "action");
+			int action_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+			LuaABM *abm = new LuaABM(L, action_ref, reuse_arguments,
+					trigger_contents, required_neighbors,
+					trigger_interval, trigger_chance);
 
 			env->addActiveBlockModifier(abm);
 
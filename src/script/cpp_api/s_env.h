@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "cpp_api/s_base.h"
 #include "irr_v3d.h"
+#include <vector>
 
 class ServerEnvironment;
 struct MapgenParams;
@@ -30,6 +31,8 @@ class ScriptApiEnv
 		: virtual public ScriptApiBase
 {
 public:
+	ScriptApiEnv();
+
 	// On environment step
 	void environment_Step(float dtime);
 	// After generating a piece of map
@@ -38,6 +41,42 @@ class ScriptApiEnv
 	void environment_OnMapgenInit(MapgenParams *mgparams);
 
 	void initializeEnvironment(ServerEnvironment *env);
+
+	// Schedule the {func=, args=} table referenced by ref (in the
+	// registry) to be called after time seconds; used by minetest.after
+	void addTimer(float time, int ref);
+	// Advance the timer clock and call the expired timers; done by
+	// environment_Step
+	void runTimers(float dtime);
+
+private:
+	struct Timer
+	{
+		double expire;
+		u32 seq;
+		int ref;
+	};
+	struct TimerLater
+	{
+		bool operator()(const Timer &a, const Timer &b) const
+		{
+			if(a.expire != b.expire)
+				return a.expire > b.expire;
+			return a.seq > b.seq;
+		}
+	};
+	struct TimerAddedBefore
+	{
+		bool operator()(const Timer &a, const Timer &b) const
+		{
+			return a.seq < b.seq;
+		}
+	};
+
+	// Binary min-heap on expire time
+	std::vector<Timer> m_timers;
+	double m_timer_clock;
+	u32 m_timer_seq;
 };
 
 #endif /* S_ENV_H_ */
@@ -284,3 +284,38 @@ void ScriptApiNode::node_falling_update_single(v3s16 p)
 	lua_pop(L, 1); // Pop error handler
 }
 
+void ScriptApiNode::node_falling_spawn(v3s16 p, MapNode node)
+{
+	SCRIPTAPI_PRECHECKHEADER
+
+	INodeDefManager *ndef = getServer()->ndef();
+
+	lua_pushcfunction(L, script_error_handler);
+	int errorhandler = lua_gettop(L);
+
+	// Call spawn_falling_node(p, node)
+	lua_getglobal(L, "spawn_falling_node");
+	push_v3s16(L, p);
+	pushnode(L, node, ndef);
+	lua_pushinteger(L, node.getLevel(ndef));
+	lua_setfield(L, -2, "level");
+	if(lua_pcall(L, 2, 0, errorhandler))
+		scriptError();
+	lua_pop(L, 1); // Pop error handler
+}
+
+void ScriptApiNode::node_drop_attached(v3s16 p)
+{
+	SCRIPTAPI_PRECHECKHEADER
+
+	lua_pushcfunction(L, script_error_handler);
+	int errorhandler = lua_gettop(L);
+
+	// Call drop_attached_node(p)
+	lua_getglobal(L, "drop_attached_node");
+	push_v3s16(L, p);
+	if(lua_pcall(L, 1, 0, errorhandler))
+		scriptError();
+	lua_pop(L, 1); // Pop error handler
+}
+
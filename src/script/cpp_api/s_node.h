@@ -51,6 +51,9 @@ class ScriptApiNode
 			ServerActiveObject *sender);
 	void node_falling_update(v3s16 p);
 	void node_falling_update_single(v3s16 p);
+	// Hooks used by ServerEnvironment::checkForFalling
+	void node_falling_spawn(v3s16 p, MapNode node);
+	void node_drop_attached(v3s16 p);
 public:
 	static struct EnumString es_DrawType[];
 	static struct EnumString es_ContentParamType[];
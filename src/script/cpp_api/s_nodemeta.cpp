@@ -44,9 +44,13 @@ int ScriptApiNodemeta::nodemeta_inventory_AllowMove(v3s16 p,
 	if(node.getContent() == CONTENT_IGNORE)
 		return 0;
 
+	// Nodes registered without the callback don't need a Lua lookup
+	const ContentFeatures &f = ndef->get(node);
+	if(!f.has_allow_metadata_inventory_move)
+		return count;
+
 	// Push callback function on stack
-	if(!getItemCallback(ndef->get(node).name.c_str(),
-			"allow_metadata_inventory_move"))
+	if(!getItemCallback(f.name.c_str(), "allow_metadata_inventory_move"))
 		return count;
 
 	// function(pos, from_list, from_index, to_list, to_index, count, player)
@@ -84,9 +88,13 @@ int ScriptApiNodemeta::nodemeta_inventory_AllowPut(v3s16 p,
 	if(node.getContent() == CONTENT_IGNORE)
 		return 0;
 
+	// Nodes registered without the callback don't need a Lua lookup
+	const ContentFeatures &f = ndef->get(node);
+	if(!f.has_allow_metadata_inventory_put)
+		return stack.count;
+
 	// Push callback function on stack
-	if(!getItemCallback(ndef->get(node).name.c_str(),
-			"allow_metadata_inventory_put"))
+	if(!getItemCallback(f.name.c_str(), "allow_metadata_inventory_put"))
 		return stack.count;
 
 	// Call function(pos, listname, index, stack, player)
@@ -122,9 +130,13 @@ int ScriptApiNodemeta::nodemeta_inventory_AllowTake(v3s16 p,
 	if(node.getContent() == CONTENT_IGNORE)
 		return 0;
 
+	// Nodes registered without the callback don't need a Lua lookup
+	const ContentFeatures &f = ndef->get(node);
+	if(!f.has_allow_metadata_inventory_take)
+		return stack.count;
+
 	// Push callback function on stack
-	if(!getItemCallback(ndef->get(node).name.c_str(),
-			"allow_metadata_inventory_take"))
+	if(!getItemCallback(f.name.c_str(), "allow_metadata_inventory_take"))
 		return stack.count;
 
 	// Call function(pos, listname, index, count, player)
@@ -161,9 +173,13 @@ void ScriptApiNodemeta::nodemeta_inventory_OnMove(v3s16 p,
 	if(node.getContent() == CONTENT_IGNORE)
 		return;
 
+	// Nodes registered without the callback don't need a Lua lookup
+	const ContentFeatures &f = ndef->get(node);
+	if(!f.has_on_metadata_inventory_move)
+		return;
+
 	// Push callback function on stack
-	if(!getItemCallback(ndef->get(node).name.c_str(),
-			"on_metadata_inventory_move"))
+	if(!getItemCallback(f.name.c_str(), "on_metadata_inventory_move"))
 		return;
 
 	// function(pos, from_list, from_index, to_list, to_index, count, player)
@@ -196,9 +212,13 @@ void ScriptApiNodemeta::nodemeta_inventory_OnPut(v3s16 p,
 	if(node.getContent() == CONTENT_IGNORE)
 		return;
 
+	// Nodes registered without the callback don't need a Lua lookup
+	const ContentFeatures &f = ndef->get(node);
+	if(!f.has_on_metadata_inventory_put)
+		return;
+
 	// Push callback function on stack
-	if(!getItemCallback(ndef->get(node).name.c_str(),
-			"on_metadata_inventory_put"))
+	if(!getItemCallback(f.name.c_str(), "on_metadata_inventory_put"))
 		return;
 
 	// Call function(pos, listname, index, stack, player)
@@ -229,9 +249,13 @@ void ScriptApiNodemeta::nodemeta_inventory_OnTake(v3s16 p,
 	if(node.getContent() == CONTENT_IGNORE)
 		return;
 
+	// Nodes registered without the callback don't need a Lua lookup
+	const ContentFeatures &f = ndef->get(node);
+	if(!f.has_on_metadata_inventory_take)
+		return;
+
 	// Push callback function on stack
-	if(!getItemCallback(ndef->get(node).name.c_str(),
-			"on_metadata_inventory_take"))
+	if(!getItemCallback(f.name.c_str(), "on_metadata_inventory_take"))
 		return;
 
 	// Call function(pos, listname, index, stack, player)
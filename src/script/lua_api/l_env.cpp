@@ -49,33 +49,43 @@ void LuaABM::trigger(ServerEnvironment *env, v3s16 p, MapNode n,
 	GameScripting *scriptIface = env->getScriptIface();
 	scriptIface->realityCheck();
 
-	lua_State *L = scriptIface->getStack();
+	callAction(scriptIface->getStack(), p, n, env->getGameDef()->ndef(),
+			active_object_count, active_object_count_wider);
+}
+
+void LuaABM::callAction(lua_State *L, v3s16 p, MapNode n,
+		INodeDefManager *ndef,
+		u32 active_object_count, u32 active_object_count_wider)
+{
 	assert(lua_checkstack(L, 20));
 	StackUnroller stack_unroller(L);
 
 	lua_pushcfunction(L, script_error_handler);
 	int errorhandler = lua_gettop(L);
 
-	// Get minetest.registered_abms
-	lua_getglobal(L, "minetest");
-	lua_getfield(L, -1, "registered_abms");
-	luaL_checktype(L, -1, LUA_TTABLE);
-	lua_remove(L, -2); // Remove "minetest"
-
-	// Get minetest.registered_abms[m_id]
-	lua_pushnumber(L, m_id);
-	lua_gettable(L, -2);
-	if(lua_isnil(L, -1))
-		assert(0);
-	lua_remove(L, -2); // Remove "registered_abms"
-
 	// Call action
-	luaL_checktype(L, -1, LUA_TTABLE);
-	lua_getfield(L, -1, "action");
+	lua_rawgeti(L, LUA_REGISTRYINDEX, m_action_ref);
 	luaL_checktype(L, -1, LUA_TFUNCTION);
-	lua_remove(L, -2); // Remove "registered_abms[m_id]"
-	push_v3s16(L, p);
-	pushnode(L, n, env->getGameDef()->ndef());
+	if(m_pos_ref == LUA_NOREF){
+		push_v3s16(L, p);
+		pushnode(L, n, ndef);
+	} else {
+		// Refill the tables of the previous call
+		lua_rawgeti(L, LUA_REGISTRYINDEX, m_pos_ref);
+		lua_pushnumber(L, p.X);
+		lua_setfield(L, -2, "x");
+		lua_pushnumber(L, p.Y);
+		lua_setfield(L, -2, "y");
+		lua_pushnumber(L, p.Z);
+		lua_setfield(L, -2, "z");
+		lua_rawgeti(L, LUA_REGISTRYINDEX, m_node_ref);
+		push_content_name(L, n.getContent(), ndef);
+		lua_setfield(L, -2, "name");
+		lua_pushnumber(L, n.getParam1());
+		lua_setfield(L, -2, "param1");
+		lua_pushnumber(L, n.getParam2());
+		lua_setfield(L, -2, "param2");
+	}
 	lua_pushnumber(L, active_object_count);
 	lua_pushnumber(L, active_object_count_wider);
 	if(lua_pcall(L, 4, 0, errorhandler))
@@ -156,6 +166,35 @@ int ModApiEnvMod::l_get_node_or_nil(lua_State *L)
 	}
 }
 
+// minetest.get_node_raw(x, y, z) -> content_id, param1, param2
+// Like get_node, but without creating a table or a name string
+int ModApiEnvMod::l_get_node_raw(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	v3s16 pos(luaL_checkint(L, 1), luaL_checkint(L, 2), luaL_checkint(L, 3));
+	MapNode n = env->getMap().getNodeNoEx(pos);
+	lua_pushinteger(L, n.getContent());
+	lua_pushinteger(L, n.getParam1());
+	lua_pushinteger(L, n.getParam2());
+	return 3;
+}
+
+// minetest.set_node_raw(x, y, z, content_id, param1, param2)
+int ModApiEnvMod::l_set_node_raw(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	INodeDefManager *ndef = env->getGameDef()->ndef();
+	v3s16 pos(luaL_checkint(L, 1), luaL_checkint(L, 2), luaL_checkint(L, 3));
+	int c = luaL_checkint(L, 4);
+	luaL_argcheck(L, c >= 0 && c <= (int)MAX_REGISTERED_CONTENT &&
+			!ndef->get((content_t)c).name.empty(), 4, "invalid content id");
+	MapNode n(c, luaL_optint(L, 5, 0), luaL_optint(L, 6, 0));
+	lua_pushboolean(L, env->setNode(pos, n));
+	return 1;
+}
+
 // minetest.get_node_light(pos, timeofday)
 // pos = {x=num, y=num, z=num}
 // timeofday: nil = current time, 0 = night, 0.5 = day
@@ -432,32 +471,85 @@ int ModApiEnvMod::l_get_player_by_name(lua_State *L)
 // minetest.get_objects_inside_radius(pos, radius)
 int ModApiEnvMod::l_get_objects_inside_radius(lua_State *L)
 {
-	// Get the table insert function
-	lua_getglobal(L, "table");
-	lua_getfield(L, -1, "insert");
-	int table_insert = lua_gettop(L);
-
 	GET_ENV_PTR;
 
 	// Do it
 	v3f pos = checkFloatPos(L, 1);
 	float radius = luaL_checknumber(L, 2) * BS;
 	std::set<u16> ids = env->getObjectsInsideRadius(pos, radius);
-	lua_newtable(L);
+	lua_createtable(L, ids.size(), 0);
 	int table = lua_gettop(L);
+	int n = 0;
 	for(std::set<u16>::const_iterator
 			i = ids.begin(); i != ids.end(); i++){
 		ServerActiveObject *obj = env->getActiveObject(*i);
 		// Insert object reference into table
-		lua_pushvalue(L, table_insert);
-		lua_pushvalue(L, table);
 		getScriptApiBase(L)->objectrefGetOrCreate(obj);
-		if(lua_pcall(L, 2, 0, 0))
-			script_error(L);
+		lua_rawseti(L, table, ++n);
 	}
 	return 1;
 }
 
+// minetest.get_objects_in_area(minp, maxp, filter, result)
+// filter = {type="player"/"entity", name=..., armor_group=...} or nil
+// result = table to reuse for the return value, or nil
+int ModApiEnvMod::l_get_objects_in_area(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	aabb3f box(checkFloatPos(L, 1));
+	box.addInternalPoint(checkFloatPos(L, 2));
+
+	ActiveObjectQuery query;
+	if(lua_istable(L, 3))
+	{
+		std::string type = getstringfield_default(L, 3, "type", "");
+		if(type == "player")
+			query.type = ACTIVEOBJECT_TYPE_PLAYER;
+		else if(type == "entity")
+			query.type = ACTIVEOBJECT_TYPE_LUAENTITY;
+		else if(type != "")
+			throw LuaError(L, "get_objects_in_area: unknown object type \""
+					+ type + "\"");
+		query.name = getstringfield_default(L, 3, "name", "");
+		query.armor_group = getstringfield_default(L, 3, "armor_group", "");
+	}
+	else if(!lua_isnoneornil(L, 3))
+	{
+		luaL_checktype(L, 3, LUA_TTABLE);
+	}
+
+	std::vector<u16> ids;
+	env->getObjectsInArea(box, query, ids);
+
+	int table;
+	int old_size = 0;
+	if(lua_istable(L, 4))
+	{
+		table = 4;
+		old_size = lua_objlen(L, table);
+	}
+	else
+	{
+		lua_createtable(L, ids.size(), 0);
+		table = lua_gettop(L);
+	}
+	int n = 0;
+	for(std::vector<u16>::const_iterator
+			i = ids.begin(); i != ids.end(); i++){
+		ServerActiveObject *obj = env->getActiveObject(*i);
+		getScriptApiBase(L)->objectrefGetOrCreate(obj);
+		lua_rawseti(L, table, ++n);
+	}
+	// Clear what is left over from the last use of a reused table
+	for(int i = n + 1; i <= old_size; i++){
+		lua_pushnil(L);
+		lua_rawseti(L, table, i);
+	}
+	lua_pushvalue(L, table);
+	return 1;
+}
+
 // minetest.set_timeofday(val)
 // val = 0...1
 int ModApiEnvMod::l_set_timeofday(lua_State *L)
@@ -791,6 +883,38 @@ int ModApiEnvMod::l_get_humidity(lua_State *L)
 	return 1;
 }
 
+// minetest.check_for_falling(pos)
+int ModApiEnvMod::l_check_for_falling(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	v3s16 p = read_v3s16(L, 1);
+	env->checkForFalling(p);
+	return 0;
+}
+
+// minetest.check_single_for_falling(pos) -> true if the node fell or dropped
+int ModApiEnvMod::l_check_single_for_falling(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	v3s16 p = read_v3s16(L, 1);
+	lua_pushboolean(L, env->checkSingleForFalling(p));
+	return 1;
+}
+
+// minetest.add_timer(time, {func=function, args={...}})
+// Works before the environment exists, mods call minetest.after at load time
+int ModApiEnvMod::l_add_timer(lua_State *L)
+{
+	float time = luaL_checknumber(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	lua_settop(L, 2);
+	int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	getScriptApi<ScriptApiEnv>(L)->addTimer(time, ref);
+	return 0;
+}
+
 
 void ModApiEnvMod::Initialize(lua_State *L, int top)
 {
@@ -800,6 +924,8 @@ void ModApiEnvMod::Initialize(lua_State *L, int top)
 	API_FCT(remove_node);
 	API_FCT(get_node);
 	API_FCT(get_node_or_nil);
+	API_FCT(get_node_raw);
+	API_FCT(set_node_raw);
 	API_FCT(get_node_light);
 	API_FCT(place_node);
 	API_FCT(dig_node);
@@ -813,6 +939,7 @@ void ModApiEnvMod::Initialize(lua_State *L, int top)
 	API_FCT(get_node_timer);
 	API_FCT(get_player_by_name);
 	API_FCT(get_objects_inside_radius);
+	API_FCT(get_objects_in_area);
 	API_FCT(set_timeofday);
 	API_FCT(get_timeofday);
 	API_FCT(get_gametime);
@@ -828,4 +955,7 @@ void ModApiEnvMod::Initialize(lua_State *L, int top)
 	API_FCT(transforming_liquid_add);
 	API_FCT(get_heat);
 	API_FCT(get_humidity);
+	API_FCT(check_for_falling);
+	API_FCT(check_single_for_falling);
+	API_FCT(add_timer);
 }
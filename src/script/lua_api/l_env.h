@@ -43,6 +43,12 @@ class ModApiEnvMod : public ModApiBase {
 	// pos = {x=num, y=num, z=num}
 	static int l_get_node_or_nil(lua_State *L);
 
+	// minetest.get_node_raw(x, y, z) -> content_id, param1, param2
+	static int l_get_node_raw(lua_State *L);
+
+	// minetest.set_node_raw(x, y, z, content_id, param1, param2)
+	static int l_set_node_raw(lua_State *L);
+
 	// minetest.get_node_light(pos, timeofday)
 	// pos = {x=num, y=num, z=num}
 	// timeofday: nil = current time, 0 = night, 0.5 = day
@@ -97,6 +103,9 @@ class ModApiEnvMod : public ModApiBase {
 	// minetest.get_objects_inside_radius(pos, radius)
 	static int l_get_objects_inside_radius(lua_State *L);
 
+	// minetest.get_objects_in_area(minp, maxp, filter, result)
+	static int l_get_objects_in_area(lua_State *L);
+
 	// minetest.set_timeofday(val)
 	// val = 0...1
 	static int l_set_timeofday(lua_State *L);
@@ -146,6 +155,16 @@ class ModApiEnvMod : public ModApiBase {
 
 	static int l_get_heat(lua_State *L);
 	static int l_get_humidity(lua_State *L);
+
+	// minetest.check_for_falling(pos)
+	static int l_check_for_falling(lua_State *L);
+
+	// minetest.check_single_for_falling(pos) -> true/false
+	static int l_check_single_for_falling(lua_State *L);
+
+	// minetest.add_timer(time, {func=function, args={...}})
+	// used by minetest.after
+	static int l_add_timer(lua_State *L);
 	
 public:
 	static void Initialize(lua_State *L, int top);
@@ -154,23 +173,37 @@ class ModApiEnvMod : public ModApiBase {
 class LuaABM : public ActiveBlockModifier
 {
 private:
-	int m_id;
+	// Registry reference to the action function
+	int m_action_ref;
+	// Registry references to the pos and node tables passed to the
+	// action if the ABM was registered with reuse_arguments = true,
+	// else LUA_NOREF
+	int m_pos_ref;
+	int m_node_ref;
 
 	std::set<std::string> m_trigger_contents;
 	std::set<std::string> m_required_neighbors;
 	float m_trigger_interval;
 	u32 m_trigger_chance;
 public:
-	LuaABM(lua_State *L, int id,
+	LuaABM(lua_State *L, int action_ref, bool reuse_arguments,
 			const std::set<std::string> &trigger_contents,
 			const std::set<std::string> &required_neighbors,
 			float trigger_interval, u32 trigger_chance):
-		m_id(id),
+		m_action_ref(action_ref),
+		m_pos_ref(LUA_NOREF),
+		m_node_ref(LUA_NOREF),
 		m_trigger_contents(trigger_contents),
 		m_required_neighbors(required_neighbors),
 		m_trigger_interval(trigger_interval),
 		m_trigger_chance(trigger_chance)
 	{
+		if(reuse_arguments){
+			lua_createtable(L, 0, 3);
+			m_pos_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+			lua_createtable(L, 0, 3);
+			m_node_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
 	}
 	virtual std::set<std::string> getTriggerContents()
 	{
@@ -190,6 +223,10 @@ class LuaABM : public ActiveBlockModifier
 	}
 	virtual void trigger(ServerEnvironment *env, v3s16 p, MapNode n,
 			u32 active_object_count, u32 active_object_count_wider);
+	// Calls the action on the given stack; used by trigger() and by the
+	// ABM dispatch benchmark
+	void callAction(lua_State *L, v3s16 p, MapNode n, INodeDefManager *ndef,
+			u32 active_object_count, u32 active_object_count_wider);
 };
 
 #endif /* L_ENV_H_ */
@@ -504,6 +504,8 @@ int ModApiItemMod::l_register_item_raw(lua_State *L)
 					+ itos(MAX_REGISTERED_CONTENT+1)
 					+ ") exceeded (" + name + ")");
 		}
+		// The name may have been an alias until now
+		clear_content_id_cache(L);
 	}
 
 	return 0; /* number of results */
@@ -521,6 +523,7 @@ int ModApiItemMod::l_register_alias_raw(lua_State *L)
 			getServer(L)->getWritableItemDefManager();
 
 	idef->registerAlias(name, convert_to);
+	clear_content_id_cache(L);
 
 	return 0; /* number of results */
 }
@@ -529,10 +532,10 @@ int ModApiItemMod::l_register_alias_raw(lua_State *L)
 int ModApiItemMod::l_get_content_id(lua_State *L)
 {
 	NO_MAP_LOCK_REQUIRED;
-	std::string name = luaL_checkstring(L, 1);
+	luaL_checkstring(L, 1);
 
 	INodeDefManager *ndef = getServer(L)->getNodeDefManager();
-	content_t c = ndef->getId(name);
+	content_t c = read_content_id(L, 1, ndef);
 	
 	lua_pushinteger(L, c);
 	return 1; /* number of results */
@@ -545,9 +548,7 @@ int ModApiItemMod::l_get_name_from_content_id(lua_State *L)
 	content_t c = luaL_checkint(L, 1);
 
 	INodeDefManager *ndef = getServer(L)->getNodeDefManager();
-	const char *name = ndef->get(c).name.c_str();
-	
-	lua_pushstring(L, name);
+	push_content_name(L, c, ndef);
 	return 1; /* number of results */
 }
 
@@ -56,8 +56,8 @@ void NodeMetaRef::reportMetadataChange(NodeMetaRef *ref)
 	// Inform other things that the metadata has changed
 	v3s16 blockpos = getNodeBlockPos(ref->m_p);
 	MapEditEvent event;
-	event.type = MEET_BLOCK_NODE_METADATA_CHANGED;
-	event.p = blockpos;
+	event.type = MEET_NODEMETA_CHANGED;
+	event.p = ref->m_p;
 	ref->m_env->getMap().dispatchEvent(&event);
 	// Set the block to be saved
 	MapBlock *block = ref->m_env->getMap().getBlockNoCreateNoEx(blockpos);
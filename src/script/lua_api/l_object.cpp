@@ -545,6 +545,30 @@ int ObjectRef::l_getyaw(lua_State *L)
 	return 1;
 }
 
+// sleep(self)
+int ObjectRef::l_sleep(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	ObjectRef *ref = checkobject(L, 1);
+	LuaEntitySAO *co = getluaobject(ref);
+	if(co == NULL) return 0;
+	// Do it
+	co->sleep();
+	return 0;
+}
+
+// is_sleeping(self)
+int ObjectRef::l_is_sleeping(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	ObjectRef *ref = checkobject(L, 1);
+	LuaEntitySAO *co = getluaobject(ref);
+	if(co == NULL) return 0;
+	// Do it
+	lua_pushboolean(L, co->isSleeping());
+	return 1;
+}
+
 // settexturemod(self, mod)
 int ObjectRef::l_settexturemod(lua_State *L)
 {
@@ -720,8 +744,10 @@ int ObjectRef::l_set_breath(lua_State *L)
 	if(co == NULL) return 0;
 	u16 breath = luaL_checknumber(L, 2);
 	// Do it
-	co->setBreath(breath);
-	co->m_breath_not_sent = true;
+	if (breath != co->getBreath()) {
+		co->setBreath(breath);
+		co->m_breath_not_sent = true;
+	}
 	return 0;
 }
 
@@ -904,40 +930,70 @@ int ObjectRef::l_hud_change(lua_State *L)
 	if (!e)
 		return 0;
 
+	// Mods tend to set the same values over and over again, only send
+	// the ones that actually change
+	bool changed = true;
+
 	switch (stat) {
-		case HUD_STAT_POS:
-			e->pos = read_v2f(L, 4);
+		case HUD_STAT_POS: {
+			v2f pos = read_v2f(L, 4);
+			changed = (pos != e->pos);
+			e->pos = pos;
 			value = &e->pos;
-			break;
-		case HUD_STAT_NAME:
-			e->name = lua_tostring(L, 4);
+			break; }
+		case HUD_STAT_NAME: {
+			std::string name = lua_tostring(L, 4);
+			changed = (name != e->name);
+			e->name = name;
 			value = &e->name;
-			break;
-		case HUD_STAT_SCALE:
-			e->scale = read_v2f(L, 4);
+			break; }
+		case HUD_STAT_SCALE: {
+			v2f scale = read_v2f(L, 4);
+			changed = (scale != e->scale);
+			e->scale = scale;
 			value = &e->scale;
-			break;
-		case HUD_STAT_TEXT:
-			e->text = lua_tostring(L, 4);
+			break; }
+		case HUD_STAT_TEXT: {
+			std::string text = lua_tostring(L, 4);
+			changed = (text != e->text);
+			e->text = text;
 			value = &e->text;
-			break;
-		case HUD_STAT_NUMBER:
-			e->number = lua_tonumber(L, 4);
+			break; }
+		case HUD_STAT_NUMBER: {
+			u32 number = lua_tonumber(L, 4);
+			changed = (number != e->number);
+			e->number = number;
 			value = &e->number;
-			break;
-		case HUD_STAT_ITEM:
-			e->item = lua_tonumber(L, 4);
+			break; }
+		case HUD_STAT_ITEM: {
+			u32 item = lua_tonumber(L, 4);
+			changed = (item != e->item);
+			e->item = item;
 			value = &e->item;
-			break;
-		case HUD_STAT_DIR:
-			e->dir = lua_tonumber(L, 4);
+			break; }
+		case HUD_STAT_DIR: {
+			u32 dir = lua_tonumber(L, 4);
+			changed = (dir != e->dir);
+			e->dir = dir;
 			value = &e->dir;
-		case HUD_STAT_ALIGN:
-			e->align = read_v2f(L, 4);
+			break; }
+		case HUD_STAT_ALIGN: {
+			v2f align = read_v2f(L, 4);
+			changed = (align != e->align);
+			e->align = align;
 			value = &e->align;
-		case HUD_STAT_OFFSET:
-			e->offset = read_v2f(L, 4);
+			break; }
+		case HUD_STAT_OFFSET: {
+			v2f offset = read_v2f(L, 4);
+			changed = (offset != e->offset);
+			e->offset = offset;
 			value = &e->offset;
+			break; }
+	}
+
+	if (!changed) {
+		lua_pushboolean(L, true);
+		return 1;
 	}
 
 	getServer(L)->hudChange(player, id, stat, value);
@@ -1152,6 +1208,8 @@ const luaL_reg ObjectRef::methods[] = {
 	luamethod(ObjectRef, getacceleration),
 	luamethod(ObjectRef, setyaw),
 	luamethod(ObjectRef, getyaw),
+	luamethod(ObjectRef, sleep),
+	luamethod(ObjectRef, is_sleeping),
 	luamethod(ObjectRef, settexturemod),
 	luamethod(ObjectRef, setsprite),
 	luamethod(ObjectRef, get_entity_name),
@@ -139,6 +139,12 @@ class ObjectRef : public ModApiBase {
 	// getyaw(self)
 	static int l_getyaw(lua_State *L);
 
+	// sleep(self)
+	static int l_sleep(lua_State *L);
+
+	// is_sleeping(self)
+	static int l_is_sleeping(lua_State *L);
+
 	// settexturemod(self, mod)
 	static int l_settexturemod(lua_State *L);
 
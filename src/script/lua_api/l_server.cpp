@@ -24,6 +24,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "server.h"
 #include "environment.h"
 #include "player.h"
+#include "filesys.h"
+#include "util/string.h"
+#include <ctime>
 
 // request_shutdown()
 int ModApiServer::l_request_shutdown(lua_State *L)
@@ -170,6 +173,39 @@ int ModApiServer::l_unban_player_or_ip(lua_State *L)
 	return 1;
 }
 
+// snapshot_world([name])
+// Snapshots the world into <worldpath>/snapshots/<name>; name defaults to
+// the current date and time
+int ModApiServer::l_snapshot_world(lua_State *L)
+{
+	std::string name;
+	if(lua_isnoneornil(L, 1)) {
+		char buf[32];
+		time_t t = time(NULL);
+		strftime(buf, sizeof(buf), "%Y%m%d-%H%M%S", localtime(&t));
+		name = buf;
+	} else {
+		name = luaL_checkstring(L, 1);
+	}
+	if(name.empty() || !string_allowed(name, PLAYERNAME_ALLOWED_CHARS)) {
+		lua_pushnil(L);
+		lua_pushstring(L, "Invalid snapshot name");
+		return 2;
+	}
+
+	Server *server = getServer(L);
+	std::string target_dir = server->getWorldPath() + DIR_DELIM
+			+ "snapshots" + DIR_DELIM + name;
+	std::string error;
+	if(!server->snapshotWorld(target_dir, error)) {
+		lua_pushnil(L);
+		lua_pushstring(L, error.c_str());
+		return 2;
+	}
+	lua_pushstring(L, target_dir.c_str());
+	return 1;
+}
+
 // show_formspec(playername,formname,formspec)
 int ModApiServer::l_show_formspec(lua_State *L)
 {
@@ -344,5 +380,6 @@ void ModApiServer::Initialize(lua_State *L, int top)
 	API_FCT(get_ban_description);
 	API_FCT(ban_player);
 	API_FCT(unban_player_or_ip);
+	API_FCT(snapshot_world);
 	API_FCT(notify_authentication_modified);
 }
@@ -82,6 +82,9 @@ class ModApiServer : public ModApiBase {
 	// notify_authentication_modified(name)
 	static int l_notify_authentication_modified(lua_State *L);
 
+	// snapshot_world([name])
+	static int l_snapshot_world(lua_State *L);
+
 public:
 	static void Initialize(lua_State *L, int top);
 
@@ -27,6 +27,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "settings.h"
 #include "main.h"  //required for g_settings, g_settings_path
 #include "json/json.h"
+#include <math.h>
+#include <string.h>
+#include <limits>
 
 // debug(...)
 // Writes a line to dstream
@@ -236,6 +239,293 @@ int ModApiUtil::l_is_yes(lua_State *L)
 	return 1;
 }
 
+/*
+	Format of serialize()/deserialize():
+
+	SERIALIZE_HEADER followed by one value:
+	  n                  nil
+	  T / F              true / false
+	  i<decimal>;        integral number
+	  d<16 hex digits>   other finite number, as the bits of the double
+	  I / J / N          +inf / -inf / nan
+	  s<length>:<bytes>  string
+	  {<key><value>...}  table
+	  r<id>;             table written before, counting tables from 1 in
+	                     the order their '{' appears (shared parts, cycles)
+*/
+#define SERIALIZE_HEADER "MTS1:"
+#define SERIALIZE_MAX_DEPTH 256
+
+static void serialize_uint(std::string &out, char tag, u64 value, char end)
+{
+	char buf[24];
+	int i = sizeof(buf);
+	do {
+		buf[--i] = '0' + value % 10;
+		value /= 10;
+	} while(value != 0);
+	out += tag;
+	out.append(buf + i, sizeof(buf) - i);
+	out += end;
+}
+
+// seen is a table mapping the tables written so far to their ids
+static bool serialize_value(lua_State *L, int index, int seen, u32 &next_id,
+		std::string &out, std::string &error, int depth)
+{
+	switch(lua_type(L, index)) {
+	case LUA_TNIL:
+		out += 'n';
+		return true;
+	case LUA_TBOOLEAN:
+		out += lua_toboolean(L, index) ? 'T' : 'F';
+		return true;
+	case LUA_TNUMBER: {
+		double x = lua_tonumber(L, index);
+		if(x != x) {
+			out += 'N';
+		} else if(x == std::numeric_limits<double>::infinity()) {
+			out += 'I';
+		} else if(x == -std::numeric_limits<double>::infinity()) {
+			out += 'J';
+		} else if(x == floor(x) && fabs(x) < 9007199254740992.0) {
+			if(x < 0) {
+				out += 'i';
+				serialize_uint(out, '-', -x, ';');
+			} else {
+				serialize_uint(out, 'i', x, ';');
+			}
+		} else {
+			// Bits of the double, so that it survives exactly and
+			// doesn't depend on the locale
+			u64 bits;
+			memcpy(&bits, &x, sizeof(bits));
+			static const char hex[] = "0123456789abcdef";
+			out += 'd';
+			for(int i = 60; i >= 0; i -= 4)
+				out += hex[(bits >> i) & 0xf];
+		}
+		return true;
+	}
+	case LUA_TSTRING: {
+		size_t len;
+		const char *s = lua_tolstring(L, index, &len);
+		serialize_uint(out, 's', len, ':');
+		out.append(s, len);
+		return true;
+	}
+	case LUA_TTABLE: {
+		lua_pushvalue(L, index);
+		lua_rawget(L, seen);
+		if(!lua_isnil(L, -1)) {
+			serialize_uint(out, 'r', lua_tointeger(L, -1), ';');
+			lua_pop(L, 1);
+			return true;
+		}
+		lua_pop(L, 1);
+		if(depth >= SERIALIZE_MAX_DEPTH || !lua_checkstack(L, 4)) {
+			error = "Tables are nested too deeply to serialize";
+			return false;
+		}
+		lua_pushvalue(L, index);
+		lua_pushinteger(L, ++next_id);
+		lua_rawset(L, seen);
+		out += '{';
+		lua_pushnil(L);
+		while(lua_next(L, index) != 0) {
+			int value = lua_gettop(L);
+			if(!serialize_value(L, value - 1, seen, next_id, out, error,
+					depth + 1) ||
+					!serialize_value(L, value, seen, next_id, out, error,
+					depth + 1)) {
+				lua_pop(L, 2);
+				return false;
+			}
+			lua_pop(L, 1);
+		}
+		out += '}';
+		return true;
+	}
+	default:
+		error = std::string("Can't serialize data of type ") +
+				luaL_typename(L, index);
+		return false;
+	}
+}
+
+static bool deserialize_uint(const char *&p, const char *end, char term,
+		u64 &result)
+{
+	result = 0;
+	int digits = 0;
+	for(;;) {
+		if(p == end)
+			return false;
+		char c = *p++;
+		if(c == term)
+			return digits != 0;
+		if(c < '0' || c > '9' || ++digits > 16)
+			return false;
+		result = result * 10 + (c - '0');
+	}
+}
+
+// Pushes the value on success; on failure the stack is left as it was.
+// refs is a table of the tables read so far, by id.
+static bool deserialize_value(lua_State *L, const char *&p, const char *end,
+		int refs, u32 &next_id, int depth)
+{
+	if(p == end)
+		return false;
+	u64 n;
+	switch(*p++) {
+	case 'n':
+		lua_pushnil(L);
+		return true;
+	case 'T':
+		lua_pushboolean(L, 1);
+		return true;
+	case 'F':
+		lua_pushboolean(L, 0);
+		return true;
+	case 'I':
+		lua_pushnumber(L, std::numeric_limits<double>::infinity());
+		return true;
+	case 'J':
+		lua_pushnumber(L, -std::numeric_limits<double>::infinity());
+		return true;
+	case 'N':
+		lua_pushnumber(L, std::numeric_limits<double>::quiet_NaN());
+		return true;
+	case 'i': {
+		bool negative = (p != end && *p == '-');
+		if(negative)
+			p++;
+		if(!deserialize_uint(p, end, ';', n))
+			return false;
+		lua_pushnumber(L, negative ? -(double)n : (double)n);
+		return true;
+	}
+	case 'd': {
+		if(end - p < 16)
+			return false;
+		u64 bits = 0;
+		for(int i = 0; i < 16; i++) {
+			char c = *p++;
+			int v;
+			if(c >= '0' && c <= '9')
+				v = c - '0';
+			else if(c >= 'a' && c <= 'f')
+				v = c - 'a' + 10;
+			else
+				return false;
+			bits = (bits << 4) | v;
+		}
+		double x;
+		memcpy(&x, &bits, sizeof(x));
+		lua_pushnumber(L, x);
+		return true;
+	}
+	case 's':
+		if(!deserialize_uint(p, end, ':', n) || n > (u64)(end - p))
+			return false;
+		lua_pushlstring(L, p, n);
+		p += n;
+		return true;
+	case 'r':
+		if(!deserialize_uint(p, end, ';', n) || n == 0 || n > next_id)
+			return false;
+		lua_rawgeti(L, refs, n);
+		return true;
+	case '{':
+		if(depth >= SERIALIZE_MAX_DEPTH || !lua_checkstack(L, 4))
+			return false;
+		lua_newtable(L);
+		lua_pushvalue(L, -1);
+		lua_rawseti(L, refs, ++next_id);
+		for(;;) {
+			if(p == end) {
+				lua_pop(L, 1);
+				return false;
+			}
+			if(*p == '}') {
+				p++;
+				return true;
+			}
+			if(!deserialize_value(L, p, end, refs, next_id, depth + 1)) {
+				lua_pop(L, 1);
+				return false;
+			}
+			// nil and nan can't be keys
+			if(lua_isnil(L, -1) || (lua_type(L, -1) == LUA_TNUMBER &&
+					lua_tonumber(L, -1) != lua_tonumber(L, -1)) ||
+					!deserialize_value(L, p, end, refs, next_id,
+					depth + 1)) {
+				lua_pop(L, 2);
+				return false;
+			}
+			lua_rawset(L, -3);
+		}
+	default:
+		return false;
+	}
+}
+
+// serialize(value) -> string, in the format described above
+int ModApiUtil::l_serialize(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	lua_settop(L, 1);
+	lua_newtable(L); // Tables written so far
+	bool success;
+	{
+		std::string out = SERIALIZE_HEADER;
+		std::string error;
+		u32 next_id = 0;
+		success = serialize_value(L, 1, 2, next_id, out, error, 0);
+		if(success)
+			lua_pushlstring(L, out.c_str(), out.size());
+		else
+			lua_pushlstring(L, error.c_str(), error.size());
+	}
+	// lua_error doesn't return, so it's only called once the strings
+	// above are destroyed
+	if(!success)
+		return lua_error(L);
+	return 1;
+}
+
+// deserialize(string) -> value
+int ModApiUtil::l_deserialize(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	size_t len = 0;
+	const char *data = lua_tolstring(L, 1, &len);
+	size_t header_len = strlen(SERIALIZE_HEADER);
+	if(data == NULL || len < header_len ||
+			memcmp(data, SERIALIZE_HEADER, header_len) != 0) {
+		lua_pushnil(L);
+		lua_pushstring(L, "Unsupported data format");
+		return 2;
+	}
+	lua_settop(L, 1);
+	lua_newtable(L); // Tables read so far
+	const char *p = data + header_len;
+	const char *end = data + len;
+	u32 next_id = 0;
+	if(!deserialize_value(L, p, end, 2, next_id, 0)) {
+		lua_pushnil(L);
+		lua_pushfstring(L, "Invalid data at offset %d", (int)(p - data));
+		return 2;
+	}
+	if(p != end) {
+		lua_pushnil(L);
+		lua_pushstring(L, "Trailing data");
+		return 2;
+	}
+	return 1;
+}
+
 void ModApiUtil::Initialize(lua_State *L, int top)
 {
 	API_FCT(debug);
@@ -255,5 +545,8 @@ void ModApiUtil::Initialize(lua_State *L, int top)
 	API_FCT(get_password_hash);
 
 	API_FCT(is_yes);
+
+	API_FCT(serialize);
+	API_FCT(deserialize);
 }
 
@@ -74,6 +74,15 @@ class ModApiUtil : public ModApiBase {
 	// is_yes(arg)
 	static int l_is_yes(lua_State *L);
 
+	// serialize(value) -> string
+	// builtin/serialize.lua uses it for minetest.serialize(value, "mts")
+	static int l_serialize(lua_State *L);
+
+	// deserialize(string) -> value or nil, error message
+	// Only reads the format written by serialize(); builtin/serialize.lua
+	// handles the Lua source format
+	static int l_deserialize(lua_State *L);
+
 public:
 	static void Initialize(lua_State *L, int top);
 
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include "clientserver.h"
 #include "ban.h"
+#include "servertrace.h"
 #include "environment.h"
 #include "map.h"
 #include "jthread/jmutexautolock.h"
@@ -534,6 +535,18 @@ void RemoteClient::GetNextBlocks(Server *server, float dtime,
 	      continue;
 	    }
 
+	  /*
+	    Hold back blocks that are likely to be changed again by the
+	    generation of their neighbours, unless the player is in them.
+	    Come back to them like to the ones being emerged.
+	  */
+	  if(d > 0 && server->isBlockSettling(p))
+	    {
+	      if(nearest_emerged_d == -1)
+		nearest_emerged_d = d;
+	      continue;
+	    }
+
 	  if(nearest_sent_d == -1)
 	    nearest_sent_d = d;
 
@@ -613,7 +626,10 @@ void RemoteClient::SetBlockNotSent(v3s16 p)
   if(m_blocks_sending.find(p) != m_blocks_sending.end())
     m_blocks_sending.erase(p);
   if(m_blocks_sent.find(p) != m_blocks_sent.end())
-    m_blocks_sent.erase(p);
+    {
+      m_blocks_sent.erase(p);
+      g_profiler->add("Server: sent blocks to resend (num)", 1);
+    }
 }
 
 void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
@@ -629,7 +645,10 @@ void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
       if(m_blocks_sending.find(p) != m_blocks_sending.end())
 	m_blocks_sending.erase(p);
       if(m_blocks_sent.find(p) != m_blocks_sent.end())
-	m_blocks_sent.erase(p);
+	{
+	  m_blocks_sent.erase(p);
+	  g_profiler->add("Server: sent blocks to resend (num)", 1);
+	}
     }
 }
 
@@ -637,6 +656,88 @@ void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
   Server
 */
 
+/*
+	Item, node and craft definitions, shared by the servers of the process
+	that run the same game. Every server still runs the mods in its own Lua
+	state and fills its own managers; if they come out identical to those
+	of a server already running the game, it drops them and uses the
+	shared ones, so that extra worlds don't keep a copy of each.
+*/
+class SharedDefinitions
+{
+public:
+  SharedDefinitions()
+  {
+    m_mutex.Init();
+  }
+
+  /*
+    Replaces the managers by the shared ones of the game if the
+    fingerprint matches and returns true; the caller then deletes the
+    ones it passed. Otherwise the first server of a game has its
+    managers shared from now on, and returns false.
+  */
+  bool share(const std::string &gameid, const std::string &fingerprint,
+	     IWritableItemDefManager *&itemdef,
+	     IWritableNodeDefManager *&nodedef,
+	     IWritableCraftDefManager *&craftdef)
+  {
+    JMutexAutoLock lock(m_mutex);
+    std::map<std::string, Entry>::iterator i = m_games.find(gameid);
+    if(i == m_games.end())
+      {
+	Entry &e = m_games[gameid];
+	e.fingerprint = fingerprint;
+	e.itemdef = itemdef;
+	e.nodedef = nodedef;
+	e.craftdef = craftdef;
+	e.refcount = 1;
+	return false;
+      }
+    Entry &e = i->second;
+    if(e.fingerprint != fingerprint)
+      return false;
+    itemdef = e.itemdef;
+    nodedef = e.nodedef;
+    craftdef = e.craftdef;
+    e.refcount++;
+    return true;
+  }
+
+  // Returns true if the caller has to delete the managers
+  bool release(IWritableItemDefManager *itemdef)
+  {
+    JMutexAutoLock lock(m_mutex);
+    for(std::map<std::string, Entry>::iterator i = m_games.begin();
+	i != m_games.end(); ++i)
+      {
+	if(i->second.itemdef != itemdef)
+	  continue;
+	if(--i->second.refcount != 0)
+	  return false;
+	m_games.erase(i);
+	return true;
+      }
+    // Not shared
+    return true;
+  }
+
+private:
+  struct Entry
+  {
+    std::string fingerprint;
+    IWritableItemDefManager *itemdef;
+    IWritableNodeDefManager *nodedef;
+    IWritableCraftDefManager *craftdef;
+    u32 refcount;
+  };
+
+  JMutex m_mutex;
+  std::map<std::string, Entry> m_games;
+};
+
+static SharedDefinitions g_shared_definitions;
+
 Server::Server(
 	       const std::string &path_world,
 	       const SubgameSpec &gamespec,
@@ -650,6 +751,7 @@ Server::Server(
   m_con(PROTOCOL_ID, 512, CONNECTION_TIMEOUT,
 	g_settings->getBool("enable_ipv6") && g_settings->getBool("ipv6_server"), this),
   m_banmanager(NULL),
+  m_trace_recorder(NULL),
   m_rollback(NULL),
   m_rollback_sink_enabled(true),
   m_enable_rollback_recording(false),
@@ -816,6 +918,35 @@ Server::Server(
   // Apply item aliases in the node definition manager
   m_nodedef->updateAliases(m_itemdef);
   
+  // Use the definitions of another world running the same game if the
+  // mods defined the same things
+  {
+    std::ostringstream os(std::ios_base::binary);
+    m_itemdef->serialize(os, LATEST_PROTOCOL_VERSION);
+    m_nodedef->serialize(os, LATEST_PROTOCOL_VERSION);
+    os<<m_craftdef->dump();
+    SHA1 sha1;
+    sha1.addBytes(os.str().c_str(), os.str().length());
+    unsigned char *digest = sha1.getDigest();
+    std::string fingerprint((char*)digest, 20);
+    free(digest);
+
+    IWritableItemDefManager *itemdef = m_itemdef;
+    IWritableNodeDefManager *nodedef = m_nodedef;
+    IWritableCraftDefManager *craftdef = m_craftdef;
+    if(g_shared_definitions.share(m_gamespec.id, fingerprint,
+				  m_itemdef, m_nodedef, m_craftdef))
+      {
+	infostream<<"Server: Using the definitions shared by the other "
+		  <<"worlds of game \""<<m_gamespec.id<<"\""<<std::endl;
+	delete itemdef;
+	delete nodedef;
+	delete craftdef;
+	// The emerge manager took the node definitions when it was created
+	m_emerge->ndef = m_nodedef;
+      }
+  }
+  
   // Initialize Environment
   ServerMap *servermap = new ServerMap(path_world, this, m_emerge);
   m_env = new ServerEnvironment(servermap, m_script, this, m_emerge);
@@ -939,11 +1070,15 @@ Server::~Server()
   // Delete things in the reverse order of creation
   delete m_env;
   delete m_rollback;
+  delete m_trace_recorder;
   delete m_banmanager;
   delete m_event;
-  delete m_itemdef;
-  delete m_nodedef;
-  delete m_craftdef;
+  if(g_shared_definitions.release(m_itemdef))
+    {
+      delete m_itemdef;
+      delete m_nodedef;
+      delete m_craftdef;
+    }
   
   // Deinitialize scripting
   infostream<<"Server: Deinitializing scripting"<<std::endl;
@@ -1014,6 +1149,8 @@ void Server::step(float dtime)
     JMutexAutoLock lock(m_step_dtime_mutex);
     m_step_dtime += dtime;
   }
+  if(m_trace_recorder)
+    m_trace_recorder->step(dtime);
   // Throw if fatal error occurred in thread
   std::string async_err = m_async_fatal_error.get();
   if(async_err != ""){
@@ -1021,6 +1158,26 @@ void Server::step(float dtime)
   }
 }
 
+float Server::getPendingStepDtime()
+{
+  JMutexAutoLock lock(m_step_dtime_mutex);
+  return m_step_dtime;
+}
+
+bool Server::startTraceRecording(const std::string &path, u32 rand_seed)
+{
+  assert(m_trace_recorder == NULL);
+  m_trace_recorder = new ServerTraceRecorder(path, rand_seed);
+  if(!m_trace_recorder->isOpen())
+    {
+      delete m_trace_recorder;
+      m_trace_recorder = NULL;
+      return false;
+    }
+  actionstream<<"Server: Recording a trace to "<<path<<std::endl;
+  return true;
+}
+
 void Server::AsyncRunStep()
 {
   DSTACK(__FUNCTION_NAME);
@@ -1184,6 +1341,15 @@ void Server::AsyncRunStep()
 	  SendInventory(client->peer_id);
 	}
       }
+
+    /*
+      Send modified detached inventories
+    */
+    for(std::set<std::string>::iterator
+	  i = m_detached_inventories_modified.begin();
+	i != m_detached_inventories_modified.end(); ++i)
+      sendDetachedInventoryToAll(*i);
+    m_detached_inventories_modified.clear();
   }
 
   /* Transform liquids */
@@ -1605,6 +1771,11 @@ void Server::AsyncRunStep()
 	      sendRemoveNode(event->p, event->already_known_by_peer,
 			     &far_players, 30);
 	  }
+	else if(event->type == MEET_NODEMETA_CHANGED)
+	  {
+	    prof.add("MEET_NODEMETA_CHANGED", 1);
+	    m_nodemeta_modified.insert(event->p);
+	  }
 	else if(event->type == MEET_BLOCK_NODE_METADATA_CHANGED)
 	  {
 	    infostream<<"Server: MEET_BLOCK_NODE_METADATA_CHANGED"<<std::endl;
@@ -1671,7 +1842,8 @@ void Server::AsyncRunStep()
       verbosestream<<"Server: MapEditEvents:"<<std::endl;
       prof.print(verbosestream);
     }
-    
+
+    sendNodeMetadataChanges();
   }
 
   /*
@@ -1725,17 +1897,23 @@ void Server::Receive()
   DSTACK(__FUNCTION_NAME);
   SharedBuffer<u8> data;
   u16 peer_id;
+  u8 channelnum;
+  bool reliable;
   u32 datasize;
   try{
     {
       JMutexAutoLock conlock(m_con_mutex);
-      datasize = m_con.Receive(peer_id, data);
+      datasize = m_con.Receive(peer_id, data, channelnum, reliable);
     }
     
     // This has to be called so that the client list gets synced
     // with the peer list of the connection
     handlePeerChanges();
 
+    if(m_trace_recorder)
+      m_trace_recorder->packet(peer_id, channelnum, reliable,
+			       *data, datasize);
+
     ProcessData(*data, datasize, peer_id);
   }
   catch(con::InvalidIncomingDataException &e)
@@ -2084,12 +2262,13 @@ void Server::ProcessData(u8 *data, u32 datasize, u16 peer_id)
 	    Answer with a TOCLIENT_INIT
 	  */
 	  {
-	    SharedBuffer<u8> reply(2+1+6+8+4);
+	    SharedBuffer<u8> reply(2+1+6+8+4+2);
 	    writeU16(&reply[0], TOCLIENT_INIT);
 	    writeU8(&reply[2], deployed);
 	    writeV3S16(&reply[2+1], floatToInt(playersao->getPlayer()->getPosition()+v3f(0,BS/2,0), BS));
 	    writeU64(&reply[2+1+6], m_env->getServerMap().getSeed());
 	    writeF1000(&reply[2+1+6+8], g_settings->getFloat("dedicated_server_step"));
+	    writeU16(&reply[2+1+6+8+4], getClient(peer_id)->net_proto_version);
 
 	    // Send as reliable
 	    m_con.Send(peer_id, 0, reply, true);
@@ -2403,129 +2582,48 @@ void Server::ProcessData(u8 *data, u32 datasize, u16 peer_id)
 	  RollbackScopeActor rollback_scope(m_rollback,
 					    std::string("player:")+player->getName());
 	  
-	  /*
-	    Note: Always set inventory not sent, to repair cases
-	    where the client made a bad prediction.
-	  */
-	  
-	  /*
-	    Handle restrictions and special cases of the move action
-	  */
-	  if(a->getType() == IACTION_MOVE)
+	  // Do the action
+	  if(checkInventoryAction(a, player))
+	    a->apply(this, playersao, this);
+	  // Eat the action
+	  delete a;
+	}
+      else if(command == TOSERVER_INVENTORY_ACTIONS)
+	{
+	  std::string datastring((char*)&data[2], datasize-2);
+	  std::istringstream is(datastring, std::ios_base::binary);
+	  std::vector<InventoryAction*> actions;
+	  try
 	    {
-	      IMoveAction *ma = (IMoveAction*)a;
-	      
-	      ma->from_inv.applyCurrentPlayer(player->getName());
-	      ma->to_inv.applyCurrentPlayer(player->getName());
-	      
-	      setInventoryModified(ma->from_inv);
-	      setInventoryModified(ma->to_inv);
-	      
-	      bool from_inv_is_current_player =
-		(ma->from_inv.type == InventoryLocation::PLAYER) &&
-		(ma->from_inv.name == player->getName());
-	      
-	      bool to_inv_is_current_player =
-		(ma->to_inv.type == InventoryLocation::PLAYER) &&
-		(ma->to_inv.name == player->getName());
-	      
-	      /*
-		Disable moving items out of craftpreview
-	      */
-	      if(ma->from_list == "craftpreview")
-		{
-		  infostream<<"Ignoring IMoveAction from "
-			    <<(ma->from_inv.dump())<<":"<<ma->from_list
-			    <<" to "<<(ma->to_inv.dump())<<":"<<ma->to_list
-			    <<" because src is "<<ma->from_list<<std::endl;
-		  delete a;
-		  return;
-		}
-	      
-	      /*
-		Disable moving items into craftresult and craftpreview
-	      */
-	      if(ma->to_list == "craftpreview" || ma->to_list == "craftresult")
-		{
-		  infostream<<"Ignoring IMoveAction from "
-			    <<(ma->from_inv.dump())<<":"<<ma->from_list
-			    <<" to "<<(ma->to_inv.dump())<<":"<<ma->to_list
-			    <<" because dst is "<<ma->to_list<<std::endl;
-		  delete a;
-		  return;
-		}
-	      
-	      // Disallow moving items in elsewhere than player's inventory
-	      // if not allowed to interact
-	      if(!checkPriv(player->getName(), "interact") &&
-		 (!from_inv_is_current_player ||
-		  !to_inv_is_current_player))
+	      u16 count = readU16(is);
+	      for(u16 i=0; i<count; i++)
 		{
-		  infostream<<"Cannot move outside of player's inventory: "
-			    <<"No interact privilege"<<std::endl;
-		  delete a;
-		  return;
+		  InventoryAction *a = InventoryAction::deSerializeBinary(is);
+		  if(a == NULL)
+		    {
+		      infostream<<"TOSERVER_INVENTORY_ACTIONS: "
+				<<"unknown action type"<<std::endl;
+		      break;
+		    }
+		  actions.push_back(a);
 		}
 	    }
-	  /*
-	    Handle restrictions and special cases of the drop action
-	  */
-	  else if(a->getType() == IACTION_DROP)
+	  catch(SerializationError &e)
 	    {
-	      IDropAction *da = (IDropAction*)a;
-	      
-	      da->from_inv.applyCurrentPlayer(player->getName());
-	      
-	      setInventoryModified(da->from_inv);
-	      
-	      /*
-		Disable dropping items out of craftpreview
-	      */
-	      if(da->from_list == "craftpreview")
-		{
-		  infostream<<"Ignoring IDropAction from "
-			    <<(da->from_inv.dump())<<":"<<da->from_list
-			    <<" because src is "<<da->from_list<<std::endl;
-		  delete a;
-		  return;
-		}
-	      
-	      // Disallow dropping items if not allowed to interact
-	      if(!checkPriv(player->getName(), "interact"))
-		{
-		  delete a;
-		  return;
-		}
+	      infostream<<"TOSERVER_INVENTORY_ACTIONS: "<<e.what()<<std::endl;
 	    }
-	  /*
-	    Handle restrictions and special cases of the craft action
-	  */
-	  else if(a->getType() == IACTION_CRAFT)
+	  InventoryAction::coalesce(actions);
+	  
+	  // If something goes wrong, this player is to blame
+	  RollbackScopeActor rollback_scope(m_rollback,
+					    std::string("player:")+player->getName());
+	  
+	  for(u32 i=0; i<actions.size(); i++)
 	    {
-	      ICraftAction *ca = (ICraftAction*)a;
-	      
-	      ca->craft_inv.applyCurrentPlayer(player->getName());
-	      
-	      setInventoryModified(ca->craft_inv);
-	      
-	      //bool craft_inv_is_current_player =
-	      //	(ca->craft_inv.type == InventoryLocation::PLAYER) &&
-	      //	(ca->craft_inv.name == player->getName());
-	      
-	      // Disallow crafting if not allowed to interact
-	      if(!checkPriv(player->getName(), "interact"))
-		{
-		  infostream<<"Cannot craft: "
-			    <<"No interact privilege"<<std::endl;
-		  delete a;
-		  return;
-		}
+	      if(checkInventoryAction(actions[i], player))
+		actions[i]->apply(this, playersao, this);
+	      delete actions[i];
 	    }
-	  
-	  // Do the action
-	  a->apply(this, playersao, this);
-	  // Eat the action
-	  delete a;
 	}
       else if(command == TOSERVER_CHAT_MESSAGE)
 	{
@@ -3219,6 +3317,117 @@ void Server::ProcessData(u8 *data, u32 datasize, u16 peer_id)
     }
 }
 
+bool Server::checkInventoryAction(InventoryAction *a, Player *player)
+{
+  /*
+    Note: Always set inventory not sent, to repair cases
+    where the client made a bad prediction.
+  */
+
+  /*
+    Handle restrictions and special cases of the move action
+  */
+  if(a->getType() == IACTION_MOVE)
+    {
+      IMoveAction *ma = (IMoveAction*)a;
+
+      ma->from_inv.applyCurrentPlayer(player->getName());
+      ma->to_inv.applyCurrentPlayer(player->getName());
+
+      setInventoryModified(ma->from_inv);
+      setInventoryModified(ma->to_inv);
+
+      bool from_inv_is_current_player =
+	(ma->from_inv.type == InventoryLocation::PLAYER) &&
+	(ma->from_inv.name == player->getName());
+
+      bool to_inv_is_current_player =
+	(ma->to_inv.type == InventoryLocation::PLAYER) &&
+	(ma->to_inv.name == player->getName());
+
+      /*
+	Disable moving items out of craftpreview
+      */
+      if(ma->from_list == "craftpreview")
+	{
+	  infostream<<"Ignoring IMoveAction from "
+		    <<(ma->from_inv.dump())<<":"<<ma->from_list
+		    <<" to "<<(ma->to_inv.dump())<<":"<<ma->to_list
+		    <<" because src is "<<ma->from_list<<std::endl;
+	  return false;
+	}
+
+      /*
+	Disable moving items into craftresult and craftpreview
+      */
+      if(ma->to_list == "craftpreview" || ma->to_list == "craftresult")
+	{
+	  infostream<<"Ignoring IMoveAction from "
+		    <<(ma->from_inv.dump())<<":"<<ma->from_list
+		    <<" to "<<(ma->to_inv.dump())<<":"<<ma->to_list
+		    <<" because dst is "<<ma->to_list<<std::endl;
+	  return false;
+	}
+
+      // Disallow moving items in elsewhere than player's inventory
+      // if not allowed to interact
+      if(!checkPriv(player->getName(), "interact") &&
+	 (!from_inv_is_current_player ||
+	  !to_inv_is_current_player))
+	{
+	  infostream<<"Cannot move outside of player's inventory: "
+		    <<"No interact privilege"<<std::endl;
+	  return false;
+	}
+    }
+  /*
+    Handle restrictions and special cases of the drop action
+  */
+  else if(a->getType() == IACTION_DROP)
+    {
+      IDropAction *da = (IDropAction*)a;
+
+      da->from_inv.applyCurrentPlayer(player->getName());
+
+      setInventoryModified(da->from_inv);
+
+      /*
+	Disable dropping items out of craftpreview
+      */
+      if(da->from_list == "craftpreview")
+	{
+	  infostream<<"Ignoring IDropAction from "
+		    <<(da->from_inv.dump())<<":"<<da->from_list
+		    <<" because src is "<<da->from_list<<std::endl;
+	  return false;
+	}
+
+      // Disallow dropping items if not allowed to interact
+      if(!checkPriv(player->getName(), "interact"))
+	return false;
+    }
+  /*
+    Handle restrictions and special cases of the craft action
+  */
+  else if(a->getType() == IACTION_CRAFT)
+    {
+      ICraftAction *ca = (ICraftAction*)a;
+
+      ca->craft_inv.applyCurrentPlayer(player->getName());
+
+      setInventoryModified(ca->craft_inv);
+
+      // Disallow crafting if not allowed to interact
+      if(!checkPriv(player->getName(), "interact"))
+	{
+	  infostream<<"Cannot craft: "
+		    <<"No interact privilege"<<std::endl;
+	  return false;
+	}
+    }
+  return true;
+}
+
 void Server::setTimeOfDay(u32 time)
 {
   m_env->setTimeOfDay(time);
@@ -3302,12 +3511,14 @@ void Server::setInventoryModified(const InventoryLocation &loc)
       if(block)
 	block->raiseModified(MOD_STATE_WRITE_NEEDED);
 
-      setBlockNotSent(blockpos);
+      // Sent in AsyncRunStep, once for everything done to it in between
+      m_nodemeta_modified.insert(loc.p);
     }
     break;
   case InventoryLocation::DETACHED:
     {
-      sendDetachedInventoryToAll(loc.name);
+      // Sent in AsyncRunStep, once for everything done to it in between
+      m_detached_inventories_modified.insert(loc.name);
     }
     break;
   default:
@@ -4131,6 +4342,23 @@ void Server::sendAddNode(v3s16 p, MapNode n, u16 ignore_id,
     }
 }
 
+void Server::setBlocksSettling(std::map<v3s16, MapBlock*> &blocks)
+{
+  float settle_time = g_settings->getFloat("block_send_settle_time");
+  if(settle_time <= 0)
+    return;
+
+  for(std::map<v3s16, MapBlock*>::iterator
+	i = blocks.begin();
+      i != blocks.end(); ++i)
+    m_settling_blocks[i->first] = settle_time;
+}
+
+bool Server::isBlockSettling(v3s16 p)
+{
+  return m_settling_blocks.find(p) != m_settling_blocks.end();
+}
+
 void Server::setBlockNotSent(v3s16 p)
 {
   for(std::map<u16, RemoteClient*>::iterator
@@ -4205,6 +4433,18 @@ void Server::SendBlocks(float dtime)
 
   ScopeProfiler sp(g_profiler, "Server: sel and send blocks to clients");
 
+  // Release the settling blocks nothing has changed for long enough
+  for(std::map<v3s16, float>::iterator
+	i = m_settling_blocks.begin();
+      i != m_settling_blocks.end();)
+    {
+      i->second -= dtime;
+      if(i->second <= 0)
+	m_settling_blocks.erase(i++);
+      else
+	++i;
+    }
+
   std::vector<PrioritySortedBlockTransfer> queue;
 
   s32 total_sending = 0;
@@ -4271,6 +4511,41 @@ void Server::SendBlocks(float dtime)
     }
 }
 
+/*
+	Checksums of media files, shared by all servers of the process so that
+	worlds using the same mods don't read and hash the same files again
+*/
+class MediaChecksumCache
+{
+public:
+  MediaChecksumCache()
+  {
+    m_mutex.Init();
+  }
+
+  bool get(const std::string &path, std::string &sha1_digest)
+  {
+    JMutexAutoLock lock(m_mutex);
+    std::map<std::string, std::string>::iterator i = m_digests.find(path);
+    if(i == m_digests.end())
+      return false;
+    sha1_digest = i->second;
+    return true;
+  }
+
+  void set(const std::string &path, const std::string &sha1_digest)
+  {
+    JMutexAutoLock lock(m_mutex);
+    m_digests[path] = sha1_digest;
+  }
+
+private:
+  JMutex m_mutex;
+  std::map<std::string, std::string> m_digests;
+};
+
+static MediaChecksumCache g_media_checksums;
+
 void Server::fillMediaCache()
 {
   DSTACK(__FUNCTION_NAME);
@@ -4320,6 +4595,12 @@ void Server::fillMediaCache()
 	}
 	// Ok, attempt to load the file and add to cache
 	std::string filepath = mediapath + DIR_DELIM + filename;
+	// Another world of this process might have hashed it already
+	std::string sha1_cached;
+	if(g_media_checksums.get(filepath, sha1_cached)){
+	  this->m_media[filename] = MediaInfo(filepath, sha1_cached);
+	  continue;
+	}
 	// Read data
 	std::ifstream fis(filepath.c_str(), std::ios_base::binary);
 	if(fis.good() == false){
@@ -4362,6 +4643,7 @@ void Server::fillMediaCache()
 
 	// Put in list
 	this->m_media[filename] = MediaInfo(filepath, sha1_base64);
+	g_media_checksums.set(filepath, sha1_base64);
 	verbosestream<<"Server: "<<sha1_hex<<" is "<<filename<<std::endl;
       }
     }
@@ -4589,6 +4871,78 @@ void Server::sendDetachedInventoryToAll(const std::string &name)
   }
 }
 
+void Server::sendNodeMetadataChanges()
+{
+  DSTACK(__FUNCTION_NAME);
+
+  if(m_nodemeta_modified.empty())
+    return;
+
+  // Serialize each position once for all clients
+  std::map<v3s16, std::string> serialized;
+  for(std::set<v3s16>::iterator
+	i = m_nodemeta_modified.begin();
+      i != m_nodemeta_modified.end(); ++i)
+    {
+      std::ostringstream os(std::ios_base::binary);
+      writeV3S16(os, *i);
+      NodeMetadata *meta = m_env->getMap().getNodeMetadata(*i);
+      writeU8(os, meta ? 1 : 0);
+      if(meta)
+	meta->serialize(os, false);
+      serialized[*i] = os.str();
+    }
+  m_nodemeta_modified.clear();
+
+  for(std::map<u16, RemoteClient*>::iterator
+	i = m_clients.begin();
+      i != m_clients.end(); ++i)
+    {
+      RemoteClient *client = i->second;
+      if(client->serialization_version == SER_FMT_VER_INVALID)
+	continue;
+
+      // Older clients only get metadata with the whole block
+      if(client->net_proto_version < 22)
+	{
+	  for(std::map<v3s16, std::string>::iterator
+		j = serialized.begin(); j != serialized.end(); ++j)
+	    client->SetBlockNotSent(getNodeBlockPos(j->first));
+	  continue;
+	}
+
+      // Blocks the client doesn't have carry the metadata when sent
+      std::string data;
+      u16 count = 0;
+      for(std::map<v3s16, std::string>::iterator
+	    j = serialized.begin(); j != serialized.end(); ++j)
+	{
+	  if(!client->hasBlock(getNodeBlockPos(j->first)))
+	    continue;
+	  data += j->second;
+	  count++;
+	}
+      if(count == 0)
+	continue;
+
+      std::ostringstream uncompressed(std::ios_base::binary);
+      writeU16(uncompressed, count);
+      uncompressed<<data;
+      std::ostringstream compressed(std::ios_base::binary);
+      compressZlib(uncompressed.str(), compressed);
+
+      std::ostringstream os(std::ios_base::binary);
+      writeU16(os, TOCLIENT_NODEMETA_CHANGED);
+      os<<serializeLongString(compressed.str());
+
+      std::string s = os.str();
+      SharedBuffer<u8> reply((u8*)s.c_str(), s.size());
+      g_profiler->add("Server: node metadata sent (bytes)", s.size());
+      // Same channel as the block data, so that it arrives after the block
+      m_con.Send(client->peer_id, 1, reply, true);
+    }
+}
+
 void Server::sendDetachedInventories(u16 peer_id)
 {
   DSTACK(__FUNCTION_NAME);
@@ -5220,6 +5574,68 @@ bool Server::rollbackRevertActions(const std::list<RollbackAction> &actions,
   return num_failed <= num_tried/2;
 }
 
+bool Server::snapshotWorld(const std::string &target_dir, std::string &error)
+{
+  if(fs::PathExists(target_dir)){
+    error = "\"" + target_dir + "\" already exists";
+    return false;
+  }
+  if(!fs::CreateAllDirs(target_dir)){
+    error = "Cannot create \"" + target_dir + "\"";
+    return false;
+  }
+  if(!snapshotWorldTo(target_dir, error)){
+    // Don't leave a half written snapshot behind
+    fs::RecursiveDelete(target_dir);
+    return false;
+  }
+  return true;
+}
+
+bool Server::snapshotWorldTo(const std::string &target_dir, std::string &error)
+{
+  u32 time1 = porting::getTimeMs();
+
+  // Write out everything that is only in memory
+  if(m_banmanager->isModified())
+    m_banmanager->save();
+  m_env->getMap().save(MOD_STATE_WRITE_NEEDED);
+  m_env->serializePlayers(m_path_world);
+  m_env->saveMeta(m_path_world);
+  m_rollback->flush();
+
+  // The small files are simply copied
+  const char *files[] = {"world.mt", "map_meta.txt", "env_meta.txt",
+			 "auth.txt", "ipban.txt", "rollback.txt"};
+  for(u32 i=0; i<sizeof(files)/sizeof(files[0]); i++)
+    {
+      std::string path = m_path_world + DIR_DELIM + files[i];
+      if(fs::PathExists(path) &&
+	 !fs::CopyFileContents(path, target_dir + DIR_DELIM + files[i])){
+	error = std::string("Cannot copy ") + files[i];
+	return false;
+      }
+    }
+  std::string players_path = m_path_world + DIR_DELIM + "players";
+  if(fs::PathExists(players_path) &&
+     !fs::CopyDir(players_path, target_dir + DIR_DELIM + "players")){
+    error = "Cannot copy players";
+    return false;
+  }
+
+  if(!m_env->getServerMap().startBackup(target_dir)){
+    error = "The map database can't be snapshotted now (see the log; "
+      "sqlite3 needs sqlite_journal_mode = wal)";
+    return false;
+  }
+
+  u32 dtime = porting::getTimeMs() - time1;
+  g_profiler->avg("Server: world snapshot pause (ms)", dtime);
+  actionstream<<"Server: World snapshot to \""<<target_dir<<"\" started, "
+	      <<"server was paused for "<<dtime<<"ms"<<std::endl;
+  return true;
+}
+
 // IGameDef interface
 // Under envlock
 IItemDefManager* Server::getItemDefManager()
@@ -5445,6 +5861,9 @@ void Server::handlePeerChange(PeerChange &c)
       client->peer_id = c.peer_id;
       m_clients[client->peer_id] = client;
 
+      if(m_trace_recorder)
+	m_trace_recorder->peerAdded(c.peer_id);
+
     } // PEER_ADDED
   else if(c.type == PEER_REMOVED)
     {
@@ -5454,6 +5873,9 @@ void Server::handlePeerChange(PeerChange &c)
 
       DeleteClient(c.peer_id, c.timeout?CDR_TIMEOUT:CDR_LEAVE);
 
+      if(m_trace_recorder)
+	m_trace_recorder->peerRemoved(c.peer_id);
+
     } // PEER_REMOVED
   else
     {
@@ -5476,6 +5898,13 @@ void Server::handlePeerChanges()
 }
 
 void dedicated_server_loop(Server &server, bool &kill)
+{
+  std::vector<Server*> servers;
+  servers.push_back(&server);
+  dedicated_server_loop(servers, kill);
+}
+
+void dedicated_server_loop(const std::vector<Server*> &servers, bool &kill)
 {
   DSTACK(__FUNCTION_NAME);
 
@@ -5492,9 +5921,16 @@ void dedicated_server_loop(Server &server, bool &kill)
 	ScopeProfiler sp(g_profiler, "dedicated server sleep");
 	sleep_ms((int)(steplen*1000.0));
       }
-      server.step(steplen);
+      bool shutdown = kill;
+      for(std::vector<Server*>::const_iterator
+	    i = servers.begin(); i != servers.end(); ++i)
+	{
+	  (*i)->step(steplen);
+	  if((*i)->getShutdownRequested())
+	    shutdown = true;
+	}
 
-      if(server.getShutdownRequested() || kill)
+      if(shutdown)
 	{
 	  infostream<<"Dedicated server quitting"<<std::endl;
 #if USE_CURL
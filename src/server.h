@@ -36,6 +36,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <string>
 #include <list>
 #include <map>
+#include <set>
 #include <vector>
 
 #define PP(x) "("<<(x).X<<","<<(x).Y<<","<<(x).Z<<")"
@@ -50,6 +51,7 @@ class Player;
 class PlayerSAO;
 class IRollbackManager;
 class EmergeManager;
+class ServerTraceRecorder;
 class GameScripting;
 class ServerEnvironment;
 struct SimpleSoundSpec;
@@ -261,6 +263,13 @@ class RemoteClient
 	void SetBlockNotSent(v3s16 p);
 	void SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks);
 
+	// Whether the client has or is getting the block
+	bool hasBlock(v3s16 p)
+	{
+		return (m_blocks_sent.find(p) != m_blocks_sent.end() ||
+				m_blocks_sending.find(p) != m_blocks_sending.end());
+	}
+
 	s32 SendingCount()
 	{
 		return m_blocks_sending.size();
@@ -355,6 +364,11 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// This is mainly a way to pass the time to the server.
 	// Actual processing is done in an another thread.
 	void step(float dtime);
+	// Time passed to step() that the server thread hasn't processed yet
+	float getPendingStepDtime();
+	// Records everything clients send to a trace file (see servertrace.h).
+	// Call before start().
+	bool startTraceRecording(const std::string &path, u32 rand_seed);
 	// This is run by ServerThread and does the actual processing
 	void AsyncRunStep();
 	void Receive();
@@ -458,6 +472,14 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	bool rollbackRevertActions(const std::list<RollbackAction> &actions,
 			std::list<std::string> *log);
 
+	// Under envlock
+	// Save everything and copy the world into target_dir, which must
+	// not exist yet. The map blocks are copied in the background by
+	// the map database from the state they had when this was called.
+	// Return value: success/failure; on failure error is set and
+	// target_dir is removed again
+	bool snapshotWorld(const std::string &target_dir, std::string &error);
+
 	// IGameDef interface
 	// Under envlock
 	virtual IItemDefManager* getItemDefManager();
@@ -559,12 +581,20 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 			std::list<u16> *far_players=NULL, float far_d_nodes=100);
 	void setBlockNotSent(v3s16 p);
 
+	// Holds the blocks back from clients for block_send_settle_time
+	// (envlock should be locked when calling these)
+	void setBlocksSettling(std::map<v3s16, MapBlock*> &blocks);
+	bool isBlockSettling(v3s16 p);
+
 	// Environment and Connection must be locked when called
 	void SendBlockNoLock(u16 peer_id, MapBlock *block, u8 ver, u16 net_proto_version);
 
 	// Sends blocks to clients (locks env and con on its own)
 	void SendBlocks(float dtime);
 
+	// snapshotWorld() into the already created target_dir
+	bool snapshotWorldTo(const std::string &target_dir, std::string &error);
+
 	void fillMediaCache();
 	void sendMediaAnnouncement(u16 peer_id);
 	void sendRequestedMedia(u16 peer_id,
@@ -574,6 +604,10 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void sendDetachedInventoryToAll(const std::string &name);
 	void sendDetachedInventories(u16 peer_id);
 
+	// Sends the metadata in m_nodemeta_modified to the clients that have
+	// its block (env and con must be locked)
+	void sendNodeMetadataChanges();
+
 	// Adds a ParticleSpawner on peer with peer_id
 	void SendAddParticleSpawner(u16 peer_id, u16 amount, float spawntime,
 		v3f minpos, v3f maxpos,
@@ -643,6 +677,14 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	*/
 	PlayerSAO *emergePlayer(const char *name, u16 peer_id);
 
+	/*
+		Applies the per-player restrictions to an inventory action
+		received from a client and marks the touched inventories
+		modified. Returns false if the action must be dropped.
+		Call with env and con locked.
+	*/
+	bool checkInventoryAction(InventoryAction *a, Player *player);
+
 	// Locks environment and connection by its own
 	struct PeerChange;
 	void handlePeerChange(PeerChange &c);
@@ -690,6 +732,9 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// Ban checking
 	BanManager *m_banmanager;
 
+	// Trace of incoming data, if recording
+	ServerTraceRecorder *m_trace_recorder;
+
 	// Rollback manager (behind m_env_mutex)
 	IRollbackManager *m_rollback;
 	bool m_rollback_sink_enabled;
@@ -815,6 +860,20 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	*/
 	// key = name
 	std::map<std::string, Inventory*> m_detached_inventories;
+	// Modified since they were last sent; sent once per step
+	std::set<std::string> m_detached_inventories_modified;
+
+	/*
+		Node metadata positions modified since they were last sent;
+		sent once per step (behind m_env_mutex)
+	*/
+	std::set<v3s16> m_nodemeta_modified;
+
+	/*
+		Blocks just generated or relit, with the time left until they
+		are sent (behind m_env_mutex)
+	*/
+	std::map<v3s16, float> m_settling_blocks;
 
 	/*
 		Particles
@@ -828,6 +887,9 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	Shuts down when run is set to false.
 */
 void dedicated_server_loop(Server &server, bool &run);
+// Same for several servers hosting different worlds in one process.
+// All of them shut down when one of them does.
+void dedicated_server_loop(const std::vector<Server*> &servers, bool &run);
 
 #endif
 
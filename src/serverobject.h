@@ -152,6 +152,8 @@ class ServerActiveObject : public ActiveObject
 
 	virtual void setArmorGroups(const ItemGroupList &armor_groups)
 	{}
+	virtual int getArmorGroup(const std::string &name) const
+	{ return 0; }
 	virtual void setPhysicsOverride(float physics_override_speed, float physics_override_jump, float physics_override_gravity)
 	{}
 	virtual void setAnimation(v2f frames, float frame_speed, float frame_blend)
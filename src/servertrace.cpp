@@ -0,0 +1,336 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "servertrace.h"
+#include "jthread/jmutexautolock.h"
+#include "connection.h"
+#include "clientserver.h"
+#include "constants.h"
+#include "util/serialize.h"
+#include "filesys.h"
+#include "log.h"
+#include <sstream>
+#include <string.h>
+
+/*
+	ServerTraceRecorder
+*/
+
+ServerTraceRecorder::ServerTraceRecorder(const std::string &path,
+		u32 rand_seed):
+	m_os(path.c_str(), std::ios_base::binary | std::ios_base::trunc),
+	m_time(0)
+{
+	m_mutex.Init();
+
+	if(!m_os.good()){
+		errorstream<<"ServerTraceRecorder: Failed to open "
+				<<path<<std::endl;
+		return;
+	}
+
+	writeU32(m_os, SERVERTRACE_MAGIC);
+	writeU16(m_os, SERVERTRACE_VERSION);
+	writeU32(m_os, rand_seed);
+}
+
+ServerTraceRecorder::~ServerTraceRecorder()
+{
+	m_os.flush();
+}
+
+bool ServerTraceRecorder::isOpen()
+{
+	return m_os.good();
+}
+
+void ServerTraceRecorder::step(float dtime)
+{
+	JMutexAutoLock lock(m_mutex);
+	m_time += dtime;
+}
+
+void ServerTraceRecorder::peerAdded(u16 peer_id)
+{
+	JMutexAutoLock lock(m_mutex);
+	writeEventHeader(SERVERTRACE_PEER_ADDED, peer_id);
+}
+
+void ServerTraceRecorder::peerRemoved(u16 peer_id)
+{
+	JMutexAutoLock lock(m_mutex);
+	writeEventHeader(SERVERTRACE_PEER_REMOVED, peer_id);
+}
+
+void ServerTraceRecorder::packet(u16 peer_id, u8 channelnum, bool reliable,
+		const u8 *data, u32 size)
+{
+	// Blank out passwords
+	std::string masked;
+	u16 command = size >= 2 ? readU16(data) : 0;
+	if((command == TOSERVER_INIT && size >= 23 + PASSWORD_SIZE) ||
+			(command == TOSERVER_PASSWORD && size >= 2 + 2 * PASSWORD_SIZE)){
+		masked.assign((const char*)data, size);
+		if(command == TOSERVER_INIT)
+			memset(&masked[23], 0, PASSWORD_SIZE);
+		else
+			memset(&masked[2], 0, 2 * PASSWORD_SIZE);
+		data = (const u8*)masked.c_str();
+	}
+
+	JMutexAutoLock lock(m_mutex);
+	writeEventHeader(SERVERTRACE_PACKET, peer_id);
+	writeU8(m_os, channelnum);
+	writeU8(m_os, reliable);
+	writeU32(m_os, size);
+	m_os.write((const char*)data, size);
+}
+
+void ServerTraceRecorder::writeEventHeader(u8 type, u16 peer_id)
+{
+	writeU8(m_os, type);
+	writeU32(m_os, (u32)(m_time * 1000.0));
+	writeU16(m_os, peer_id);
+}
+
+/*
+	ServerTraceReplayer
+*/
+
+ServerTraceReplayer::ServerTraceReplayer(const std::string &path, u16 port):
+	m_path(path),
+	m_port(port),
+	m_version(0),
+	m_rand_seed(0),
+	m_time(0),
+	m_have_event(false),
+	m_event_type(0),
+	m_event_time_ms(0),
+	m_event_peer_id(0),
+	m_event_channelnum(0),
+	m_event_reliable(true),
+	m_events_replayed(0)
+{
+}
+
+ServerTraceReplayer::~ServerTraceReplayer()
+{
+	for(std::map<u16, con::Connection*>::iterator
+			i = m_peers.begin(); i != m_peers.end(); ++i)
+		delete i->second;
+}
+
+bool ServerTraceReplayer::open()
+{
+	m_is.open(m_path.c_str(), std::ios_base::binary);
+	if(!m_is.good()){
+		errorstream<<"ServerTraceReplayer: Failed to open "
+				<<m_path<<std::endl;
+		return false;
+	}
+
+	u32 magic = readU32(m_is);
+	m_version = readU16(m_is);
+	m_rand_seed = readU32(m_is);
+	if(!m_is.good() || magic != SERVERTRACE_MAGIC){
+		errorstream<<"ServerTraceReplayer: "<<m_path
+				<<" is not a server trace"<<std::endl;
+		return false;
+	}
+	if(m_version < 1 || m_version > SERVERTRACE_VERSION){
+		errorstream<<"ServerTraceReplayer: Unsupported trace version "
+				<<m_version<<std::endl;
+		return false;
+	}
+
+	m_have_event = readEvent();
+	return true;
+}
+
+bool ServerTraceReplayer::step(float dtime)
+{
+	m_time += dtime;
+
+	while(m_have_event && m_event_time_ms <= m_time * 1000.0){
+		replayEvent();
+		m_have_event = readEvent();
+	}
+
+	receiveAll();
+
+	return m_have_event;
+}
+
+bool ServerTraceReplayer::readEvent()
+{
+	m_event_type = readU8(m_is);
+	m_event_time_ms = readU32(m_is);
+	m_event_peer_id = readU16(m_is);
+	if(!m_is.good())
+		return false;
+
+	m_event_data.clear();
+	if(m_event_type == SERVERTRACE_PACKET){
+		m_event_channelnum = 0;
+		m_event_reliable = true;
+		if(m_version >= 2){
+			m_event_channelnum = readU8(m_is);
+			m_event_reliable = readU8(m_is) != 0;
+		}
+		u32 size = readU32(m_is);
+		if(!m_is.good())
+			return false;
+		m_event_data.resize(size);
+		if(size != 0)
+			m_is.read(&m_event_data[0], size);
+		if(m_is.gcount() != (std::streamsize)size){
+			errorstream<<"ServerTraceReplayer: Truncated packet at the end "
+					<<"of the trace"<<std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+void ServerTraceReplayer::replayEvent()
+{
+	m_events_replayed++;
+
+	std::map<u16, con::Connection*>::iterator i =
+			m_peers.find(m_event_peer_id);
+
+	switch(m_event_type){
+	case SERVERTRACE_PEER_ADDED: {
+		if(i != m_peers.end())
+			break;
+		con::Connection *con = new con::Connection(PROTOCOL_ID, 512,
+				CONNECTION_TIMEOUT, false);
+		con->SetTimeoutMs(0);
+		con->Connect(Address(127, 0, 0, 1, m_port));
+		m_peers[m_event_peer_id] = con;
+		break; }
+	case SERVERTRACE_PEER_REMOVED:
+		if(i == m_peers.end())
+			break;
+		// Let the connection tell the server before it goes away
+		i->second->Disconnect();
+		receiveAll();
+		delete i->second;
+		m_peers.erase(i);
+		break;
+	case SERVERTRACE_PACKET: {
+		if(i == m_peers.end() || m_event_data.size() < 2 ||
+				m_event_channelnum >= CHANNEL_COUNT)
+			break;
+		SharedBuffer<u8> data((const u8*)m_event_data.c_str(),
+				m_event_data.size());
+		i->second->Send(PEER_ID_SERVER, m_event_channelnum, data,
+				m_event_reliable);
+		ServerTracePacketStats &stats = m_sent[readU16(&data[0])];
+		stats.count++;
+		stats.bytes += data.getSize();
+		break; }
+	default:
+		errorstream<<"ServerTraceReplayer: Unknown event type "
+				<<(int)m_event_type<<std::endl;
+	}
+}
+
+void ServerTraceReplayer::receiveAll()
+{
+	for(std::map<u16, con::Connection*>::iterator
+			i = m_peers.begin(); i != m_peers.end(); ++i){
+		for(;;){
+			u16 peer_id;
+			SharedBuffer<u8> data;
+			u32 size;
+			try{
+				size = i->second->Receive(peer_id, data);
+			}
+			catch(con::NoIncomingDataException &e){
+				break;
+			}
+			catch(con::ConnectionException &e){
+				break;
+			}
+			if(size < 2)
+				continue;
+			ServerTracePacketStats &stats = m_received[readU16(&data[0])];
+			stats.count++;
+			stats.bytes += size;
+		}
+	}
+}
+
+void ServerTraceReplayer::printReport(std::ostream &os)
+{
+	os<<"Replayed "<<m_events_replayed<<" events over "
+			<<m_time<<"s of server time"<<std::endl;
+
+	os<<"Packets sent to the server (command: count, bytes):"<<std::endl;
+	for(std::map<u16, ServerTracePacketStats>::iterator
+			i = m_sent.begin(); i != m_sent.end(); ++i)
+		os<<"  0x"<<std::hex<<i->first<<std::dec<<": "
+				<<i->second.count<<", "<<i->second.bytes<<std::endl;
+
+	os<<"Packets received from the server (command: count, bytes):"
+			<<std::endl;
+	for(std::map<u16, ServerTracePacketStats>::iterator
+			i = m_received.begin(); i != m_received.end(); ++i)
+		os<<"  0x"<<std::hex<<i->first<<std::dec<<": "
+				<<i->second.count<<", "<<i->second.bytes<<std::endl;
+}
+
+bool ServerTraceReplayer::copyWorld(const std::string &world_path,
+		const std::string &copy_path)
+{
+	if(fs::PathExists(copy_path) && !fs::RecursiveDelete(copy_path)){
+		errorstream<<"ServerTraceReplayer: Failed to remove "
+				<<copy_path<<std::endl;
+		return false;
+	}
+	if(!fs::CopyDir(world_path, copy_path)){
+		errorstream<<"ServerTraceReplayer: Failed to copy "<<world_path
+				<<" to "<<copy_path<<std::endl;
+		return false;
+	}
+
+	// Lines are name:password:privileges
+	std::string auth_path = copy_path + DIR_DELIM + "auth.txt";
+	std::ifstream is(auth_path.c_str(), std::ios_base::binary);
+	if(!is.good())
+		return true;
+	std::ostringstream os(std::ios_base::binary);
+	std::string line;
+	while(std::getline(is, line)){
+		size_t p1 = line.find(':');
+		size_t p2 = p1 == std::string::npos ?
+				std::string::npos : line.find(':', p1 + 1);
+		if(p2 != std::string::npos)
+			line = line.substr(0, p1 + 1) + line.substr(p2);
+		os<<line<<"\n";
+	}
+	is.close();
+	if(!fs::safeWriteToFile(auth_path, os.str())){
+		errorstream<<"ServerTraceReplayer: Failed to write "
+				<<auth_path<<std::endl;
+		return false;
+	}
+	return true;
+}
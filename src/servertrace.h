@@ -0,0 +1,158 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SERVERTRACE_HEADER
+#define SERVERTRACE_HEADER
+
+#include "irrlichttypes.h"
+#include "jthread/jmutex.h"
+#include <fstream>
+#include <map>
+#include <string>
+
+/*
+	Server traces are recordings of everything the clients sent to a
+	server, with the server time at which it was received.  Replaying a
+	trace against a copy of the world the recording was started on
+	reproduces the load the server had.
+
+	Passwords in TOSERVER_INIT and TOSERVER_PASSWORD are blanked out
+	before they are written.  Everything else the players sent, like chat
+	and their names, is recorded as is.
+
+	Format (big endian):
+	u32 magic, u16 version, u32 random seed
+	events until the end of the file:
+		u8 type, u32 server time in ms, u16 peer id
+		for SERVERTRACE_PACKET:
+			u8 channel, u8 reliable (version 2 and later)
+			u32 size, size bytes of packet data
+	Version 1 packets were all replayed reliably on channel 0.
+*/
+
+#define SERVERTRACE_MAGIC 0x4d545452 // "MTTR"
+#define SERVERTRACE_VERSION 2
+
+enum ServerTraceEventType
+{
+	SERVERTRACE_PEER_ADDED = 1,
+	SERVERTRACE_PEER_REMOVED = 2,
+	SERVERTRACE_PACKET = 3
+};
+
+namespace con
+{
+	class Connection;
+}
+
+class ServerTraceRecorder
+{
+public:
+	ServerTraceRecorder(const std::string &path, u32 rand_seed);
+	~ServerTraceRecorder();
+
+	bool isOpen();
+
+	// Advances the clock events are recorded at
+	void step(float dtime);
+
+	void peerAdded(u16 peer_id);
+	void peerRemoved(u16 peer_id);
+	void packet(u16 peer_id, u8 channelnum, bool reliable,
+			const u8 *data, u32 size);
+
+private:
+	void writeEventHeader(u8 type, u16 peer_id);
+
+	JMutex m_mutex;
+	std::ofstream m_os;
+	double m_time;
+};
+
+struct ServerTracePacketStats
+{
+	u32 count;
+	u32 bytes;
+
+	ServerTracePacketStats():
+		count(0),
+		bytes(0)
+	{}
+};
+
+/*
+	Plays a trace back to a server listening on the local host, with one
+	connection for every peer of the recording.  The packets the server
+	sends back are counted by command.
+*/
+class ServerTraceReplayer
+{
+public:
+	ServerTraceReplayer(const std::string &path, u16 port);
+	~ServerTraceReplayer();
+
+	// Reads the header; returns false if the file isn't a usable trace
+	bool open();
+	u32 getRandSeed() { return m_rand_seed; }
+
+	// Sends everything recorded up to the server time advanced by dtime.
+	// Returns false once the whole trace has been sent.
+	bool step(float dtime);
+
+	void printReport(std::ostream &os);
+
+	/*
+		Replaces copy_path with a copy of the world at world_path.  As
+		traces carry no passwords, the passwords in the copy's auth.txt
+		are cleared so that the replayed players can log in.
+	*/
+	static bool copyWorld(const std::string &world_path,
+			const std::string &copy_path);
+
+private:
+	bool readEvent();
+	void replayEvent();
+	void receiveAll();
+
+	std::string m_path;
+	u16 m_port;
+	std::ifstream m_is;
+	u16 m_version;
+	u32 m_rand_seed;
+	double m_time;
+
+	// Next event, valid if m_have_event
+	bool m_have_event;
+	u8 m_event_type;
+	u32 m_event_time_ms;
+	u16 m_event_peer_id;
+	u8 m_event_channelnum;
+	bool m_event_reliable;
+	std::string m_event_data;
+
+	// Recorded peer id -> connection to the server
+	std::map<u16, con::Connection*> m_peers;
+
+	u32 m_events_replayed;
+	std::map<u16, ServerTracePacketStats> m_sent;
+	std::map<u16, ServerTracePacketStats> m_received;
+};
+
+#endif
+
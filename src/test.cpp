@@ -39,12 +39,24 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "filesys.h"
 #include "voxelalgorithms.h"
 #include "inventory.h"
+#include "inventorymanager.h"
+#include "nodemetadata.h"
+#include "gamedef.h"
+#include "mapgen_v6.h"
 #include "util/numeric.h"
 #include "util/serialize.h"
 #include "noise.h" // PseudoRandom used for random data for compression
 #include "clientserver.h" // LATEST_PROTOCOL_VERSION
+#include "lua_api/l_util.h" // minetest.serialize and deserialize
+#include "common/c_content.h" // read_content_id
+#include "common/c_types.h" // LuaError
+#include "cpp_api/s_env.h" // minetest.after timers
 #include <algorithm>
 
+extern "C" {
+#include "lualib.h"
+}
+
 /*
 	Asserts that the exception occurs
 */
@@ -545,6 +557,155 @@ struct TestNodedefSerialization: public TestBase
 	}
 };
 
+struct TestLuaSerialization: public TestBase
+{
+	void Run()
+	{
+		lua_State *L = luaL_newstate();
+		luaL_openlibs(L);
+		lua_newtable(L);
+		ModApiUtil::Initialize(L, lua_gettop(L));
+		lua_setglobal(L, "util");
+
+		// Shared and recursive tables, exact numbers, embedded nuls
+		UASSERT(luaL_dostring(L,
+				"local shared = {1, 2.5, -3, 0.1, 1e300, '\\0'} "
+				"local t = {a=shared, b=shared, [shared]=true} "
+				"t.self = t "
+				"data = util.serialize(t) "
+				"local u = util.deserialize(data) "
+				"return u.a == u.b and u[u.a] == true and u.self == u and "
+				"u.a[2] == 2.5 and u.a[3] == -3 and u.a[4] == 0.1 and "
+				"u.a[5] == 1e300 and u.a[6] == '\\0'") == 0);
+		UASSERT(lua_toboolean(L, -1));
+		lua_settop(L, 0);
+
+		// Functions can't be serialized
+		UASSERT(luaL_dostring(L, "util.serialize({f=print})") != 0);
+		lua_settop(L, 0);
+
+		// Damaged data must give nil or a value, never an error
+		lua_getglobal(L, "data");
+		size_t len = 0;
+		const char *s = lua_tolstring(L, -1, &len);
+		std::string data(s, len);
+		lua_settop(L, 0);
+		PseudoRandom pr(2013);
+		for(u32 i = 0; i < 200; i++)
+		{
+			std::string damaged = data;
+			u32 pos = pr.range(0, data.size() - 1);
+			if(i % 2 == 0)
+				damaged = data.substr(0, pos);
+			else
+				damaged[pos] = (char)pr.range(0, 255);
+			lua_getglobal(L, "util");
+			lua_getfield(L, -1, "deserialize");
+			lua_pushlstring(L, damaged.c_str(), damaged.size());
+			UASSERT(lua_pcall(L, 1, 0, 0) == 0);
+			lua_settop(L, 0);
+		}
+
+		lua_close(L);
+	}
+};
+
+struct TestContentIdCache: public TestBase
+{
+	void Run()
+	{
+		IWritableItemDefManager *idef = createItemDefManager();
+		IWritableNodeDefManager *ndef = createNodeDefManager();
+		define_some_nodes(idef, ndef);
+		content_t c_stone = ndef->getId("default:stone");
+		content_t c_grass = ndef->getId("default:dirt_with_grass");
+		lua_State *L = luaL_newstate();
+
+		// Names are cached
+		lua_pushstring(L, "default:stone");
+		UASSERT(read_content_id(L, -1, ndef) == c_stone);
+		UASSERT(read_content_id(L, -1, ndef) == c_stone);
+		lua_pop(L, 1);
+
+		// Unknown names are not, they may be registered later
+		lua_pushstring(L, "test:alias");
+		UASSERT(read_content_id(L, -1, ndef) == CONTENT_IGNORE);
+		idef->registerAlias("test:alias", "default:stone");
+		ndef->updateAliases(idef);
+		UASSERT(read_content_id(L, -1, ndef) == c_stone);
+
+		// An alias that changes, as register_alias_raw clears the cache
+		idef->registerAlias("test:alias", "default:dirt_with_grass");
+		ndef->updateAliases(idef);
+		clear_content_id_cache(L);
+		UASSERT(read_content_id(L, -1, ndef) == c_grass);
+		lua_pop(L, 1);
+
+		push_content_name(L, c_grass, ndef);
+		UASSERT(std::string(lua_tostring(L, -1)) == "default:dirt_with_grass");
+		lua_pop(L, 1);
+
+		lua_close(L);
+		delete idef;
+		delete ndef;
+	}
+};
+
+class TestTimerScript : public ScriptApiEnv
+{
+public:
+	lua_State *getState() { return getStack(); }
+};
+
+struct TestScriptTimers: public TestBase
+{
+	void Run()
+	{
+		TestTimerScript script;
+		lua_State *L = script.getState();
+		luaL_openlibs(L);
+
+		// Three timers due in the same step, the second one fails
+		const char *funcs[] = {
+			"return function() ran = (ran or 0) + 1 end",
+			"return function() error('timer failed') end",
+			"return function() ran = (ran or 0) + 1 end",
+		};
+		int refs[3];
+		for(int i=0; i<3; i++)
+		{
+			lua_newtable(L);
+			UASSERT(luaL_loadstring(L, funcs[i]) == 0);
+			lua_call(L, 0, 1);
+			lua_setfield(L, -2, "func");
+			refs[i] = luaL_ref(L, LUA_REGISTRYINDEX);
+			script.addTimer(0.5, refs[i]);
+		}
+		int top = lua_gettop(L);
+
+		bool thrown = false;
+		try{
+			script.runTimers(1.0);
+		}
+		catch(LuaError &e){
+			thrown = true;
+		}
+		UASSERT(thrown);
+		lua_settop(L, top);
+
+		lua_getglobal(L, "ran");
+		UASSERT(lua_tonumber(L, -1) == 1);
+		lua_pop(L, 1);
+		// No timer table is left in the registry
+		for(int i=0; i<3; i++)
+		{
+			lua_rawgeti(L, LUA_REGISTRYINDEX, refs[i]);
+			UASSERT(!lua_istable(L, -1));
+			lua_pop(L, 1);
+		}
+	}
+};
+
 struct TestCompress: public TestBase
 {
 	void Run()
@@ -923,6 +1084,274 @@ struct TestVoxelAlgorithms: public TestBase
 	}
 };
 
+/*
+	The mud flow of MapgenV6 as it was before it was made to work on a
+	heightmap.  Used as the reference for the equivalence test.
+*/
+static void flowMudReference(MapgenV6 &mg, s16 mudflow_minpos, s16 mudflow_maxpos)
+{
+	ManualMapVoxelManipulator *vm = mg.vm;
+	INodeDefManager *ndef = mg.ndef;
+	v3s16 node_min = mg.node_min;
+	v3s16 node_max = mg.node_max;
+
+	for(s16 k = 0; k < 3; k++) {
+		for (s16 z = mudflow_minpos; z <= mudflow_maxpos; z++)
+		for (s16 x = mudflow_minpos; x <= mudflow_maxpos; x++) {
+			if (k % 2 == 0) {
+				x = mudflow_maxpos - (x - mudflow_minpos);
+				z = mudflow_maxpos - (z - mudflow_minpos);
+			}
+
+			v2s16 p2d = v2s16(node_min.X, node_min.Z) + v2s16(x, z);
+
+			v3s16 em = vm->m_area.getExtent();
+			u32 i = vm->m_area.index(p2d.X, node_max.Y, p2d.Y);
+			s16 y = node_max.Y;
+
+			while(y >= node_min.Y)
+			{
+
+			for(;; y--)
+			{
+				MapNode *n = NULL;
+				for(; y >= node_min.Y; y--) {
+					n = &vm->m_data[i];
+					if (n->getContent() == mg.c_dirt ||
+						n->getContent() == mg.c_dirt_with_grass ||
+						n->getContent() == mg.c_gravel)
+						break;
+
+					vm->m_area.add_y(em, i, -1);
+				}
+
+				if (y < node_min.Y)
+					break;
+
+				if (n->getContent() == mg.c_dirt ||
+					n->getContent() == mg.c_dirt_with_grass)
+				{
+					n->setContent(mg.c_dirt);
+
+					{
+						u32 i2 = i;
+						vm->m_area.add_y(em, i2, -1);
+						if(vm->m_area.contains(i2) == false)
+							continue;
+						MapNode *n2 = &vm->m_data[i2];
+						if (n2->getContent() != mg.c_dirt &&
+							n2->getContent() != mg.c_dirt_with_grass)
+							continue;
+					}
+				}
+
+				v3s16 dirs4[4] = {
+					v3s16(0,0,1), // back
+					v3s16(1,0,0), // right
+					v3s16(0,0,-1), // front
+					v3s16(-1,0,0), // left
+				};
+
+				u32 i3 = i;
+				vm->m_area.add_y(em, i3, 1);
+				if (vm->m_area.contains(i3) == true &&
+					ndef->get(vm->m_data[i3]).walkable)
+					continue;
+
+				for(u32 di=0; di<4; di++) {
+					v3s16 dirp = dirs4[di];
+					u32 i2 = i;
+					vm->m_area.add_p(em, i2, dirp);
+					if (vm->m_area.contains(i2) == false)
+						continue;
+					MapNode *n2 = &vm->m_data[i2];
+					if (ndef->get(*n2).walkable)
+						continue;
+					vm->m_area.add_y(em, i2, -1);
+					if (vm->m_area.contains(i2) == false)
+						continue;
+					n2 = &vm->m_data[i2];
+					if (ndef->get(*n2).walkable)
+						continue;
+					bool dropped_to_unknown = false;
+					do {
+						vm->m_area.add_y(em, i2, -1);
+						n2 = &vm->m_data[i2];
+						if(vm->m_area.contains(i2) == false ||
+							n2->getContent() == CONTENT_IGNORE) {
+							dropped_to_unknown = true;
+							break;
+						}
+					} while (ndef->get(*n2).walkable == false);
+					vm->m_area.add_y(em, i2, 1);
+					n2 = &vm->m_data[i2];
+
+					if (!dropped_to_unknown) {
+						*n2 = *n;
+						*n = MapNode(CONTENT_AIR);
+					}
+
+					break;
+				}
+			}
+			}
+		}
+	}
+}
+
+struct TestMapgenV6MudFlow: public TestBase
+{
+	// Fills the whole area with rough random terrain covered in loose stuff
+	void makeTerrain(ManualMapVoxelManipulator &vm, MapgenV6 &mg, int seed)
+	{
+		PseudoRandom pr(seed);
+		VoxelArea &a = vm.m_area;
+		content_t loose[3] = {mg.c_dirt, mg.c_dirt_with_grass, mg.c_gravel};
+
+		for(s16 z = a.MinEdge.Z; z <= a.MaxEdge.Z; z++)
+		for(s16 x = a.MinEdge.X; x <= a.MaxEdge.X; x++)
+		{
+			s16 surface_y = pr.range(a.MinEdge.Y, a.MaxEdge.Y);
+			s16 loose_depth = pr.range(0, 6);
+			s16 overhang_y = pr.range(0, 7) == 0 ?
+				pr.range(surface_y, a.MaxEdge.Y) : a.MaxEdge.Y + 1;
+			bool unknown = (pr.range(0, 31) == 0);
+			for(s16 y = a.MinEdge.Y; y <= a.MaxEdge.Y; y++)
+			{
+				content_t c = CONTENT_AIR;
+				if(y <= surface_y - loose_depth)
+					c = pr.range(0, 15) == 0 ? CONTENT_AIR : CONTENT_STONE;
+				else if(y <= surface_y)
+					c = loose[pr.range(0, 2)];
+				else if(y == overhang_y)
+					c = CONTENT_STONE;
+				if(unknown && y < surface_y - loose_depth)
+					c = CONTENT_IGNORE;
+				vm.m_data[a.index(x, y, z)] = MapNode(c);
+				vm.m_flags[a.index(x, y, z)] = 0;
+			}
+		}
+	}
+
+	void Run(INodeDefManager *ndef)
+	{
+		MapgenV6Params params;
+		params.chunksize = 1;
+		MapgenV6 mg(0, &params, NULL);
+
+		mg.ndef = ndef;
+		mg.c_dirt_with_grass = CONTENT_GRASS;
+
+		mg.node_min = v3s16(0, 0, 0);
+		mg.node_max = v3s16(1, 1, 1) * (MAP_BLOCKSIZE - 1);
+		mg.central_area_size = mg.node_max - mg.node_min + v3s16(1, 1, 1);
+		VoxelArea area(mg.node_min - v3s16(1, 1, 1) * MAP_BLOCKSIZE,
+			mg.node_max + v3s16(1, 1, 1) * MAP_BLOCKSIZE);
+
+		s16 mudflow_minpos = -MAP_BLOCKSIZE + 1;
+		s16 mudflow_maxpos = mg.central_area_size.X + MAP_BLOCKSIZE - 2;
+
+		// Not registered, so both are walkable unknown nodes
+		mg.c_dirt = 0x100;
+		mg.c_gravel = 0x101;
+
+		u32 time_reference = 0;
+		u32 time_heightmap = 0;
+		for(int seed = 0; seed < 64; seed++)
+		{
+			ManualMapVoxelManipulator vm_ref(NULL);
+			ManualMapVoxelManipulator vm_new(NULL);
+			vm_ref.addArea(area);
+			vm_new.addArea(area);
+			makeTerrain(vm_ref, mg, seed);
+			makeTerrain(vm_new, mg, seed);
+
+			u32 t0 = porting::getTimeUs();
+			mg.vm = &vm_ref;
+			flowMudReference(mg, mudflow_minpos, mudflow_maxpos);
+			u32 t1 = porting::getTimeUs();
+			mg.vm = &vm_new;
+			mg.flowMud(mudflow_minpos, mudflow_maxpos);
+			u32 t2 = porting::getTimeUs();
+			time_reference += t1 - t0;
+			time_heightmap += t2 - t1;
+
+			s32 volume = area.getVolume();
+			s32 differing = 0;
+			for(s32 i = 0; i < volume; i++)
+			{
+				if(vm_ref.m_data[i].getContent() != vm_new.m_data[i].getContent())
+					differing++;
+			}
+			UTEST(differing == 0, "seed %i: %i nodes differ", seed, differing);
+		}
+		mg.vm = NULL;
+
+		infostream<<"TestMapgenV6MudFlow: reference "<<time_reference
+				<<"us, heightmap "<<time_heightmap<<"us"<<std::endl;
+	}
+};
+
+struct TestDecoCutoffs: public TestBase
+{
+	void Run(INodeDefManager *ndef)
+	{
+		// A chunk of 2x2x2 blocks on top of another one, with the usual
+		// border of one block
+		v3s16 nmin(0, 2 * MAP_BLOCKSIZE, 0);
+		v3s16 nmax = nmin + v3s16(1, 1, 1) * (2 * MAP_BLOCKSIZE - 1);
+		VoxelArea area(nmin - v3s16(1, 1, 1) * MAP_BLOCKSIZE,
+			nmax + v3s16(1, 1, 1) * MAP_BLOCKSIZE);
+		ManualMapVoxelManipulator vm(NULL);
+		vm.addArea(area);
+		for(s32 i = 0; i < area.getVolume(); i++)
+		{
+			vm.m_data[i] = MapNode(CONTENT_AIR);
+			vm.m_flags[i] = 0;
+		}
+
+		Mapgen mg;
+		mg.seed = 0;
+		mg.ndef = ndef;
+		mg.vm = &vm;
+
+		// A column of stone taller than a block
+		const s16 height = MAP_BLOCKSIZE + 8;
+		DecoSchematic *deco = new DecoSchematic;
+		deco->ndef = ndef;
+		deco->c_place_on = CONTENT_IGNORE;
+		deco->rotation = ROTATE_0;
+		deco->size = v3s16(1, height, 1);
+		deco->schematic = new MapNode[height];
+		for(s16 i = 0; i < height; i++)
+			deco->schematic[i] = MapNode(CONTENT_STONE, MTSCHEM_PROB_ALWAYS);
+		std::vector<Decoration *> decos;
+		decos.push_back(deco);
+
+		// Cut off by the top of the chunk below; the last two start below
+		// the area of this chunk
+		std::vector<DecoCutoff> cutoffs;
+		cutoffs.push_back(DecoCutoff(0, v3s16(5, nmin.Y - 2, 5)));
+		cutoffs.push_back(DecoCutoff(0, v3s16(9, area.MinEdge.Y - 1, 9)));
+		cutoffs.push_back(DecoCutoff(0, v3s16(9, nmin.Y - 4 * height, 9)));
+		mg.placeDecoCutoffs(decos, cutoffs, nmax);
+
+		s32 stone = 0;
+		for(s32 i = 0; i < area.getVolume(); i++)
+		{
+			if(vm.m_data[i].getContent() == CONTENT_STONE)
+				stone++;
+		}
+		UASSERT(stone == height);
+		for(s16 y = nmin.Y - 2; y < nmin.Y - 2 + height; y++)
+			UASSERT(vm.getNodeNoExNoEmerge(v3s16(5, y, 5)).getContent()
+					== CONTENT_STONE);
+
+		mg.vm = NULL;
+		delete deco;
+	}
+};
+
 struct TestInventory: public TestBase
 {
 	void Run(IItemDefManager *idef)
@@ -1016,6 +1445,217 @@ struct TestInventory: public TestBase
 		std::ostringstream inv_os(std::ios::binary);
 		inv.serialize(inv_os);
 		UASSERT(inv_os.str() == serialized_inventory_2);
+
+		// The fast item string parser has to agree with the stream parser
+		const char *itemstrings[] = {
+			"", "default:dirt", "default:dirt 5", "default:dirt  5",
+			"default:dirt 0", "default:dirt 70000", "default:dirt 5 3",
+			"default:dirt 5 3 meta", "default:dirt 5 3 meta trailing",
+			"default:dirt 5 3 \"quoted meta\"", "\"default:dirt\" 7",
+			"default:dirt -1", "default:dirt x", " 5", "node \"default:dirt\" 9",
+		};
+		for(u32 i=0; i<sizeof(itemstrings)/sizeof(itemstrings[0]); i++)
+		{
+			ItemStack fast;
+			fast.deSerialize(std::string(itemstrings[i]), idef);
+			ItemStack slow;
+			std::istringstream item_is(itemstrings[i], std::ios::binary);
+			slow.deSerialize(item_is, idef);
+			UASSERT(fast.name == slow.name);
+			UASSERT(fast.count == slow.count);
+			UASSERT(fast.wear == slow.wear);
+			UASSERT(fast.metadata == slow.metadata);
+			ItemStack reparsed;
+			reparsed.deSerialize(fast.getItemString(), idef);
+			UASSERT(reparsed.getItemString() == fast.getItemString());
+		}
+	}
+};
+
+struct TestInventoryActions: public TestBase
+{
+	void Run()
+	{
+		// Binary serialization round trip, with interned list names
+		std::ostringstream os(std::ios::binary);
+		for(u16 i=0; i<3; i++)
+		{
+			IMoveAction a;
+			a.count = 1;
+			a.from_inv.setPlayer("singleplayer");
+			a.from_list = "main";
+			a.from_i = 0;
+			a.to_inv.setNodeMeta(v3s16(1,-2,3));
+			a.to_list = "dst";
+			a.to_i = i == 2 ? 5 : 4;
+			a.serializeBinary(os);
+		}
+		IDropAction d;
+		d.count = 7;
+		d.from_inv.setDetached("bag");
+		d.from_list = "main";
+		d.from_i = 2;
+		d.serializeBinary(os);
+
+		// The lists exist on the server, so their names have ids
+		u32 main_id = getInventoryListNameId("main");
+		u32 dst_id = getInventoryListNameId("dst");
+		UASSERT(main_id != 0 && dst_id != 0 && main_id != dst_id);
+		UASSERT(getInventoryListNameId("no such list", false) == 0);
+
+		std::istringstream is(os.str(), std::ios::binary);
+		std::vector<InventoryAction*> actions;
+		for(u16 i=0; i<4; i++)
+			actions.push_back(InventoryAction::deSerializeBinary(is));
+		UASSERT(actions[0]->getType() == IACTION_MOVE);
+		IMoveAction *ma = (IMoveAction*)actions[0];
+		UASSERT(ma->count == 1);
+		UASSERT(ma->from_inv.type == InventoryLocation::PLAYER);
+		UASSERT(ma->from_inv.name == "singleplayer");
+		UASSERT(ma->from_list == "main");
+		UASSERT(ma->from_list_id == main_id);
+		UASSERT(ma->to_inv.type == InventoryLocation::NODEMETA);
+		UASSERT(ma->to_inv.p == v3s16(1,-2,3));
+		UASSERT(ma->to_list_id == dst_id);
+		UASSERT(ma->to_i == 4);
+		UASSERT(actions[3]->getType() == IACTION_DROP);
+		IDropAction *da = (IDropAction*)actions[3];
+		UASSERT(da->count == 7);
+		UASSERT(da->from_inv.type == InventoryLocation::DETACHED);
+		UASSERT(da->from_inv.name == "bag");
+		UASSERT(da->from_i == 2);
+
+		// Cut short data throws
+		std::string cut = os.str().substr(0, 5);
+		std::istringstream cut_is(cut, std::ios::binary);
+		bool thrown = false;
+		try{
+			delete InventoryAction::deSerializeBinary(cut_is);
+		}
+		catch(SerializationError &e){
+			thrown = true;
+		}
+		UASSERT(thrown);
+
+		// Only the two moves between the same slots are merged
+		InventoryAction::coalesce(actions);
+		UASSERT(actions.size() == 3);
+		UASSERT(((IMoveAction*)actions[0])->count == 2);
+		UASSERT(((IMoveAction*)actions[1])->count == 1);
+		UASSERT(((IMoveAction*)actions[1])->to_i == 5);
+		UASSERT(actions[2]->getType() == IACTION_DROP);
+		for(u32 i=0; i<actions.size(); i++)
+			delete actions[i];
+	}
+};
+
+// Just enough of a game for NodeMetadata and its inventory
+class TestGameDef : public IGameDef
+{
+public:
+	TestGameDef(IItemDefManager *idef, INodeDefManager *ndef):
+		m_idef(idef),
+		m_ndef(ndef)
+	{}
+
+	IItemDefManager* getItemDefManager() { return m_idef; }
+	INodeDefManager* getNodeDefManager() { return m_ndef; }
+	ICraftDefManager* getCraftDefManager() { return NULL; }
+	ITextureSource* getTextureSource() { return NULL; }
+	IShaderSource* getShaderSource() { return NULL; }
+	u16 allocateUnknownNodeId(const std::string &name) { return 0; }
+	ISoundManager* getSoundManager() { return NULL; }
+	MtEventManager* getEventManager() { return NULL; }
+
+private:
+	IItemDefManager *m_idef;
+	INodeDefManager *m_ndef;
+};
+
+struct TestNodeMetadata: public TestBase
+{
+	// Round trip through the data sent to clients
+	void toClient(const NodeMetadata &meta, NodeMetadata &out)
+	{
+		std::ostringstream os(std::ios::binary);
+		meta.serialize(os, false);
+		std::istringstream is(os.str(), std::ios::binary);
+		out.deSerialize(is);
+	}
+
+	void Run(IItemDefManager *idef, INodeDefManager *ndef)
+	{
+		TestGameDef gamedef(idef, ndef);
+
+		// ${name} references are followed through other fields
+		NodeMetadata chest(&gamedef);
+		chest.setString("formspec", "size[8,9]label[0,0;${label}]"
+				"list[current_name;main;0,1;8,4;]");
+		chest.setString("infotext", "${owner_text}");
+		chest.setString("label", "${owner_text} ${unset}");
+		chest.setString("owner_text", "Chest (owned by ${owner})");
+		chest.setString("owner", "celeron55");
+		chest.setString("secret", "server only");
+		chest.setString("text", "not a sign");
+		chest.getInventory()->addList("main", 32);
+		chest.getInventory()->getList("main")->addItem(3,
+				ItemStack("default:stone", 5, 0, "", idef));
+
+		std::set<std::string> names;
+		chest.getClientFieldNames(names);
+		UASSERT(names.count("formspec") && names.count("infotext"));
+		UASSERT(names.count("label") && names.count("owner_text"));
+		UASSERT(names.count("owner") && names.count("unset"));
+		UASSERT(!names.count("secret") && !names.count("text"));
+
+		NodeMetadata sent(&gamedef);
+		toClient(chest, sent);
+		std::map<std::string, std::string> vars = sent.getStrings();
+		UASSERT(vars.size() == 5);
+		UASSERT(vars["formspec"] == chest.getString("formspec"));
+		UASSERT(vars["label"] == "${owner_text} ${unset}");
+		UASSERT(sent.getString("infotext") == "Chest (owned by ${owner})");
+		UASSERT(vars["owner"] == "celeron55");
+		UASSERT(vars.find("secret") == vars.end());
+		UASSERT(vars.find("text") == vars.end());
+		// Inventories are sent whole
+		InventoryList *list = sent.getInventory()->getList("main");
+		UASSERT(list && list->getSize() == 32);
+		UASSERT(list->getItem(3).getItemString() == "default:stone 5");
+
+		// Disk data keeps everything
+		std::ostringstream disk_os(std::ios::binary);
+		chest.serialize(disk_os);
+		NodeMetadata loaded(&gamedef);
+		std::istringstream disk_is(disk_os.str(), std::ios::binary);
+		loaded.deSerialize(disk_is);
+		UASSERT(loaded.getStrings() == chest.getStrings());
+
+		// The old sign formspec shows the text field
+		NodeMetadata sign(&gamedef);
+		sign.setString("formspec", "hack:sign_text_input");
+		sign.setString("infotext", "\"hello\"");
+		sign.setString("text", "hello");
+		sign.setString("owner", "celeron55");
+		NodeMetadata sent_sign(&gamedef);
+		toClient(sign, sent_sign);
+		UASSERT(sent_sign.getString("text") == "hello");
+		UASSERT(sent_sign.getString("infotext") == "\"hello\"");
+		UASSERT(sent_sign.getString("owner") == "");
+
+		// Cycles and unterminated references end
+		NodeMetadata loop(&gamedef);
+		loop.setString("infotext", "${a}");
+		loop.setString("a", "${b} ${");
+		loop.setString("b", "${a}");
+		loop.setString("c", "unused");
+		names.clear();
+		loop.getClientFieldNames(names);
+		UASSERT(names.count("a") && names.count("b"));
+		UASSERT(!names.count("c"));
+		NodeMetadata sent_loop(&gamedef);
+		toClient(loop, sent_loop);
+		UASSERT(sent_loop.getStrings().size() == 3);
 	}
 };
 
@@ -1999,10 +2639,17 @@ void run_tests()
 	TEST(TestCompress);
 	TEST(TestSerialization);
 	TEST(TestNodedefSerialization);
+	TEST(TestLuaSerialization);
+	TEST(TestContentIdCache);
+	TEST(TestScriptTimers);
 	TESTPARAMS(TestMapNode, ndef);
 	TESTPARAMS(TestVoxelManipulator, ndef);
 	TESTPARAMS(TestVoxelAlgorithms, ndef);
+	TESTPARAMS(TestMapgenV6MudFlow, ndef);
+	TESTPARAMS(TestDecoCutoffs, ndef);
 	TESTPARAMS(TestInventory, idef);
+	TEST(TestInventoryActions);
+	TESTPARAMS(TestNodeMetadata, idef, ndef);
 	//TEST(TestMapBlock);
 	//TEST(TestMapSector);
 	TEST(TestCollision);
@@ -20,7 +20,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #ifndef TEST_HEADER
 #define TEST_HEADER
 
+class IWritableItemDefManager;
+class IWritableNodeDefManager;
+
 void run_tests();
 
+// Registers the nodes used by the tests
+void define_some_nodes(IWritableItemDefManager *idef,
+		IWritableNodeDefManager *ndef);
+
 #endif
 